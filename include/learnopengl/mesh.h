@@ -7,8 +7,14 @@
 #include <glm/gtc/matrix_transform.hpp>
 
 #include <learnopengl/shader.h>
+#include <rg/Bounds.h>
+#include <rg/GeometryArena.h>
+#include <rg/VertexFormat.h>
 
+#include <algorithm>
+#include <iostream>
 #include <string>
+#include <type_traits>
 #include <vector>
 using namespace std;
 
@@ -27,6 +33,13 @@ struct Vertex {
 
 
 
+// per-instance data for instanced draws: the model matrix and its precomputed normal matrix,
+// read by the vertex shader from attribute locations 5-8 and 9-11.
+struct InstanceData {
+    glm::mat4 Model;
+    glm::mat3 NormalMatrix;
+};
+
 struct Texture {
     unsigned int id;
     string type;
@@ -39,101 +52,348 @@ public:
     vector<Vertex>       vertices;
     vector<unsigned int> indices;
     vector<Texture>      textures;
+    unsigned int vertexCount = 0;
+    unsigned int indexCount = 0;
+    rg::AABB bounds; // object space, given by whoever builds the mesh or computed from the vertices
+    rg::VertexFormat format = rg::VertexFormat::Float; // layout of the uploaded vertex buffer, see rg/VertexFormat.h
+    size_t vertexBufferBytes = 0;
 
     unsigned int VAO;
     std::string glslIdentifierPrefix;
-    // constructor
-    Mesh(vector<Vertex> vertices, vector<unsigned int> indices, vector<Texture> textures)
+    // constructor. the vertex buffer is uploaded in the layout of the format type (rg::FloatFormat<Vertex>,
+    // rg::PackedFormat, ...), packed formats quantize positions relative to bounds
+    template<typename Format = rg::FloatFormat<Vertex>>
+    Mesh(vector<Vertex> vertices, vector<unsigned int> indices, vector<Texture> textures,
+         const rg::AABB &bounds = rg::AABB(), Format = Format())
     {
         this->vertices = vertices;
         this->indices = indices;
         this->textures = textures;
+        this->bounds = bounds;
+        setupTextureBindings();
 
         // now that we have all the required data, set the vertex buffers and its attribute pointers.
-        setupMesh();
+        setupMesh<Format>(this->vertices.data(), this->vertices.size(), this->indices.data(), this->indices.size());
+    }
+
+    // constructor for data that already lives somewhere else (e.g. a memory mapped mesh cache).
+    // the data is uploaded as is and no CPU side copy is kept.
+    template<typename Format = rg::FloatFormat<Vertex>>
+    Mesh(const Vertex *vertexData, size_t vertexCount, const unsigned int *indexData, size_t indexCount, vector<Texture> textures,
+         const rg::AABB &bounds = rg::AABB(), Format = Format())
+    {
+        this->textures = textures;
+        this->bounds = bounds;
+        setupTextureBindings();
+
+        setupMesh<Format>(vertexData, vertexCount, indexData, indexCount);
     }
 
     // render the mesh
     void Draw(Shader &shader)
     {
-        // bind appropriate textures
-        unsigned int diffuseNr  = 1;
-        unsigned int specularNr = 1;
-        unsigned int normalNr   = 1;
-        unsigned int heightNr   = 1;
+        bindTextures(shader, decode);
+
+        // the pool's VAO may still source instance attributes from the last instanced draw, turn them off
+        rg::GeometryArena &arena = rg::GeometryArena::instance();
+        rg::GeometryArena::InstanceBinding &binding = arena.instanceBinding(geometry);
+        if(binding.buffer != 0)
+        {
+            rg::GLState::instance().bindVertexArray(VAO);
+            for(unsigned int location = 5; location < 12; location++)
+                glDisableVertexAttribArray(location);
+            binding = rg::GeometryArena::InstanceBinding();
+            rg::frameStats().instanceAttributeUpdates++;
+        }
+        // with their arrays off the instance attributes read these values, one identity instance, so instanced
+        // shaders draw the mesh where it is. the state cache drops them while they are still set from the last draw
+        rg::GLState &state = rg::GLState::instance();
+        for(unsigned int column = 0; column < 4; column++)
+            state.vertexAttrib(5 + column, glm::vec4(column == 0, column == 1, column == 2, column == 3));
+        for(unsigned int column = 0; column < 3; column++)
+            state.vertexAttrib(9 + column, glm::vec4(column == 0, column == 1, column == 2, 1.0f));
+        // draw mesh. the VAO and textures stay bound, the state cache skips them if the next draw wants the same
+        arena.draw(geometry);
+        rg::frameStats().triangles += indexCount / 3;
+    }
+
+    // render instanceCount copies of the mesh at the given level of detail, transforms come from the buffer given
+    // to SetInstanceBuffer, starting firstInstance instances in
+    void DrawInstanced(Shader &shader, unsigned int instanceCount, unsigned int lod = 0, unsigned int firstInstance = 0)
+    {
+        bindTextures(shader, decode);
+
+        unsigned int baseInstance = instanceFirst + firstInstance;
+        if(rg::baseInstanceSupported())
+        {
+            // the attributes stay at the front of the buffer for every mesh drawing from it, the draw skips ahead
+            bindInstanceAttributes(instanceBuffer, 0);
+            rg::GeometryArena::instance().draw(lodGeometry(lod), instanceCount, baseInstance);
+        }
+        else
+        {
+            bindInstanceAttributes(instanceBuffer, baseInstance * sizeof(InstanceData));
+            rg::GeometryArena::instance().draw(lodGeometry(lod), instanceCount);
+        }
+        rg::frameStats().triangles += (unsigned long long)(LodIndexCount(lod) / 3) * instanceCount;
+    }
+
+    // adds the next coarser level of detail, indices into this mesh's vertices (see rg/MeshLod.h). levels are
+    // added in order and their errors ascend
+    void AddLod(const unsigned int *indexData, size_t count, float error)
+    {
+        lods.push_back(Lod{rg::GeometryArena::instance().addLod(geometry, indexData, count), (unsigned int)count, error});
+    }
+
+    // levels of detail, the full mesh (level 0) included
+    unsigned int LodCount() const
+    {
+        return 1 + lods.size();
+    }
+
+    // how far, in object space, a level's surface is from the full mesh at most
+    float LodError(unsigned int lod) const
+    {
+        return lod == 0 ? 0.0f : lods[lod - 1].error;
+    }
+
+    unsigned int LodIndexCount(unsigned int lod) const
+    {
+        return lod == 0 ? indexCount : lods[lod - 1].indexCount;
+    }
+
+    // whether a multi draw can cover this mesh and other with one command each: same vertex format and
+    // index type, same textures
+    bool SharesMultiDraw(const Mesh &other) const
+    {
+        rg::GeometryArena &arena = rg::GeometryArena::instance();
+        if(VAO != other.VAO || arena.indexType(geometry) != arena.indexType(other.geometry)
+           || glslIdentifierPrefix != other.glslIdentifierPrefix || textureBindings.size() != other.textureBindings.size())
+            return false;
+        for(unsigned int i = 0; i < textureBindings.size(); i++)
+            if(textureBindings[i].unit != other.textureBindings[i].unit || textureBindings[i].id != other.textureBindings[i].id)
+                return false;
+        return true;
+    }
+
+    // this mesh's command of a multi draw at the given level of detail, its instances start at firstInstance in
+    // the multi draw instance buffer
+    rg::DrawElementsIndirectCommand IndirectCommand(unsigned int instanceCount, unsigned int firstInstance, unsigned int lod = 0) const
+    {
+        return rg::GeometryArena::instance().indirectCommand(lodGeometry(lod), instanceCount, firstInstance);
+    }
+
+    // appends instances to a multi draw instance buffer. the mesh's position decode goes into the model matrices,
+    // so meshes quantized to different bounds can share a draw; normals don't depend on it.
+    void AppendMultiDrawInstances(const InstanceData *instances, unsigned int count, vector<InstanceData> &out) const
+    {
+        for(unsigned int i = 0; i < count; i++)
+        {
+            InstanceData instance = instances[i];
+            instance.Model[3] = instance.Model * glm::vec4(decode.positionOffset, 1.0f);
+            for(int axis = 0; axis < 3; axis++)
+                instance.Model[axis] = instance.Model[axis] * decode.positionScale[axis];
+            out.push_back(instance);
+        }
+    }
+
+    // sets up everything for a multi draw of this mesh and the ones it SharesMultiDraw with: textures, the decode
+    // left in the instances (see AppendMultiDrawInstances) and instance attributes starting at the buffer's front.
+    // the draw itself is GeometryArena::multiDraw with geometry of any of them.
+    void BindMultiDraw(Shader &shader, unsigned int multiDrawInstanceBuffer)
+    {
+        rg::VertexDecode identity;
+        identity.packedNormals = decode.packedNormals;
+        bindTextures(shader, identity);
+        bindInstanceAttributes(multiDrawInstanceBuffer, 0);
+    }
+
+    rg::GeometryHandle Geometry() const
+    {
+        return geometry;
+    }
+
+    // gives the mesh's vertices and indices back to the geometry arena, the mesh can't be drawn afterwards
+    void Release()
+    {
+        rg::GeometryArena &arena = rg::GeometryArena::instance();
+        for(const Lod &lod : lods)
+            arena.release(lod.geometry);
+        lods.clear();
+        if(geometry != rg::kNoGeometry)
+            arena.release(geometry);
+        geometry = rg::kNoGeometry;
+    }
+
+    // identifies the mesh's material for draw sorting: meshes sharing their first texture share a material
+    unsigned int MaterialID() const
+    {
+        return textureBindings.empty() ? 0 : textureBindings[0].id;
+    }
+
+    // sources the per-instance attributes (see InstanceData) from the given buffer, starting firstInstance
+    // instances in. cheap to call every frame, it only records the buffer; DrawInstanced points the attributes at it.
+    void SetInstanceBuffer(unsigned int instanceVBO, unsigned int firstInstance = 0)
+    {
+        instanceBuffer = instanceVBO;
+        instanceFirst = firstInstance;
+    }
+
+private:
+    // render data, the vertices and indices live in the geometry arena's buffers for the mesh's format
+    rg::GeometryHandle geometry = rg::kNoGeometry;
+    unsigned int instanceBuffer = 0;
+    unsigned int instanceFirst = 0;
+    // coarser levels of detail, index only ranges drawing the vertices of geometry
+    struct Lod {
+        rg::GeometryHandle geometry;
+        unsigned int indexCount;
+        float error;
+    };
+    vector<Lod> lods;
+
+    rg::GeometryHandle lodGeometry(unsigned int lod) const
+    {
+        return lod == 0 ? geometry : lods[lod - 1].geometry;
+    }
+
+    // a texture and the unit it is bound to. the unit is fixed by the sampler it feeds
+    // (texture_diffuse1 -> 0, texture_specular1 -> 1, ..., texture_diffuse2 -> 4, ...), so every mesh
+    // drawn with a shader wants the same sampler values and they only have to be set once.
+    struct TextureBinding {
+        unsigned int unit;
+        unsigned int id;
+        string sampler; // sampler name without glslIdentifierPrefix, e.g. texture_diffuse1
+    };
+    vector<TextureBinding> textureBindings;
+    // shaders whose samplers already point at the units above, with their vertex decode uniforms
+    struct ResolvedShader {
+        unsigned int id;
+        UniformHandle positionOffset;
+        UniformHandle positionScale;
+        UniformHandle packedNormals;
+    };
+    vector<ResolvedShader> resolvedShaders;
+    std::string resolvedPrefix;
+    rg::VertexDecode decode;
+
+    void setupTextureBindings()
+    {
+        static const char *types[] = {"texture_diffuse", "texture_specular", "texture_normal", "texture_height"};
+        const unsigned int typeCount = sizeof(types) / sizeof(types[0]);
+        unsigned int numbers[typeCount] = {};
         for(unsigned int i = 0; i < textures.size(); i++)
         {
-            glActiveTexture(GL_TEXTURE0 + i); // active proper texture unit before binding
+            unsigned int type = 0;
+            while(type < typeCount && textures[i].type != types[type])
+                type++;
+            if(type == typeCount)
+            {
+                std::cout << "ERROR::MESH::UNKNOWN_TEXTURE_TYPE: " << textures[i].type << std::endl;
+                continue;
+            }
             // retrieve texture number (the N in diffuse_textureN)
-            string number;
-            string name = textures[i].type;
-            if(name == "texture_diffuse")
-                number = std::to_string(diffuseNr++);
-            else if(name == "texture_specular")
-                number = std::to_string(specularNr++); // transfer unsigned int to stream
-            else if(name == "texture_normal")
-                number = std::to_string(normalNr++); // transfer unsigned int to stream
-            else if(name == "texture_height")
-                number = std::to_string(heightNr++); // transfer unsigned int to stream
-
-            // now set the sampler to the correct texture unit
-            glUniform1i(glGetUniformLocation(shader.ID, (glslIdentifierPrefix + name + number).c_str()), i);
-            // and finally bind the texture
-            glBindTexture(GL_TEXTURE_2D, textures[i].id);
+            unsigned int number = ++numbers[type];
+            textureBindings.push_back(TextureBinding{(number - 1) * typeCount + type, textures[i].id,
+                                                     textures[i].type + std::to_string(number)});
         }
+    }
 
+    // points the shader's samplers at this mesh's texture units and looks up its vertex decode uniforms.
+    // runs once per (mesh, shader) pair, the shader has to be in use.
+    const ResolvedShader &resolveSamplers(Shader &shader)
+    {
+        for(const TextureBinding &binding : textureBindings)
+        {
+            UniformHandle sampler = shader.uniform(glslIdentifierPrefix + binding.sampler);
+            if(sampler.location >= 0)
+                shader.setInt(sampler, binding.unit);
+        }
+        resolvedShaders.push_back(ResolvedShader{shader.ID, shader.uniform(UNIFORM("positionOffset")),
+                                                 shader.uniform(UNIFORM("positionScale")), shader.uniform(UNIFORM("packedNormals"))});
+        return resolvedShaders.back();
+    }
 
+    void bindTextures(Shader &shader, const rg::VertexDecode &vertexDecode)
+    {
+        if(resolvedPrefix != glslIdentifierPrefix)
+        {
+            resolvedShaders.clear();
+            resolvedPrefix = glslIdentifierPrefix;
+        }
+        auto resolved = std::find_if(resolvedShaders.begin(), resolvedShaders.end(),
+                                     [&shader](const ResolvedShader &r) { return r.id == shader.ID; });
+        const ResolvedShader &uniforms = resolved != resolvedShaders.end() ? *resolved : resolveSamplers(shader);
 
-        // draw mesh
-        glBindVertexArray(VAO);
-        glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0);
-        glBindVertexArray(0);
+        // the decode differs per mesh (multi draws pass the identity), shaders without the uniforms get float vertices only
+        if(uniforms.positionOffset.location >= 0)
+            shader.setVec3(uniforms.positionOffset, vertexDecode.positionOffset);
+        if(uniforms.positionScale.location >= 0)
+            shader.setVec3(uniforms.positionScale, vertexDecode.positionScale);
+        if(uniforms.packedNormals.location >= 0)
+            shader.setBool(uniforms.packedNormals, vertexDecode.packedNormals);
 
-        // always good practice to set everything back to defaults once configured.
-        glActiveTexture(GL_TEXTURE0);
+        // bind appropriate textures
+        rg::GLState &state = rg::GLState::instance();
+        for(const TextureBinding &binding : textureBindings)
+            state.bindTexture(binding.unit, GL_TEXTURE_2D, binding.id);
     }
 
-private:
-    // render data
-    unsigned int VBO, EBO;
+    // every mesh of a vertex format shares one VAO, so without a base instance draw (GL 4.2) the per-instance
+    // attributes are re-pointed whenever the previous instanced draw of the format used another buffer or offset
+    void bindInstanceAttributes(unsigned int buffer, size_t offset)
+    {
+        // the draw reads them from the instance buffer, their current values may not survive it
+        for(unsigned int location = 5; location < 12; location++)
+            rg::GLState::instance().forgetVertexAttrib(location);
+        rg::GeometryArena::InstanceBinding &binding = rg::GeometryArena::instance().instanceBinding(geometry);
+        if(binding.buffer == buffer && binding.offset == offset)
+            return;
+        rg::GLState::instance().bindVertexArray(VAO);
+        glBindBuffer(GL_ARRAY_BUFFER, buffer);
+        // a mat4 attribute takes four consecutive locations, one per column, a mat3 three
+        for(unsigned int column = 0; column < 4; column++)
+        {
+            glEnableVertexAttribArray(5 + column);
+            glVertexAttribPointer(5 + column, 4, GL_FLOAT, GL_FALSE, sizeof(InstanceData), (void*)(offset + offsetof(InstanceData, Model) + column * sizeof(glm::vec4)));
+            glVertexAttribDivisor(5 + column, 1);
+        }
+        for(unsigned int column = 0; column < 3; column++)
+        {
+            glEnableVertexAttribArray(9 + column);
+            glVertexAttribPointer(9 + column, 3, GL_FLOAT, GL_FALSE, sizeof(InstanceData), (void*)(offset + offsetof(InstanceData, NormalMatrix) + column * sizeof(glm::vec3)));
+            glVertexAttribDivisor(9 + column, 1);
+        }
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        binding.buffer = buffer;
+        binding.offset = offset;
+        rg::frameStats().instanceAttributeUpdates++;
+    }
 
-    // initializes all the buffer objects/arrays
-    void setupMesh()
+    // uploads the vertices in Format's layout and the indices into the geometry arena
+    template<typename Format>
+    void setupMesh(const Vertex *vertexData, size_t vertexCount, const unsigned int *indexData, size_t indexCount)
     {
-        // create buffers/arrays
-        glGenVertexArrays(1, &VAO);
-        glGenBuffers(1, &VBO);
-        glGenBuffers(1, &EBO);
+        this->vertexCount = vertexCount;
+        this->indexCount = indexCount;
+        format = Format::id();
+        if(bounds.empty())
+            for(size_t i = 0; i < vertexCount; i++)
+                bounds.expand(vertexData[i].Position);
+        decode = rg::vertexDecode<Format>(bounds);
 
-        glBindVertexArray(VAO);
-        // load data into vertex buffers
-        glBindBuffer(GL_ARRAY_BUFFER, VBO);
         // A great thing about structs is that their memory layout is sequential for all its items.
         // The effect is that we can simply pass a pointer to the struct and it translates perfectly to a glm::vec3/2 array which
-        // again translates to 3/2 floats which translates to a byte array.
-        glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), &vertices[0], GL_STATIC_DRAW);
-
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), &indices[0], GL_STATIC_DRAW);
-
-        // set the vertex attribute pointers
-        // vertex Positions
-        glEnableVertexAttribArray(0);
-        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)0);
-        // vertex normals
-        glEnableVertexAttribArray(1);
-        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Normal));
-        // vertex texture coords
-        glEnableVertexAttribArray(2);
-        glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, TexCoords));
-        // vertex tangent
-        glEnableVertexAttribArray(3);
-        glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Tangent));
-        // vertex bitangent
-        glEnableVertexAttribArray(4);
-        glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Bitangent));
-
-        glBindVertexArray(0);
+        // again translates to 3/2 floats which translates to a byte array. Other formats are converted first.
+        typedef typename Format::Stored Stored;
+        rg::GeometryArena &arena = rg::GeometryArena::instance();
+        vertexBufferBytes = vertexCount * sizeof(Stored);
+        if(std::is_same<Stored, Vertex>::value)
+            geometry = arena.add<Format>(reinterpret_cast<const Stored *>(vertexData), vertexCount, indexData, indexCount);
+        else
+            geometry = arena.add<Format>(rg::convertVertices<Format>(vertexData, vertexCount, bounds).data(), vertexCount, indexData, indexCount);
+        // shared by every mesh of the format, draw sorting groups them by it
+        VAO = arena.vertexArray(geometry);
     }
 };
 #endif
\ No newline at end of file
@@ -6,18 +6,28 @@
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <stb_image.h>
-#include <assimp/Importer.hpp>
-#include <assimp/scene.h>
-#include <assimp/postprocess.h>
 
 #include <learnopengl/mesh.h>
 #include <learnopengl/shader.h>
-
+#include <rg/CookedAssets.h>
+#include <rg/CpuProfiler.h>
+#include <rg/DepthPyramid.h>
+#include <rg/FrameStats.h>
+#include <rg/Frustum.h>
+#include <rg/MeshCache.h>
+#include <rg/MeshLod.h>
+#include <rg/ModelImport.h>
+#include <rg/OcclusionRasterizer.h>
+#include <rg/TextureRegistry.h>
+
+#include <algorithm>
+#include <chrono>
 #include <string>
 #include <fstream>
 #include <sstream>
 #include <iostream>
 #include <map>
+#include <unordered_map>
 #include <vector>
 using namespace std;
 
@@ -30,14 +40,61 @@ class Model
 public:
     // model data
     vector<Texture> textures_loaded;	// stores all the textures loaded so far, optimization to make sure textures aren't loaded more than once.
+    unordered_map<string, unsigned int> textureIndices; // path -> index into textures_loaded
     vector<Mesh>    meshes;
     string directory;
     bool gammaCorrection;
-
-    // constructor, expects a filepath to a 3D model.
-    Model(string const &path, bool gamma = false) : gammaCorrection(gamma)
+    rg::VertexFormat vertexFormat;              // layout every mesh's vertex buffer is uploaded in
+    unsigned int instanceVBO = 0;
+    unsigned int instanceCount = 0;
+    glm::vec3 instanceCenter = glm::vec3(0.0f); // average instance origin, used to depth sort the model
+    vector<unsigned int> meshInstanceCounts;    // instances each mesh draws, all of them until Cull says otherwise
+    bool buildOccluder;                         // whether loading generates the occluder below
+    rg::OccluderMesh occluder;                  // the largest triangles, for the software occlusion rasterizer
+
+    // constructor, expects a filepath to a 3D model. packed vertex formats need a shader that decodes them
+    // (see rg/VertexFormat.h). occluder: also generate the occluder proxy, only for models drawn as occluders
+    Model(string const &path, bool gamma = false, rg::VertexFormat format = rg::VertexFormat::Float, bool occluder = false)
+    : gammaCorrection(gamma), vertexFormat(format), buildOccluder(occluder)
     {
         loadModel(path);
+        printVertexMemory(path);
+    }
+
+    // bytes of all vertex buffers as uploaded
+    size_t VertexBufferBytes() const
+    {
+        size_t bytes = 0;
+        for(const Mesh &mesh : meshes)
+            bytes += mesh.vertexBufferBytes;
+        return bytes;
+    }
+
+    // frees the model's geometry and instance buffer and packs the geometry arena, so the space is reused by
+    // models loaded later. its texture references go back to the registry, which deletes the textures no other
+    // model still uses.
+    void Unload()
+    {
+        for(Mesh &mesh : meshes)
+            mesh.Release();
+        meshes.clear();
+        rg::TextureRegistry &registry = rg::TextureRegistry::instance();
+        for(const Texture &texture : textures_loaded)
+            registry.release(texture.id);
+        for(const auto &preloaded : texturesPreloaded)
+            registry.release(preloaded.second);
+        textures_loaded.clear();
+        textureIndices.clear();
+        texturesPreloaded.clear();
+        rg::GeometryArena::instance().compact();
+        if(instanceVBO != 0)
+            glDeleteBuffers(1, &instanceVBO);
+        instanceVBO = 0;
+        instanceCount = 0;
+        meshInstanceCounts.clear();
+        meshInstanceFirst.clear();
+        meshLodCounts.clear();
+        meshLodFirst.clear();
     }
 
     // draws the model, and thus all its meshes
@@ -47,213 +104,400 @@ public:
             meshes[i].Draw(shader);
     }
 
+    // places a copy of the model at each of the given transforms, drawn with DrawInstanced.
+    // normal matrices are computed here once instead of per vertex in the shader.
+    void SetInstances(const vector<glm::mat4> &transforms)
+    {
+        instances.assign(transforms.size(), InstanceData());
+        instanceCenter = glm::vec3(0.0f);
+        for(unsigned int i = 0; i < transforms.size(); i++)
+        {
+            instances[i].Model = transforms[i];
+            instances[i].NormalMatrix = glm::mat3(glm::transpose(glm::inverse(transforms[i])));
+            instanceCenter += glm::vec3(transforms[i][3]);
+        }
+        if(!transforms.empty())
+            instanceCenter /= (float)transforms.size();
+
+        // world bounds per instance for the first culling pass, per instance and mesh for the second
+        rg::AABB modelBounds = Bounds();
+        vector<rg::AABB> worldBounds(transforms.size());
+        meshInstanceBounds.resize(transforms.size() * meshes.size());
+        for(unsigned int i = 0; i < transforms.size(); i++)
+        {
+            worldBounds[i] = modelBounds.transformed(transforms[i]);
+            for(unsigned int m = 0; m < meshes.size(); m++)
+                meshInstanceBounds[i * meshes.size() + m] = meshes[m].bounds.transformed(transforms[i]);
+        }
+        instanceBounds.assign(worldBounds);
+        instanceWorldBounds.swap(worldBounds);
+        instanceVisible.assign(transforms.size(), 1);
+        instanceScales.resize(transforms.size());
+        for(unsigned int i = 0; i < transforms.size(); i++)
+            instanceScales[i] = rg::maxScale(transforms[i]);
+        meshInstanceLod.assign(transforms.size() * meshes.size(), 0);
+        visibleInstances.reserve(transforms.size() * meshes.size());
+
+        if(instanceVBO == 0)
+            glGenBuffers(1, &instanceVBO);
+        glBindBuffer(GL_ARRAY_BUFFER, instanceVBO);
+        glBufferData(GL_ARRAY_BUFFER, instances.size() * sizeof(InstanceData), instances.data(), GL_DYNAMIC_DRAW);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        instanceCount = instances.size();
+        meshInstanceCounts.assign(meshes.size(), instanceCount);
+        meshInstanceFirst.assign(meshes.size(), 0);
+        meshLodCounts.assign(meshes.size() * rg::kMaxLodLevels, 0);
+        meshLodFirst.assign(meshes.size() * rg::kMaxLodLevels, 0);
+        for(unsigned int m = 0; m < meshes.size(); m++)
+            meshLodCounts[m * rg::kMaxLodLevels] = instanceCount;
+        culled = false;
+        for(Mesh& mesh : meshes)
+            mesh.SetInstanceBuffer(instanceVBO, 0);
+    }
+
+    // draws every instance set by SetInstances (that survived Cull) with one draw call per mesh and level of detail
+    void DrawInstanced(Shader &shader)
+    {
+        if(instanceCount == 0)
+            return;
+        for(unsigned int i = 0; i < meshes.size(); i++)
+            for(unsigned int lod = 0; lod < meshes[i].LodCount(); lod++)
+                if(MeshLodInstanceCount(i, lod) > 0)
+                    meshes[i].DrawInstanced(shader, MeshLodInstanceCount(i, lod), lod, MeshLodFirstInstance(i, lod));
+    }
+
+    void Cull(const rg::Frustum &frustum)
+    {
+        Cull<rg::HiZReadback>(frustum, nullptr);
+    }
+
+    // Frustum culls the instances, first by the world bounds of the whole model (SIMD, see rg::cullBoxes),
+    // then each mesh of the instances that survived. With occlusion (rg::HiZReadback, rg::OcclusionRasterizer),
+    // instances in the frustum are also tested for being hidden. With a LOD selection every surviving mesh
+    // instance picks its level of detail, starting from the level it had last time. The visible instances are
+    // uploaded grouped by mesh and level and every mesh's instance attributes are pointed at its group.
+    template<typename Occlusion>
+    void Cull(const rg::Frustum &frustum, const Occlusion *occlusion, const rg::LodSelection *lod = nullptr)
+    {
+        RG_PROFILE_SCOPE("Model::Cull");
+        if(instanceCount == 0)
+            return;
+        rg::FrameStats &stats = rg::frameStats();
+        size_t visibleCount = rg::cullBoxes(frustum, instanceBounds, instanceVisible.data());
+        stats.instancesTested += instanceCount;
+        stats.instancesCulled += instanceCount - visibleCount;
+        if(occlusion && occlusion->available())
+        {
+            for(unsigned int i = 0; i < instanceCount; i++)
+            {
+                if(instanceVisible[i] && occlusion->occluded(instanceWorldBounds[i]))
+                {
+                    instanceVisible[i] = 0;
+                    visibleCount--;
+                    stats.instancesOccluded++;
+                }
+            }
+        }
+        stats.instancesVisible += visibleCount;
+
+        visibleInstances.clear();
+        for(unsigned int m = 0; m < meshes.size(); m++)
+        {
+            unsigned int levels = lod ? meshes[m].LodCount() : 1;
+            float errors[rg::kMaxLodLevels];
+            for(unsigned int l = 0; l < levels; l++)
+                errors[l] = meshes[m].LodError(l);
+            meshSurvivors.clear();
+            for(unsigned int i = 0; i < instanceCount; i++)
+            {
+                if(!instanceVisible[i])
+                    continue;
+                stats.meshesTested++;
+                const rg::AABB &bounds = meshInstanceBounds[i * meshes.size() + m];
+                if(!frustum.intersects(bounds))
+                {
+                    stats.meshesCulled++;
+                    continue;
+                }
+                uint8_t &level = meshInstanceLod[i * meshes.size() + m];
+                level = lod ? lod->select(errors, levels, instanceScales[i], bounds, level) : 0;
+                meshSurvivors.push_back(i);
+            }
+
+            size_t first = visibleInstances.size();
+            for(unsigned int l = 0; l < rg::kMaxLodLevels; l++)
+            {
+                size_t levelFirst = visibleInstances.size();
+                if(l < levels)
+                    for(unsigned int i : meshSurvivors)
+                        if(meshInstanceLod[i * meshes.size() + m] == l)
+                            visibleInstances.push_back(instances[i]);
+                meshLodFirst[m * rg::kMaxLodLevels + l] = levelFirst - first;
+                meshLodCounts[m * rg::kMaxLodLevels + l] = visibleInstances.size() - levelFirst;
+                stats.lodInstances[l] += visibleInstances.size() - levelFirst;
+            }
+            meshInstanceCounts[m] = visibleInstances.size() - first;
+            meshInstanceFirst[m] = first;
+        }
+        culled = true;
+
+        glBindBuffer(GL_ARRAY_BUFFER, instanceVBO);
+        glBufferData(GL_ARRAY_BUFFER, visibleInstances.size() * sizeof(InstanceData), visibleInstances.data(), GL_STREAM_DRAW);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        for(unsigned int m = 0; m < meshes.size(); m++)
+            meshes[m].SetInstanceBuffer(instanceVBO, meshInstanceFirst[m]);
+    }
+
+    // every instance, as given to SetInstances
+    const vector<InstanceData> &Instances() const
+    {
+        return instances;
+    }
+
+    // the meshInstanceCounts[mesh] instances mesh draws, the same data its instance buffer range holds
+    const InstanceData *MeshInstances(unsigned int mesh) const
+    {
+        return (culled ? visibleInstances.data() : instances.data()) + meshInstanceFirst[mesh];
+    }
+
+    // the instances mesh draws at a level of detail, a part of MeshInstances(mesh) starting
+    // MeshLodFirstInstance(mesh, lod) instances in. all of them are at level 0 until Cull selects levels
+    unsigned int MeshLodInstanceCount(unsigned int mesh, unsigned int lod) const
+    {
+        return meshLodCounts[mesh * rg::kMaxLodLevels + lod];
+    }
+
+    unsigned int MeshLodFirstInstance(unsigned int mesh, unsigned int lod) const
+    {
+        return meshLodFirst[mesh * rg::kMaxLodLevels + lod];
+    }
+
+    const InstanceData *MeshLodInstances(unsigned int mesh, unsigned int lod) const
+    {
+        return MeshInstances(mesh) + MeshLodFirstInstance(mesh, lod);
+    }
+
+    // object space bounds of the whole model
+    rg::AABB Bounds() const
+    {
+        rg::AABB bounds;
+        for(const Mesh &mesh : meshes)
+            bounds.expand(mesh.bounds);
+        return bounds;
+    }
+
     void SetShaderTextureNamePrefix(std::string prefix) {
         for (Mesh& mesh: meshes) {
             mesh.glslIdentifierPrefix = prefix;
         }
     }
 private:
-    // loads a model with supported ASSIMP extensions from file and stores the resulting meshes in the meshes vector.
+    vector<InstanceData> instances;        // every instance, as given to SetInstances
+    rg::BoundsSoA instanceBounds;          // world bounds of each instance
+    vector<rg::AABB> instanceWorldBounds;  // the same, for the occlusion test
+    vector<rg::AABB> meshInstanceBounds;   // world bounds of mesh m of instance i at [i * meshes.size() + m]
+    vector<uint8_t> instanceVisible;
+    vector<InstanceData> visibleInstances; // this frame's survivors, grouped by mesh and level of detail
+    vector<size_t> meshInstanceFirst;
+    vector<float> instanceScales;          // largest scale of each instance's transform, for LOD errors
+    vector<uint8_t> meshInstanceLod;       // level mesh m of instance i was last drawn at, [i * meshes.size() + m]
+    vector<unsigned int> meshLodCounts;    // instances of mesh m at level l at [m * rg::kMaxLodLevels + l]
+    vector<unsigned int> meshLodFirst;     // where they start in the mesh's group
+    vector<unsigned int> meshSurvivors;    // Cull's scratch list of the instances a mesh survived in
+    bool culled = false;                   // whether the meshes draw visibleInstances or all instances
+
+    // loads a model from its cooked form (see project_base_cook), its binary mesh cache (warm start) or with
+    // ASSIMP (cold start). a cold start writes the cache next to the source file so the next launch can skip ASSIMP entirely.
     void loadModel(string const &path)
     {
-        // read file via ASSIMP
-        Assimp::Importer importer;
-        const aiScene* scene = importer.ReadFile(path, aiProcess_Triangulate | aiProcess_GenSmoothNormals | aiProcess_FlipUVs | aiProcess_CalcTangentSpace);
-        // check for errors
-        if(!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode) // if is Not Zero
-        {
-            cout << "ERROR::ASSIMP:: " << importer.GetErrorString() << endl;
-            return;
-        }
+        RG_PROFILE_SCOPE("Model::loadModel");
+        auto start = std::chrono::steady_clock::now();
         // retrieve the directory path of the filepath
         directory = path.substr(0, path.find_last_of('/'));
 
-        // process ASSIMP's root node recursively
-        processNode(scene->mRootNode, scene);
-    }
-
-    // processes a node in a recursive fashion. Processes each individual mesh located at the node and repeats this process on its children nodes (if any).
-    void processNode(aiNode *node, const aiScene *scene)
-    {
-        // process each mesh located at the current node
-        for(unsigned int i = 0; i < node->mNumMeshes; i++)
+        uint64_t sourceHash = rg::meshSourceHash(path);
+        string cachePath = rg::meshCachePath(path);
+        rg::MeshCacheReader cache;
+        if(sourceHash != 0 && cache.open(rg::cookedModelPath(path), rg::cookedSourceHash(sourceHash)))
         {
-            // the node object only contains indices to index the actual objects in the scene.
-            // the scene contains all the data, node is just to keep stuff organized (like relations between nodes).
-            aiMesh* mesh = scene->mMeshes[node->mMeshes[i]];
-            meshes.push_back(processMesh(mesh, scene));
+            loadFromCache(cache);
+            cout << "MODEL::LOAD:: " << path << " cooked " << millisecondsSince(start) << " ms" << endl;
+            return;
         }
-        // after we've processed all of the meshes (if any) we then recursively process each of the children nodes
-        for(unsigned int i = 0; i < node->mNumChildren; i++)
+        // the LOD settings are part of the hash, a cooker run with another --lod-error makes every cooked model stale
+        if(cache.staleSource())
+            cout << "WARNING::MODEL:: " << rg::cookedModelPath(path) << " doesn't match the source or the LOD settings "
+                 << "(--lod-error has to be the same for the cooker and the game), loading without it" << endl;
+        if(sourceHash != 0 && cache.open(cachePath, sourceHash))
         {
-            processNode(node->mChildren[i], scene);
+            loadFromCache(cache);
+            double warm = millisecondsSince(start);
+            cout << "MODEL::LOAD:: " << path << " warm (cache) " << warm << " ms, cold (assimp) was "
+                 << cache.coldLoadMilliseconds() << " ms (" << cache.coldLoadMilliseconds() / warm << "x faster)" << endl;
+            return;
         }
 
+        // read file via ASSIMP, welded and reordered for the vertex cache (rg/MeshOptimizer.h)
+        vector<rg::ImportedMesh> imported;
+        rg::VertexCacheStats before, after;
+        if(!rg::importModel(path, imported, &before, &after))
+            return;
+        rg::printVertexCacheStats(cout, path, before, after);
+
+        // decode every texture the meshes reference up front, in parallel
+        vector<string> paths;
+        for(const rg::ImportedMesh& mesh : imported)
+            for(const rg::TextureRef& ref : mesh.textures)
+                paths.push_back(ref.path);
+        preloadTextures(paths);
+        rg::OccluderBuilder occluderBuilder;
+        for(const rg::ImportedMesh& mesh : imported)
+        {
+            if(buildOccluder)
+                occluderBuilder.addMesh(mesh.vertices.data(), mesh.vertices.size(), mesh.indices.data(), mesh.indices.size());
+            vector<Texture> textures;
+            for(const rg::TextureRef& ref : mesh.textures)
+                textures.push_back(loadTexture(ref.path.c_str(), ref.type));
+            rg::visitVertexFormat<Vertex>(vertexFormat, [&](auto format) {
+                meshes.push_back(Mesh(mesh.vertices, mesh.indices, textures, mesh.bounds, format));
+            });
+            for(const rg::MeshLod& lod : mesh.lods)
+                meshes.back().AddLod(lod.indices.data(), lod.indices.size(), lod.error);
+        }
+        if(buildOccluder)
+            occluder = occluderBuilder.build();
+
+        double cold = millisecondsSince(start);
+        cout << "MODEL::LOAD:: " << path << " cold (assimp) " << cold << " ms" << endl;
+        if(sourceHash != 0)
+        {
+            rg::MeshCacheWriter writer;
+            for(unsigned int i = 0; i < meshes.size(); i++)
+                writer.addMesh(meshes[i].vertices, meshes[i].indices, meshes[i].textures, meshes[i].bounds, &imported[i].lods);
+            if(!writer.write(cachePath, sourceHash, cold))
+                cout << "ERROR::MESH_CACHE:: failed to write " << cachePath << endl;
+        }
     }
 
-    Mesh processMesh(aiMesh *mesh, const aiScene *scene)
+    // builds the meshes straight from the mapped cache, vertex and index data go to the GPU without being copied
+    void loadFromCache(const rg::MeshCacheReader &cache)
     {
-        // data to fill
-        vector<Vertex> vertices;
-        vector<unsigned int> indices;
-        vector<Texture> textures;
-
-        // walk through each of the mesh's vertices
-        for(unsigned int i = 0; i < mesh->mNumVertices; i++)
+        vector<string> paths;
+        for(const rg::CachedMesh& cached : cache.meshes())
+            for(const rg::TextureRef& ref : cached.textures)
+                paths.push_back(ref.path);
+        preloadTextures(paths);
+
+        rg::OccluderBuilder occluderBuilder;
+        for(const rg::CachedMesh& cached : cache.meshes())
         {
-            Vertex vertex;
-            glm::vec3 vector; // we declare a placeholder vector since assimp_ uses its own vector class that doesn't directly convert to glm's vec3 class so we transfer the data to this placeholder glm::vec3 first.
-            // positions
-            vector.x = mesh->mVertices[i].x;
-            vector.y = mesh->mVertices[i].y;
-            vector.z = mesh->mVertices[i].z;
-            vertex.Position = vector;
-            // normals
-            if (mesh->HasNormals())
-            {
-                vector.x = mesh->mNormals[i].x;
-                vector.y = mesh->mNormals[i].y;
-                vector.z = mesh->mNormals[i].z;
-                vertex.Normal = vector;
-            }
-            // texture coordinates
-            if(mesh->mTextureCoords[0]) // does the mesh contain texture coordinates?
-            {
-                glm::vec2 vec;
-                // a vertex can contain up to 8 different texture coordinates. We thus make the assumption that we won't
-                // use models where a vertex can have multiple texture coordinates so we always take the first set (0).
-                vec.x = mesh->mTextureCoords[0][i].x;
-                vec.y = mesh->mTextureCoords[0][i].y;
-                vertex.TexCoords = vec;
-                // tangent
-                vector.x = mesh->mTangents[i].x;
-                vector.y = mesh->mTangents[i].y;
-                vector.z = mesh->mTangents[i].z;
-                vertex.Tangent = vector;
-                // bitangent
-                vector.x = mesh->mBitangents[i].x;
-                vector.y = mesh->mBitangents[i].y;
-                vector.z = mesh->mBitangents[i].z;
-                vertex.Bitangent = vector;
-            }
-            else
-                vertex.TexCoords = glm::vec2(0.0f, 0.0f);
+            if(buildOccluder)
+                occluderBuilder.addMesh(cached.vertices, cached.vertexCount, cached.indices, cached.indexCount);
+            vector<Texture> textures;
+            for(const rg::TextureRef& ref : cached.textures)
+                textures.push_back(loadTexture(ref.path.c_str(), ref.type));
+            rg::visitVertexFormat<Vertex>(vertexFormat, [&](auto format) {
+                meshes.push_back(Mesh(cached.vertices, cached.vertexCount, cached.indices, cached.indexCount, textures,
+                                      cached.bounds, format));
+            });
+            for(const rg::CachedLod& lod : cached.lods)
+                meshes.back().AddLod(lod.indices, lod.indexCount, lod.error);
+        }
+        if(buildOccluder)
+            occluder = occluderBuilder.build();
+    }
 
-            vertices.push_back(vertex);
+    void printVertexMemory(const string &path) const
+    {
+        size_t vertexCount = 0;
+        for(const Mesh &mesh : meshes)
+            vertexCount += mesh.vertexCount;
+        cout << "MODEL::VERTICES:: " << path << " " << vertexCount << " vertices, " << VertexBufferBytes() / 1024.0
+             << " KiB as " << rg::vertexFormatName(vertexFormat) << " (" << vertexCount * sizeof(Vertex) / 1024.0
+             << " KiB as float)";
+        if(buildOccluder)
+            cout << ", occluder " << occluder.triangleCount() << " triangles";
+        cout << endl;
+
+        // triangles of the whole model per level, meshes with fewer levels count their coarsest
+        cout << "MODEL::LOD:: " << path << " triangles per level:";
+        for(unsigned int lod = 0; lod < rg::kMaxLodLevels; lod++)
+        {
+            size_t triangles = 0;
+            for(const Mesh &mesh : meshes)
+                triangles += mesh.LodIndexCount(std::min(lod, mesh.LodCount() - 1)) / 3;
+            cout << " " << triangles;
+        }
+        cout << endl;
+    }
 
+    static double millisecondsSince(std::chrono::steady_clock::time_point start)
+    {
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
 
-        }
-        // now wak through each of the mesh's faces (a face is a mesh its triangle) and retrieve the corresponding vertex indices.
-        for(unsigned int i = 0; i < mesh->mNumFaces; i++)
+    // returns the texture at the given path (relative to the model directory), loading it only once per model
+    Texture loadTexture(const char *path, const string &typeName)
+    {
+        // check if texture was loaded before and if so, return it: skip loading a new texture
+        auto loaded = textureIndices.find(path);
+        if(loaded != textureIndices.end())
+            return textures_loaded[loaded->second]; // a texture with the same filepath has already been loaded (optimization)
+        // if texture hasn't been loaded already, take it from the preloaded ones or load it
+        Texture texture;
+        auto preloaded = texturesPreloaded.find(path);
+        if(preloaded != texturesPreloaded.end())
         {
-            aiFace face = mesh->mFaces[i];
-            // retrieve all indices of the face and store them in the indices vector
-            for(unsigned int j = 0; j < face.mNumIndices; j++)
-                indices.push_back(face.mIndices[j]);
+            texture.id = preloaded->second;
+            texturesPreloaded.erase(preloaded);
         }
-        // process materials
-        aiMaterial* material = scene->mMaterials[mesh->mMaterialIndex];
-        // we assume a convention for sampler names in the shaders. Each diffuse texture should be named
-        // as 'texture_diffuseN' where N is a sequential number ranging from 1 to MAX_SAMPLER_NUMBER.
-        // Same applies to other texture as the following list summarizes:
-        // diffuse: texture_diffuseN
-        // specular: texture_specularN
-        // normal: texture_normalN
-        aiColor3D color(0.0f, 0.0f, 0.0f);
-        material->Get(AI_MATKEY_COLOR_AMBIENT, color);
-
-
-        // 1. diffuse maps
-        vector<Texture> diffuseMaps = loadMaterialTextures(material, aiTextureType_DIFFUSE, "texture_diffuse");
-        textures.insert(textures.end(), diffuseMaps.begin(), diffuseMaps.end());
-        // 2. specular maps
-        vector<Texture> specularMaps = loadMaterialTextures(material, aiTextureType_SPECULAR, "texture_specular");
-        textures.insert(textures.end(), specularMaps.begin(), specularMaps.end());
-        // 3. normal maps
-        std::vector<Texture> normalMaps = loadMaterialTextures(material, aiTextureType_HEIGHT, "texture_normal");
-        textures.insert(textures.end(), normalMaps.begin(), normalMaps.end());
-        // 4. height maps
-        std::vector<Texture> heightMaps = loadMaterialTextures(material, aiTextureType_AMBIENT, "texture_height");
-        textures.insert(textures.end(), heightMaps.begin(), heightMaps.end());
-
-
-
-        // return a mesh object created from the extracted mesh data
-        return Mesh(vertices, indices, textures);
+        else
+            texture.id = TextureFromFile(path, this->directory);
+        texture.type = typeName;
+        texture.path = path;
+        textureIndices[texture.path] = textures_loaded.size();
+        textures_loaded.push_back(texture);  // store it as texture loaded for entire model, to ensure we won't unnecesery load duplicate textures.
+        return texture;
     }
 
-    // checks all material textures of a given type and loads the textures if they're not loaded yet.
-    // the required info is returned as a Texture struct.
-    vector<Texture> loadMaterialTextures(aiMaterial *mat, aiTextureType type, string typeName)
+    // acquires the given textures from the registry in one batch, so the ones no other model has loaded yet are
+    // decoded concurrently. the resulting ids are picked up by loadTexture, which keeps deduplication and types
+    // exactly as in the serial path.
+    void preloadTextures(const vector<string> &paths)
     {
-        vector<Texture> textures;
-        for(unsigned int i = 0; i < mat->GetTextureCount(type); i++)
+        RG_PROFILE_SCOPE("Model::preloadTextures");
+        vector<string> unique;
+        vector<string> filenames;
+        for(const string& path : paths)
         {
-            aiString str;
-            mat->GetTexture(type, i, &str);
-            // check if texture was loaded before and if so, continue to next iteration: skip loading a new texture
-            bool skip = false;
-            for(unsigned int j = 0; j < textures_loaded.size(); j++)
-            {
-                if(std::strcmp(textures_loaded[j].path.data(), str.C_Str()) == 0)
-                {
-                    textures.push_back(textures_loaded[j]);
-                    skip = true; // a texture with the same filepath has already been loaded, continue to next one. (optimization)
-                    break;
-                }
-            }
-            if(!skip)
-            {   // if texture hasn't been loaded already, load it
-                Texture texture;
-                texture.id = TextureFromFile(str.C_Str(), this->directory);
-                texture.type = typeName;
-                texture.path = str.C_Str();
-                textures.push_back(texture);
-                textures_loaded.push_back(texture);  // store it as texture loaded for entire model, to ensure we won't unnecesery load duplicate textures.
-            }
+            if(textureIndices.count(path) != 0 || texturesPreloaded.count(path) != 0
+               || std::find(unique.begin(), unique.end(), path) != unique.end())
+                continue;
+            unique.push_back(path);
+            filenames.push_back(directory + '/' + path);
         }
-        return textures;
+        if(unique.empty())
+            return;
+
+        auto start = std::chrono::steady_clock::now();
+        vector<unsigned int> ids = rg::TextureRegistry::instance().acquire2D(filenames, rg::TextureWrap::Repeat);
+        for(unsigned int i = 0; i < unique.size(); i++)
+            texturesPreloaded[unique[i]] = ids[i];
+        cout << "MODEL::TEXTURES:: " << unique.size() << " acquired on " << rg::ThreadPool::shared().size()
+             << " threads in " << millisecondsSince(start) << " ms" << endl;
     }
+
+    // ids of textures uploaded by preloadTextures that loadTexture hasn't handed out yet
+    unordered_map<string, unsigned int> texturesPreloaded;
 };
 
 
 unsigned int TextureFromFile(const char *path, const string &directory, bool gamma)
 {
+    RG_PROFILE_FUNCTION();
     string filename = string(path);
     filename = directory + '/' + filename;
 
-    unsigned int textureID;
-    glGenTextures(1, &textureID);
-
-    int width, height, nrComponents;
-    unsigned char *data = stbi_load(filename.c_str(), &width, &height, &nrComponents, 0);
-    if (data)
-    {
-        GLenum format;
-        if (nrComponents == 1)
-            format = GL_RED;
-        else if (nrComponents == 3)
-            format = GL_RGB;
-        else if (nrComponents == 4)
-            format = GL_RGBA;
-
-        glBindTexture(GL_TEXTURE_2D, textureID);
-        glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
-        glGenerateMipmap(GL_TEXTURE_2D);
-
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-        stbi_image_free(data);
-    }
-    else
-    {
-        std::cout << "Texture failed to load at path: " << path << std::endl;
-        stbi_image_free(data);
-    }
-
-    return textureID;
+    return rg::TextureRegistry::instance().acquire2D(filename, rg::TextureWrap::Repeat);
 }
 #endif
@@ -8,7 +8,31 @@
 #include <fstream>
 #include <sstream>
 #include <iostream>
+#include <type_traits>
+#include <unordered_map>
 #include <common.h>
+#include <rg/Compute.h>
+#include <rg/CpuProfiler.h>
+#include <rg/Hash.h>
+#include <rg/FrameStats.h>
+#include <rg/GLState.h>
+#include <rg/UniformBlocks.h>
+
+// a hashed uniform name. constexpr UniformName kView("view"); or UNIFORM("view") hash at compile time.
+struct UniformName
+{
+    uint64_t hash;
+    constexpr explicit UniformName(const char *name) : hash(rg::hashString(name)) {}
+    constexpr explicit UniformName(uint64_t nameHash) : hash(nameHash) {}
+};
+#define UNIFORM(literal) UniformName(std::integral_constant<uint64_t, rg::hashString(literal)>::value)
+
+// a pre-resolved uniform location, setting it is a single glUniform* call
+struct UniformHandle
+{
+    GLint location = -1;
+};
+
 class Shader
 {
 public:
@@ -17,6 +41,7 @@ public:
     // ------------------------------------------------------------------------
     Shader(const char* vertexPath, const char* fragmentPath, const char* geometryPath = nullptr)
     {
+        RG_PROFILE_SCOPE("Shader::Shader");
         std::string vertexPathString(vertexPath);
         std::string fragmentPathString(fragmentPath);
 
@@ -102,73 +127,260 @@ public:
         if(geometryPath != nullptr)
             glDeleteShader(geometry);
 
+        reflectUniforms();
+        bindUniformBlocks();
     }
-    // activate the shader
+    // compute shader constructor, only for contexts with compute shaders (see rg::loadCompute)
+    // ------------------------------------------------------------------------
+    explicit Shader(const char* computePath)
+    {
+        RG_PROFILE_SCOPE("Shader::Shader");
+        std::string computeCode;
+        std::ifstream cShaderFile;
+        cShaderFile.exceptions (std::ifstream::failbit | std::ifstream::badbit);
+        try
+        {
+            cShaderFile.open(computePath);
+            std::stringstream cShaderStream;
+            cShaderStream << cShaderFile.rdbuf();
+            cShaderFile.close();
+            computeCode = cShaderStream.str();
+        }
+        catch (std::ifstream::failure& e)
+        {
+            std::cout << "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ" << std::endl;
+        }
+        const char* cShaderCode = computeCode.c_str();
+        unsigned int compute = glCreateShader(GL_COMPUTE_SHADER);
+        glShaderSource(compute, 1, &cShaderCode, NULL);
+        glCompileShader(compute);
+        checkCompileErrors(compute, "COMPUTE");
+        ID = glCreateProgram();
+        glAttachShader(ID, compute);
+        glLinkProgram(ID);
+        checkCompileErrors(ID, "PROGRAM");
+        glDeleteShader(compute);
+
+        reflectUniforms();
+        bindUniformBlocks();
+    }
+    // activate the shader, a no-op if it already is
     // ------------------------------------------------------------------------
     void use() 
     { 
-        glUseProgram(ID); 
+        rg::GLState::instance().useProgram(ID); 
     }
-    // utility uniform functions
+    // uniform handles, resolve once and keep them around for the per-frame code
     // ------------------------------------------------------------------------
-    void setBool(const std::string &name, bool value) const
-    {         
-        glUniform1i(glGetUniformLocation(ID, name.c_str()), (int)value); 
+    UniformHandle uniform(UniformName name) const
+    {
+        auto found = uniformLocations.find(name.hash);
+        return UniformHandle{found != uniformLocations.end() ? found->second : -1};
+    }
+    UniformHandle uniform(const std::string &name) const
+    {
+        return uniform(UniformName(name.c_str()));
     }
+    // utility uniform functions, by handle
     // ------------------------------------------------------------------------
-    void setInt(const std::string &name, int value) const
-    { 
-        glUniform1i(glGetUniformLocation(ID, name.c_str()), value); 
+    void setBool(UniformHandle handle, bool value) const
+    {
+        upload();
+        glUniform1i(handle.location, (int)value);
+    }
+    void setInt(UniformHandle handle, int value) const
+    {
+        upload();
+        glUniform1i(handle.location, value);
+    }
+    void setFloat(UniformHandle handle, float value) const
+    {
+        upload();
+        glUniform1f(handle.location, value);
+    }
+    void setVec2(UniformHandle handle, const glm::vec2 &value) const
+    {
+        upload();
+        glUniform2fv(handle.location, 1, &value[0]);
+    }
+    void setVec3(UniformHandle handle, const glm::vec3 &value) const
+    {
+        upload();
+        glUniform3fv(handle.location, 1, &value[0]);
+    }
+    void setVec4(UniformHandle handle, const glm::vec4 &value) const
+    {
+        upload();
+        glUniform4fv(handle.location, 1, &value[0]);
+    }
+    void setMat2(UniformHandle handle, const glm::mat2 &mat) const
+    {
+        upload();
+        glUniformMatrix2fv(handle.location, 1, GL_FALSE, &mat[0][0]);
     }
+    void setMat3(UniformHandle handle, const glm::mat3 &mat) const
+    {
+        upload();
+        glUniformMatrix3fv(handle.location, 1, GL_FALSE, &mat[0][0]);
+    }
+    void setMat4(UniformHandle handle, const glm::mat4 &mat) const
+    {
+        upload();
+        glUniformMatrix4fv(handle.location, 1, GL_FALSE, &mat[0][0]);
+    }
+    // utility uniform functions, by name. the location comes from the table built at link time,
+    // so these never reach the driver, but they still hash the name on every call.
     // ------------------------------------------------------------------------
-    void setFloat(const std::string &name, float value) const
-    { 
-        glUniform1f(glGetUniformLocation(ID, name.c_str()), value); 
+    template<typename Name>
+    void setBool(const Name &name, bool value) const
+    {
+        setBool(lookup(name), value);
     }
     // ------------------------------------------------------------------------
-    void setVec2(const std::string &name, const glm::vec2 &value) const
-    { 
-        glUniform2fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]); 
+    template<typename Name>
+    void setInt(const Name &name, int value) const
+    {
+        setInt(lookup(name), value);
     }
-    void setVec2(const std::string &name, float x, float y) const
-    { 
-        glUniform2f(glGetUniformLocation(ID, name.c_str()), x, y); 
+    // ------------------------------------------------------------------------
+    template<typename Name>
+    void setFloat(const Name &name, float value) const
+    {
+        setFloat(lookup(name), value);
     }
     // ------------------------------------------------------------------------
-    void setVec3(const std::string &name, const glm::vec3 &value) const
-    { 
-        glUniform3fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]); 
+    template<typename Name>
+    void setVec2(const Name &name, const glm::vec2 &value) const
+    {
+        setVec2(lookup(name), value);
     }
-    void setVec3(const std::string &name, float x, float y, float z) const
-    { 
-        glUniform3f(glGetUniformLocation(ID, name.c_str()), x, y, z); 
+    template<typename Name>
+    void setVec2(const Name &name, float x, float y) const
+    {
+        setVec2(lookup(name), glm::vec2(x, y));
     }
     // ------------------------------------------------------------------------
-    void setVec4(const std::string &name, const glm::vec4 &value) const
-    { 
-        glUniform4fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]); 
+    template<typename Name>
+    void setVec3(const Name &name, const glm::vec3 &value) const
+    {
+        setVec3(lookup(name), value);
     }
-    void setVec4(const std::string &name, float x, float y, float z, float w) 
-    { 
-        glUniform4f(glGetUniformLocation(ID, name.c_str()), x, y, z, w); 
+    template<typename Name>
+    void setVec3(const Name &name, float x, float y, float z) const
+    {
+        setVec3(lookup(name), glm::vec3(x, y, z));
     }
     // ------------------------------------------------------------------------
-    void setMat2(const std::string &name, const glm::mat2 &mat) const
+    template<typename Name>
+    void setVec4(const Name &name, const glm::vec4 &value) const
     {
-        glUniformMatrix2fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        setVec4(lookup(name), value);
+    }
+    template<typename Name>
+    void setVec4(const Name &name, float x, float y, float z, float w) const
+    {
+        setVec4(lookup(name), glm::vec4(x, y, z, w));
+    }
+    // ------------------------------------------------------------------------
+    template<typename Name>
+    void setMat2(const Name &name, const glm::mat2 &mat) const
+    {
+        setMat2(lookup(name), mat);
     }
     // ------------------------------------------------------------------------
-    void setMat3(const std::string &name, const glm::mat3 &mat) const
+    template<typename Name>
+    void setMat3(const Name &name, const glm::mat3 &mat) const
     {
-        glUniformMatrix3fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        setMat3(lookup(name), mat);
     }
     // ------------------------------------------------------------------------
-    void setMat4(const std::string &name, const glm::mat4 &mat) const
+    template<typename Name>
+    void setMat4(const Name &name, const glm::mat4 &mat) const
     {
-        glUniformMatrix4fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        setMat4(lookup(name), mat);
     }
 
 private:
+    // hash of the uniform name -> location, filled once after linking
+    std::unordered_map<uint64_t, GLint> uniformLocations;
+
+    // asks the driver for every active uniform once, so setting uniforms never has to.
+    // array uniforms are registered under their plain name and under each element's name.
+    // ------------------------------------------------------------------------
+    void reflectUniforms()
+    {
+        GLint count = 0, maxLength = 0;
+        glGetProgramiv(ID, GL_ACTIVE_UNIFORMS, &count);
+        glGetProgramiv(ID, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+        std::string name(maxLength > 0 ? maxLength : 1, '\0');
+        for(GLint i = 0; i < count; i++)
+        {
+            GLsizei length = 0;
+            GLint size = 0;
+            GLenum type;
+            glGetActiveUniform(ID, i, maxLength, &length, &size, &type, &name[0]);
+            std::string uniformName = name.substr(0, length);
+            GLint location = driverLookup(uniformName);
+            if(location < 0) // lives in a uniform block
+                continue;
+            uniformLocations[rg::hashString(uniformName.c_str())] = location;
+            std::string::size_type bracket = uniformName.rfind("[0]");
+            if(bracket != std::string::npos && bracket + 3 == uniformName.size())
+            {
+                std::string base = uniformName.substr(0, bracket);
+                uniformLocations[rg::hashString(base.c_str())] = location;
+                for(GLint element = 1; element < size; element++)
+                {
+                    std::string elementName = base + "[" + std::to_string(element) + "]";
+                    uniformLocations[rg::hashString(elementName.c_str())] = driverLookup(elementName);
+                }
+            }
+        }
+    }
+
+    // the only place glGetUniformLocation is called, counted so P shows it never happens after link time
+    // ------------------------------------------------------------------------
+    GLint driverLookup(const std::string &name) const
+    {
+        rg::frameStats().uniformDriverLookups++;
+        return glGetUniformLocation(ID, name.c_str());
+    }
+
+    // attaches the shared blocks (FrameData, LightData, ...) to their fixed binding points
+    // ------------------------------------------------------------------------
+    void bindUniformBlocks()
+    {
+        GLint count = 0;
+        glGetProgramiv(ID, GL_ACTIVE_UNIFORM_BLOCKS, &count);
+        for(GLint i = 0; i < count; i++)
+        {
+            GLchar name[256];
+            glGetActiveUniformBlockName(ID, i, sizeof(name), nullptr, name);
+            GLint binding = rg::uniformBlockBinding(name);
+            if(binding >= 0)
+                glUniformBlockBinding(ID, i, binding);
+        }
+    }
+
+    UniformHandle lookup(UniformName name) const
+    {
+        rg::frameStats().uniformNameLookups++;
+        return uniform(name);
+    }
+    UniformHandle lookup(const std::string &name) const
+    {
+        return lookup(UniformName(name.c_str()));
+    }
+    UniformHandle lookup(const char *name) const
+    {
+        return lookup(UniformName(name));
+    }
+
+    static void upload()
+    {
+        rg::frameStats().uniformUploads++;
+    }
+
     // utility function for checking shader compilation/linking errors.
     // ------------------------------------------------------------------------
     void checkCompileErrors(GLuint shader, std::string type)
@@ -0,0 +1,192 @@
+//
+// Created by matf-rg on 16.10.26..
+//
+
+#ifndef PROJECT_BASE_BENCHMARK_H
+#define PROJECT_BASE_BENCHMARK_H
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace rg {
+
+    struct CameraPose {
+        glm::vec3 position;
+        float yaw;   // degrees, as in Camera
+        float pitch;
+    };
+
+    // reads the camera pose ProgramState saves: clear color (3 lines), ImGui flag, position (3), front (3)
+    inline bool loadSavedPose(const std::string& path, glm::vec3& position, glm::vec3& front) {
+        std::ifstream in(path);
+        float skipped[4];
+        if (!(in >> skipped[0] >> skipped[1] >> skipped[2] >> skipped[3])) {
+            return false;
+        }
+        return static_cast<bool>(in >> position.x >> position.y >> position.z >> front.x >> front.y >> front.z);
+    }
+
+    // The camera path of --benchmark: one full orbit around center over the run, starting from the saved pose
+    // and always facing the center. Depends on nothing but the frame index, so every run sees the same frames.
+    class BenchmarkPath {
+    public:
+        BenchmarkPath(const glm::vec3& start, const glm::vec3& center, unsigned int frames)
+        : m_center(center), m_frames(std::max(frames, 1u)) {
+            glm::vec2 offset(start.x - center.x, start.z - center.z);
+            m_radius = std::max(glm::length(offset), 1.0f);
+            m_startAngle = std::atan2(offset.y, offset.x);
+            // a saved pose under the floor would look at the scene from below
+            m_height = std::max(start.y, center.y);
+        }
+
+        CameraPose at(unsigned int frame) const {
+            float angle = m_startAngle + 6.2831853f * (frame % m_frames) / m_frames;
+            CameraPose pose;
+            pose.position = glm::vec3(m_center.x + m_radius * std::cos(angle), m_height, m_center.z + m_radius * std::sin(angle));
+            glm::vec3 front = glm::normalize(m_center - pose.position);
+            pose.yaw = glm::degrees(std::atan2(front.z, front.x));
+            pose.pitch = glm::degrees(std::asin(front.y));
+            return pose;
+        }
+
+    private:
+        glm::vec3 m_center;
+        unsigned int m_frames;
+        float m_radius;
+        float m_startAngle;
+        float m_height;
+    };
+
+    // per frame measurements of a benchmark run, summarized as JSON
+    class BenchmarkReport {
+    public:
+        // layout and total size of the models' vertex buffers, for comparing runs with different formats
+        void setVertexBuffers(const std::string& format, size_t bytes) {
+            m_vertexFormat = format;
+            m_vertexBufferBytes = bytes;
+        }
+
+        // how the scene was submitted and how many instances it places
+        void setSubmission(const std::string& path, unsigned int instances) {
+            m_submitPath = path;
+            m_instances = instances;
+        }
+
+        // where culling ran and whether it tested occlusion
+        void setCulling(const std::string& culling) {
+            m_culling = culling;
+        }
+
+        // level of detail settings, or "off"
+        void setLod(const std::string& lod) {
+            m_lod = lod;
+        }
+
+        // sceneMilliseconds is the GPU time of the geometry pass, where the vertex format shows,
+        // submitMilliseconds the CPU time of submitting it, occludedRatio FrameStats::occludedRatio
+        void add(double milliseconds, double sceneMilliseconds, double submitMilliseconds, unsigned int drawCalls,
+                 unsigned long long triangles, double occludedRatio) {
+            m_milliseconds.push_back(milliseconds);
+            m_sceneMilliseconds.push_back(sceneMilliseconds);
+            m_submitMilliseconds.push_back(submitMilliseconds);
+            m_drawCalls.push_back(drawCalls);
+            m_triangles.push_back(static_cast<double>(triangles));
+            m_occludedRatios.push_back(occludedRatio);
+        }
+
+        void write(std::ostream& out, const std::string& renderer, unsigned int width, unsigned int height,
+                   unsigned int warmupFrames) const {
+            out << "{\n";
+            out << "  \"renderer\": \"" << escaped(renderer) << "\",\n";
+            out << "  \"width\": " << width << ",\n";
+            out << "  \"height\": " << height << ",\n";
+            out << "  \"warmupFrames\": " << warmupFrames << ",\n";
+            out << "  \"vertexFormat\": \"" << escaped(m_vertexFormat) << "\",\n";
+            out << "  \"vertexBufferBytes\": " << m_vertexBufferBytes << ",\n";
+            out << "  \"submitPath\": \"" << escaped(m_submitPath) << "\",\n";
+            out << "  \"instances\": " << m_instances << ",\n";
+            out << "  \"culling\": \"" << escaped(m_culling) << "\",\n";
+            out << "  \"lod\": \"" << escaped(m_lod) << "\",\n";
+            out << "  \"frames\": " << m_milliseconds.size() << ",\n";
+            out << "  \"frameMilliseconds\": ";
+            writeSummary(out, m_milliseconds);
+            out << ",\n  \"sceneGpuMilliseconds\": ";
+            writeSummary(out, m_sceneMilliseconds);
+            out << ",\n  \"submitCpuMilliseconds\": ";
+            writeSummary(out, m_submitMilliseconds);
+            out << ",\n  \"drawCalls\": ";
+            writeSummary(out, m_drawCalls);
+            out << ",\n  \"triangles\": ";
+            writeSummary(out, m_triangles);
+            out << ",\n  \"occludedInstanceRatio\": ";
+            writeSummary(out, m_occludedRatios);
+            out << "\n}" << std::endl;
+        }
+
+        bool write(const std::string& path, const std::string& renderer, unsigned int width, unsigned int height,
+                   unsigned int warmupFrames) const {
+            std::ofstream out(path);
+            if (!out) {
+                std::cout << "ERROR::BENCHMARK:: could not write " << path << std::endl;
+                return false;
+            }
+            write(out, renderer, width, height, warmupFrames);
+            return static_cast<bool>(out);
+        }
+
+    private:
+        std::string m_vertexFormat;
+        size_t m_vertexBufferBytes = 0;
+        std::string m_submitPath;
+        unsigned int m_instances = 0;
+        std::string m_culling;
+        std::string m_lod;
+        std::vector<double> m_milliseconds;
+        std::vector<double> m_sceneMilliseconds;
+        std::vector<double> m_submitMilliseconds;
+        std::vector<double> m_drawCalls;
+        std::vector<double> m_triangles;
+        std::vector<double> m_occludedRatios;
+
+        // nearest rank percentile of sorted values
+        static double percentile(const std::vector<double>& sorted, double p) {
+            size_t rank = static_cast<size_t>(std::ceil(p / 100.0 * sorted.size()));
+            return sorted[std::min(std::max(rank, size_t(1)), sorted.size()) - 1];
+        }
+
+        static void writeSummary(std::ostream& out, std::vector<double> values) {
+            if (values.empty()) {
+                out << "null";
+                return;
+            }
+            std::sort(values.begin(), values.end());
+            double sum = 0.0;
+            for (double value : values) {
+                sum += value;
+            }
+            out << "{\"min\": " << values.front() << ", \"avg\": " << sum / values.size()
+                << ", \"p50\": " << percentile(values, 50.0) << ", \"p90\": " << percentile(values, 90.0)
+                << ", \"p95\": " << percentile(values, 95.0) << ", \"p99\": " << percentile(values, 99.0)
+                << ", \"max\": " << values.back() << "}";
+        }
+
+        static std::string escaped(const std::string& text) {
+            std::string result;
+            for (char c : text) {
+                if (c == '"' || c == '\\') {
+                    result += '\\';
+                }
+                result += c;
+            }
+            return result;
+        }
+    };
+}
+
+#endif //PROJECT_BASE_BENCHMARK_H
@@ -0,0 +1,258 @@
+//
+// Created by matf-rg on 16.10.26..
+//
+
+#ifndef PROJECT_BASE_BLOOM_H
+#define PROJECT_BASE_BLOOM_H
+
+#include <glad/glad.h>
+#include <learnopengl/shader.h>
+#include <rg/GLState.h>
+
+#include <algorithm>
+#include <iostream>
+#include <vector>
+
+namespace rg {
+
+    // The original bloom: a 9 tap gaussian run back and forth between two full resolution RGBA16F buffers,
+    // horizontal then vertical, 10 passes by default. Kept as the legacy path the mip chain is compared against.
+    class BloomPingPong {
+    public:
+        BloomPingPong(unsigned int width, unsigned int height)
+        : m_blur("resources/shaders/blur.vs", "resources/shaders/blur.fs"), m_width(width), m_height(height) {
+            GLState& state = GLState::instance();
+            glGenFramebuffers(2, m_framebuffers);
+            glGenTextures(2, m_textures);
+            for (unsigned int i = 0; i < 2; ++i) {
+                glBindFramebuffer(GL_FRAMEBUFFER, m_framebuffers[i]);
+                state.bindTexture(0, GL_TEXTURE_2D, m_textures[i]);
+                glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, width, height, 0, GL_RGBA, GL_FLOAT, nullptr);
+                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+                glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, m_textures[i], 0);
+                if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+                    std::cout << "ERROR::BLOOM:: ping-pong framebuffer " << width << "x" << height << " not complete" << std::endl;
+                }
+            }
+            glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+            m_blur.use();
+            m_blur.setInt("image", 0);
+            m_horizontal = m_blur.uniform(UNIFORM("horizontal"));
+        }
+
+        BloomPingPong(const BloomPingPong&) = delete;
+        BloomPingPong& operator=(const BloomPingPong&) = delete;
+
+        ~BloomPingPong() {
+            for (unsigned int texture : m_textures) {
+                GLState::instance().forgetTexture(texture);
+            }
+            glDeleteTextures(2, m_textures);
+            glDeleteFramebuffers(2, m_framebuffers);
+        }
+
+        // blurs the bright color attachment and returns the texture holding the result. leaves the default
+        // framebuffer bound with the viewport it found.
+        unsigned int render(unsigned int brightColor, unsigned int quadVAO, unsigned int passes = kDefaultPasses) {
+            GLState& state = GLState::instance();
+            GLint viewport[4];
+            glGetIntegerv(GL_VIEWPORT, viewport);
+            glViewport(0, 0, m_width, m_height);
+            state.bindVertexArray(quadVAO);
+            state.disable(GL_BLEND);
+
+            m_blur.use();
+            bool horizontal = true;
+            for (unsigned int i = 0; i < passes; i++) {
+                glBindFramebuffer(GL_FRAMEBUFFER, m_framebuffers[horizontal]);
+                m_blur.setInt(m_horizontal, horizontal);
+                state.bindTexture(0, GL_TEXTURE_2D, i == 0 ? brightColor : m_textures[!horizontal]);
+                glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+                horizontal = !horizontal;
+            }
+
+            glBindFramebuffer(GL_FRAMEBUFFER, 0);
+            glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+            return m_textures[!horizontal];
+        }
+
+        // estimated bytes sampled per frame, counted like BloomMipChain::bytesRead: passes full resolution
+        // passes of 9 taps on RGBA16F
+        static double bytesRead(unsigned int width, unsigned int height, unsigned int passes = kDefaultPasses) {
+            return double(passes) * width * height * 9.0 * 8.0;
+        }
+
+    private:
+        static constexpr unsigned int kDefaultPasses = 10;
+
+        Shader m_blur;
+        UniformHandle m_horizontal;
+        unsigned int m_width;
+        unsigned int m_height;
+        unsigned int m_framebuffers[2] = {};
+        unsigned int m_textures[2] = {};
+    };
+
+    // Progressive bloom: a bright pass from the full resolution HDR image into a half resolution mip,
+    // a chain of 13 tap downsamples, then 3x3 tent upsamples added back up the chain. The result ends
+    // up in the half resolution mip. Every texture is R11F_G11F_B10F, half the size of RGBA16F.
+    //
+    // The mip chain sums the contribution of every level, scale the result by strength() when compositing.
+    class BloomMipChain {
+    public:
+        BloomMipChain(unsigned int width, unsigned int height, unsigned int maxMips = kDefaultMips)
+        : m_prefilter("resources/shaders/blur.vs", "resources/shaders/bloom_prefilter.fs"),
+          m_downsample("resources/shaders/blur.vs", "resources/shaders/bloom_downsample.fs"),
+          m_upsample("resources/shaders/blur.vs", "resources/shaders/bloom_upsample.fs") {
+            GLState& state = GLState::instance();
+            for (const Size& size : mipSizes(width, height, maxMips)) {
+                Mip mip;
+                mip.width = size.width;
+                mip.height = size.height;
+                glGenTextures(1, &mip.texture);
+                state.bindTexture(0, GL_TEXTURE_2D, mip.texture);
+                glTexImage2D(GL_TEXTURE_2D, 0, GL_R11F_G11F_B10F, mip.width, mip.height, 0, GL_RGB, GL_FLOAT, nullptr);
+                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+                glGenFramebuffers(1, &mip.framebuffer);
+                glBindFramebuffer(GL_FRAMEBUFFER, mip.framebuffer);
+                glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, mip.texture, 0);
+                if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+                    std::cout << "ERROR::BLOOM:: mip framebuffer " << mip.width << "x" << mip.height << " not complete" << std::endl;
+                }
+                m_mips.push_back(mip);
+            }
+            glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+            for (Shader* shader : {&m_prefilter, &m_downsample, &m_upsample}) {
+                shader->use();
+                shader->setInt("image", 0);
+            }
+            m_threshold = m_prefilter.uniform(UNIFORM("threshold"));
+        }
+
+        BloomMipChain(const BloomMipChain&) = delete;
+        BloomMipChain& operator=(const BloomMipChain&) = delete;
+
+        ~BloomMipChain() {
+            for (Mip& mip : m_mips) {
+                GLState::instance().forgetTexture(mip.texture);
+                glDeleteTextures(1, &mip.texture);
+                glDeleteFramebuffers(1, &mip.framebuffer);
+            }
+        }
+
+        // runs the whole chain on hdrColor and returns the texture holding the bloom. leaves the default
+        // framebuffer bound with the viewport it found.
+        unsigned int render(unsigned int hdrColor, unsigned int quadVAO, float threshold) {
+            GLState& state = GLState::instance();
+            GLint viewport[4];
+            glGetIntegerv(GL_VIEWPORT, viewport);
+            state.bindVertexArray(quadVAO);
+            state.disable(GL_BLEND);
+
+            m_prefilter.use();
+            m_prefilter.setFloat(m_threshold, threshold);
+            drawInto(m_mips[0], hdrColor);
+
+            m_downsample.use();
+            for (size_t i = 1; i < m_mips.size(); ++i) {
+                drawInto(m_mips[i], m_mips[i - 1].texture);
+            }
+
+            m_upsample.use();
+            state.enable(GL_BLEND);
+            state.blendFunc(GL_ONE, GL_ONE);
+            for (size_t i = m_mips.size() - 1; i > 0; --i) {
+                drawInto(m_mips[i - 1], m_mips[i].texture);
+            }
+            state.blendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+            state.disable(GL_BLEND);
+
+            glBindFramebuffer(GL_FRAMEBUFFER, 0);
+            glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+            return m_mips[0].texture;
+        }
+
+        // every level adds roughly the energy of the bright pass once
+        float strength() const { return 1.0f / m_mips.size(); }
+
+        // Estimated bytes sampled per frame, counting one texel per texture() call: bilinear neighbours mostly come
+        // from the texture cache, so fetch count times texel size is the number that scales with resolution. This
+        // is a model of the passes, not a measurement; --bloom-bench times both paths on the GPU.
+        static double bytesRead(unsigned int width, unsigned int height, unsigned int maxMips = kDefaultMips) {
+            std::vector<Size> mips = mipSizes(width, height, maxMips);
+            double bytes = mips[0].pixels() * 4.0 * kHdrTexelBytes;
+            for (size_t i = 1; i < mips.size(); ++i) {
+                bytes += mips[i].pixels() * 13.0 * kMipTexelBytes;
+                // 9 taps of the smaller mip plus the blend reading the destination
+                bytes += mips[i - 1].pixels() * (9.0 * kMipTexelBytes + kMipTexelBytes);
+            }
+            return bytes;
+        }
+
+        static void printBandwidthReport(std::ostream& out) {
+            const unsigned int resolutions[][2] = {{800, 600}, {1280, 720}, {1920, 1080}, {2560, 1440}, {3840, 2160}};
+            for (const auto& resolution : resolutions) {
+                double legacy = BloomPingPong::bytesRead(resolution[0], resolution[1]);
+                double chain = bytesRead(resolution[0], resolution[1]);
+                out << "BLOOM:: " << resolution[0] << "x" << resolution[1] << " reads an estimated " << legacy / 1.0e6
+                    << " MB/frame with 10 ping-pong passes, " << chain / 1.0e6 << " MB/frame with the mip chain ("
+                    << legacy / chain << "x less)" << std::endl;
+            }
+        }
+
+    private:
+        static constexpr unsigned int kDefaultMips = 6;
+        static constexpr double kHdrTexelBytes = 8.0; // RGBA16F
+        static constexpr double kMipTexelBytes = 4.0; // R11F_G11F_B10F
+
+        struct Size {
+            unsigned int width;
+            unsigned int height;
+            double pixels() const { return double(width) * height; }
+        };
+
+        struct Mip {
+            unsigned int width = 0;
+            unsigned int height = 0;
+            unsigned int texture = 0;
+            unsigned int framebuffer = 0;
+        };
+
+        Shader m_prefilter;
+        Shader m_downsample;
+        Shader m_upsample;
+        UniformHandle m_threshold;
+        std::vector<Mip> m_mips;
+
+        // half resolution first, halving until maxMips levels or a side would drop below 2 pixels
+        static std::vector<Size> mipSizes(unsigned int width, unsigned int height, unsigned int maxMips) {
+            std::vector<Size> sizes;
+            unsigned int w = std::max(width / 2, 1u), h = std::max(height / 2, 1u);
+            sizes.push_back(Size{w, h});
+            while (sizes.size() < maxMips && w >= 4 && h >= 4) {
+                w /= 2;
+                h /= 2;
+                sizes.push_back(Size{w, h});
+            }
+            return sizes;
+        }
+
+        void drawInto(const Mip& target, unsigned int source) {
+            glBindFramebuffer(GL_FRAMEBUFFER, target.framebuffer);
+            glViewport(0, 0, target.width, target.height);
+            GLState::instance().bindTexture(0, GL_TEXTURE_2D, source);
+            glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+        }
+    };
+}
+
+#endif //PROJECT_BASE_BLOOM_H
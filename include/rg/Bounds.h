@@ -0,0 +1,62 @@
+//
+// Created by matf-rg on 16.10.26..
+//
+
+#ifndef PROJECT_BASE_BOUNDS_H
+#define PROJECT_BASE_BOUNDS_H
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+namespace rg {
+
+    // axis aligned bounding box. a default constructed box is empty and grows with expand()
+    struct AABB {
+        glm::vec3 min = glm::vec3(FLT_MAX);
+        glm::vec3 max = glm::vec3(-FLT_MAX);
+
+        bool empty() const {
+            return min.x > max.x || min.y > max.y || min.z > max.z;
+        }
+
+        void expand(const glm::vec3& point) {
+            min = glm::min(min, point);
+            max = glm::max(max, point);
+        }
+
+        void expand(const AABB& box) {
+            if (!box.empty()) {
+                expand(box.min);
+                expand(box.max);
+            }
+        }
+
+        glm::vec3 center() const { return (min + max) * 0.5f; }
+        glm::vec3 extent() const { return (max - min) * 0.5f; }
+
+        // box around this box after an affine transform (Arvo's method: the new half extent along an axis
+        // is the old extent projected onto that axis through the absolute matrix)
+        AABB transformed(const glm::mat4& transform) const {
+            if (empty()) {
+                return *this;
+            }
+            glm::vec3 c = glm::vec3(transform * glm::vec4(center(), 1.0f));
+            glm::vec3 e = extent();
+            glm::vec3 worldExtent;
+            for (int axis = 0; axis < 3; ++axis) {
+                worldExtent[axis] = std::abs(transform[0][axis]) * e.x
+                                  + std::abs(transform[1][axis]) * e.y
+                                  + std::abs(transform[2][axis]) * e.z;
+            }
+            AABB result;
+            result.min = c - worldExtent;
+            result.max = c + worldExtent;
+            return result;
+        }
+    };
+}
+
+#endif //PROJECT_BASE_BOUNDS_H
@@ -0,0 +1,155 @@
+//
+// Created by matf-rg on 16.10.26..
+//
+
+#ifndef PROJECT_BASE_CAMERARECORDING_H
+#define PROJECT_BASE_CAMERARECORDING_H
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+
+namespace rg {
+
+    enum CameraSampleFlags : uint8_t {
+        CameraBloom = 1 << 0,
+        CameraHdr = 1 << 1,
+        CameraFlashLight = 1 << 2,
+        CameraLegacyBloom = 1 << 3
+    };
+
+    // camera and render toggles at one fixed timestep, stored as is in the file
+    struct CameraSample {
+        float position[3];
+        float yaw;   // degrees, as in Camera
+        float pitch;
+        float zoom;
+        float exposure;
+        uint8_t flags; // CameraSampleFlags
+        uint8_t padding[3];
+    };
+
+    // On-disk layout of a camera path: CameraPathHeader, then CameraSample[sampleCount], one per timestep seconds
+    constexpr char kCameraPathMagic[8] = {'R', 'G', 'C', 'A', 'M', '\0', '\0', '\0'};
+    // bump whenever CameraSample changes
+    constexpr uint32_t kCameraPathVersion = 1;
+
+    struct CameraPathHeader {
+        char magic[8];
+        uint32_t version;
+        uint32_t sampleCount;
+        float timestep;
+        uint32_t reserved;
+    };
+
+    // Records one sample per fixed timestep of wall time, however fast frames come. The samples are kept in
+    // memory and written out by stop().
+    class CameraRecorder {
+    public:
+        explicit CameraRecorder(float timestep = 1.0f / 60.0f) : m_timestep(timestep) {}
+
+        void start() {
+            m_samples.clear();
+            m_accumulated = 0.0f;
+            m_recording = true;
+        }
+
+        bool recording() const { return m_recording; }
+
+        // call every frame with the frame's time. current is repeated for every timestep the frame covered
+        void update(float deltaTime, const CameraSample& current) {
+            if (!m_recording) {
+                return;
+            }
+            m_accumulated += deltaTime;
+            while (m_accumulated >= m_timestep) {
+                m_samples.push_back(current);
+                m_accumulated -= m_timestep;
+            }
+        }
+
+        // stops recording and writes the samples, through a temporary file like the mesh cache
+        bool stop(const std::string& path) {
+            m_recording = false;
+            CameraPathHeader header;
+            std::memcpy(header.magic, kCameraPathMagic, sizeof(kCameraPathMagic));
+            header.version = kCameraPathVersion;
+            header.sampleCount = static_cast<uint32_t>(m_samples.size());
+            header.timestep = m_timestep;
+            header.reserved = 0;
+
+            std::string temporaryPath = path + ".tmp";
+            std::ofstream out(temporaryPath, std::ios::binary | std::ios::trunc);
+            if (!out) {
+                return false;
+            }
+            out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+            out.write(reinterpret_cast<const char*>(m_samples.data()), m_samples.size() * sizeof(CameraSample));
+            out.close();
+            if (!out) {
+                std::remove(temporaryPath.c_str());
+                return false;
+            }
+            return std::rename(temporaryPath.c_str(), path.c_str()) == 0;
+        }
+
+        size_t size() const { return m_samples.size(); }
+
+    private:
+        float m_timestep;
+        float m_accumulated = 0.0f;
+        bool m_recording = false;
+        std::vector<CameraSample> m_samples;
+    };
+
+    // Plays a recorded path back one sample per rendered frame, so simulated time advances by exactly one
+    // timestep per frame whatever the wall clock does. Two builds replaying the same file render the same frames.
+    class CameraReplay {
+    public:
+        bool open(const std::string& path) {
+            m_samples.clear();
+            m_next = 0;
+            std::ifstream in(path, std::ios::binary);
+            CameraPathHeader header;
+            if (!in.read(reinterpret_cast<char*>(&header), sizeof(header))
+                || std::memcmp(header.magic, kCameraPathMagic, sizeof(kCameraPathMagic)) != 0
+                || header.version != kCameraPathVersion) {
+                return false;
+            }
+            // the count comes from the file, a truncated or corrupt one must not size the allocation
+            std::streampos samplesStart = in.tellg();
+            in.seekg(0, std::ios::end);
+            uint64_t remaining = static_cast<uint64_t>(in.tellg() - samplesStart);
+            in.seekg(samplesStart);
+            if (uint64_t(header.sampleCount) * sizeof(CameraSample) > remaining) {
+                return false;
+            }
+            m_timestep = header.timestep;
+            m_samples.resize(header.sampleCount);
+            if (!in.read(reinterpret_cast<char*>(m_samples.data()), m_samples.size() * sizeof(CameraSample))) {
+                m_samples.clear();
+                return false;
+            }
+            return true;
+        }
+
+        bool finished() const { return m_next >= m_samples.size(); }
+
+        // the sample for the next frame. only valid while !finished()
+        const CameraSample& next() { return m_samples[m_next++]; }
+
+        const CameraSample& at(size_t index) const { return m_samples[index]; }
+        size_t size() const { return m_samples.size(); }
+        float timestep() const { return m_timestep; }
+
+    private:
+        std::vector<CameraSample> m_samples;
+        size_t m_next = 0;
+        float m_timestep = 1.0f / 60.0f;
+    };
+}
+
+#endif //PROJECT_BASE_CAMERARECORDING_H
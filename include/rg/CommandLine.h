@@ -0,0 +1,43 @@
+//
+// Created by matf-rg on 16.10.26..
+//
+
+#ifndef PROJECT_BASE_COMMANDLINE_H
+#define PROJECT_BASE_COMMANDLINE_H
+
+#include <cerrno>
+#include <cmath>
+#include <cstdlib>
+#include <limits>
+
+namespace rg {
+
+    // numeric command line arguments. both return false, leaving value as it was, unless the whole of text is a
+    // number that fits: no sign for unsigned, finite and greater than zero for the floats (sizes, budgets)
+    inline bool parseUnsigned(const char* text, unsigned int& value) {
+        if (text[0] < '0' || text[0] > '9') {
+            return false;
+        }
+        char* end = nullptr;
+        errno = 0;
+        unsigned long parsed = std::strtoul(text, &end, 10);
+        if (*end != '\0' || errno == ERANGE || parsed > std::numeric_limits<unsigned int>::max()) {
+            return false;
+        }
+        value = static_cast<unsigned int>(parsed);
+        return true;
+    }
+
+    inline bool parsePositive(const char* text, float& value) {
+        char* end = nullptr;
+        errno = 0;
+        float parsed = std::strtof(text, &end);
+        if (end == text || *end != '\0' || errno == ERANGE || !std::isfinite(parsed) || parsed <= 0.0f) {
+            return false;
+        }
+        value = parsed;
+        return true;
+    }
+}
+
+#endif //PROJECT_BASE_COMMANDLINE_H
@@ -0,0 +1,75 @@
+//
+// Created by matf-rg on 16.10.26..
+//
+
+#ifndef PROJECT_BASE_COMPUTE_H
+#define PROJECT_BASE_COMPUTE_H
+
+#include <glad/glad.h>
+#include <rg/MultiDrawIndirect.h>
+
+// compute shaders and shader storage buffers are GL 4.3, outside the generated glad like multi draw indirect
+#ifndef GL_COMPUTE_SHADER
+#define GL_COMPUTE_SHADER 0x91B9
+#endif
+#ifndef GL_SHADER_STORAGE_BUFFER
+#define GL_SHADER_STORAGE_BUFFER 0x90D2
+#endif
+#ifndef GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT
+#define GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT 0x00000001
+#endif
+#ifndef GL_COMMAND_BARRIER_BIT
+#define GL_COMMAND_BARRIER_BIT 0x00000040
+#endif
+#ifndef GL_BUFFER_UPDATE_BARRIER_BIT
+#define GL_BUFFER_UPDATE_BARRIER_BIT 0x00000200
+#endif
+#ifndef GL_SHADER_STORAGE_BARRIER_BIT
+#define GL_SHADER_STORAGE_BARRIER_BIT 0x00002000
+#endif
+
+namespace rg {
+
+    typedef void (APIENTRYP PFNRGDISPATCHCOMPUTEPROC)(GLuint groupsX, GLuint groupsY, GLuint groupsZ);
+    typedef void (APIENTRYP PFNRGMEMORYBARRIERPROC)(GLbitfield barriers);
+
+    namespace detail {
+        struct ComputeProcs {
+            PFNRGDISPATCHCOMPUTEPROC dispatchCompute = nullptr;
+            PFNRGMEMORYBARRIERPROC memoryBarrier = nullptr;
+        };
+
+        inline ComputeProcs& computeProcs() {
+            static ComputeProcs procs;
+            return procs;
+        }
+    }
+
+    inline bool computeSupported() {
+        return detail::computeProcs().dispatchCompute && detail::computeProcs().memoryBarrier;
+    }
+
+    // looks up the compute entry points after glad is loaded, with the same loader. needs a GL 4.3 context or
+    // ARB_compute_shader with ARB_shader_storage_buffer_object.
+    inline bool loadCompute(GLADloadproc load) {
+        bool supported = (GLVersion.major > 4 || (GLVersion.major == 4 && GLVersion.minor >= 3))
+                         || (detail::hasExtension("GL_ARB_compute_shader") && detail::hasExtension("GL_ARB_shader_storage_buffer_object"));
+        detail::ComputeProcs& procs = detail::computeProcs();
+        procs = detail::ComputeProcs();
+        if (supported) {
+            procs.dispatchCompute = reinterpret_cast<PFNRGDISPATCHCOMPUTEPROC>(load("glDispatchCompute"));
+            procs.memoryBarrier = reinterpret_cast<PFNRGMEMORYBARRIERPROC>(load("glMemoryBarrier"));
+        }
+        return computeSupported();
+    }
+
+    inline void dispatchCompute(GLuint groupsX, GLuint groupsY = 1, GLuint groupsZ = 1) {
+        detail::computeProcs().dispatchCompute(groupsX, groupsY, groupsZ);
+    }
+
+    inline void memoryBarrier(GLbitfield barriers) {
+        detail::computeProcs().memoryBarrier(barriers);
+    }
+}
+
+#endif //PROJECT_BASE_COMPUTE_H
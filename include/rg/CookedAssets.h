@@ -0,0 +1,166 @@
+//
+// Created by matf-rg on 16.10.26..
+//
+
+#ifndef PROJECT_BASE_COOKEDASSETS_H
+#define PROJECT_BASE_COOKEDASSETS_H
+
+#include <rg/Hash.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+
+namespace rg {
+
+    // Assets prepared offline by project_base_cook (src/cook/cook.cpp). resources/<path> cooks to
+    // resources/cooked/<path>.mesh (models, in the mesh cache format) or resources/cooked/<path>.tex (textures).
+    // Every cooked file stores the hash of its source, loaders use it only if the source still matches.
+
+    // bump whenever the cooker's processing changes, every cooked file is rebuilt
+    constexpr uint32_t kCookVersion = 2;
+
+    // the hash a cooked file is stored under, from the hash of its source
+    inline uint64_t cookedSourceHash(uint64_t sourceHash) {
+        return hashBytes(&kCookVersion, sizeof(kCookVersion), sourceHash);
+    }
+
+    // where the cooked form of a file under resources/ lives, empty for files outside of resources/
+    inline std::string cookedPath(const std::string& sourcePath, const char* extension) {
+        const std::string root = "resources/";
+        size_t found = sourcePath.rfind(root);
+        if (found == std::string::npos || (found > 0 && sourcePath[found - 1] != '/')) {
+            return std::string();
+        }
+        size_t relative = found + root.size();
+        return sourcePath.substr(0, relative) + "cooked/" + sourcePath.substr(relative) + extension;
+    }
+
+    inline std::string cookedModelPath(const std::string& sourcePath) {
+        return cookedPath(sourcePath, ".mesh");
+    }
+
+    inline std::string cookedTexturePath(const std::string& sourcePath) {
+        return cookedPath(sourcePath, ".tex");
+    }
+
+    // On-disk layout of a cooked texture: CookedTextureHeader, then every mip level from the full size one down
+    // to 1x1, rows tightly packed with components bytes per texel, ready for glTexImage2D.
+    constexpr char kCookedTextureMagic[8] = {'R', 'G', 'T', 'E', 'X', '\0', '\0', '\0'};
+
+    struct CookedTextureHeader {
+        char magic[8];
+        uint32_t width;
+        uint32_t height;
+        uint32_t components;
+        uint32_t levels;
+        uint64_t sourceHash;
+    };
+
+    // 8 bit pixels of a whole mip chain, level 0 first
+    struct CookedImage {
+        uint32_t width = 0;
+        uint32_t height = 0;
+        uint32_t components = 0;
+        uint32_t levels = 0;
+        std::vector<unsigned char> pixels;
+
+        static uint32_t levelWidth(uint32_t width, uint32_t level) { return std::max(width >> level, 1u); }
+
+        size_t levelSize(uint32_t level) const {
+            return size_t(levelWidth(width, level)) * levelWidth(height, level) * components;
+        }
+
+        size_t levelOffset(uint32_t level) const {
+            size_t offset = 0;
+            for (uint32_t i = 0; i < level; ++i) {
+                offset += levelSize(i);
+            }
+            return offset;
+        }
+
+        // builds the full chain from level 0 with a 2x2 box filter, the last row or column of odd sizes is
+        // folded into its neighbour
+        static CookedImage build(const unsigned char* data, uint32_t width, uint32_t height, uint32_t components) {
+            CookedImage image;
+            image.width = width;
+            image.height = height;
+            image.components = components;
+            image.levels = 1;
+            while (levelWidth(width, image.levels - 1) > 1 || levelWidth(height, image.levels - 1) > 1) {
+                image.levels++;
+            }
+            image.pixels.resize(image.levelOffset(image.levels));
+            std::memcpy(image.pixels.data(), data, image.levelSize(0));
+            for (uint32_t level = 1; level < image.levels; ++level) {
+                const unsigned char* source = image.pixels.data() + image.levelOffset(level - 1);
+                unsigned char* target = image.pixels.data() + image.levelOffset(level);
+                uint32_t sourceWidth = levelWidth(width, level - 1), sourceHeight = levelWidth(height, level - 1);
+                uint32_t targetWidth = levelWidth(width, level), targetHeight = levelWidth(height, level);
+                for (uint32_t y = 0; y < targetHeight; ++y) {
+                    uint32_t y0 = std::min(y * 2, sourceHeight - 1), y1 = std::min(y * 2 + 1, sourceHeight - 1);
+                    for (uint32_t x = 0; x < targetWidth; ++x) {
+                        uint32_t x0 = std::min(x * 2, sourceWidth - 1), x1 = std::min(x * 2 + 1, sourceWidth - 1);
+                        for (uint32_t c = 0; c < components; ++c) {
+                            uint32_t sum = source[(size_t(y0) * sourceWidth + x0) * components + c]
+                                           + source[(size_t(y0) * sourceWidth + x1) * components + c]
+                                           + source[(size_t(y1) * sourceWidth + x0) * components + c]
+                                           + source[(size_t(y1) * sourceWidth + x1) * components + c];
+                            target[(size_t(y) * targetWidth + x) * components + c] = static_cast<unsigned char>((sum + 2) / 4);
+                        }
+                    }
+                }
+            }
+            return image;
+        }
+
+        // reads a cooked texture, false if it is missing, damaged or was cooked from a different source
+        bool read(const std::string& path, uint64_t expectedSourceHash) {
+            std::ifstream in(path, std::ios::binary);
+            CookedTextureHeader header;
+            if (!in.read(reinterpret_cast<char*>(&header), sizeof(header))
+                || std::memcmp(header.magic, kCookedTextureMagic, sizeof(kCookedTextureMagic)) != 0
+                || header.sourceHash != expectedSourceHash
+                || header.components == 0 || header.components > 4 || header.levels == 0 || header.levels > 32) {
+                return false;
+            }
+            width = header.width;
+            height = header.height;
+            components = header.components;
+            levels = header.levels;
+            pixels.resize(levelOffset(levels));
+            return static_cast<bool>(in.read(reinterpret_cast<char*>(pixels.data()), pixels.size()));
+        }
+
+        // writes to a temporary file first so a crash never leaves a truncated texture behind
+        bool write(const std::string& path, uint64_t sourceHash) const {
+            CookedTextureHeader header;
+            std::memcpy(header.magic, kCookedTextureMagic, sizeof(kCookedTextureMagic));
+            header.width = width;
+            header.height = height;
+            header.components = components;
+            header.levels = levels;
+            header.sourceHash = sourceHash;
+
+            std::string temporaryPath = path + ".tmp";
+            std::ofstream out(temporaryPath, std::ios::binary | std::ios::trunc);
+            if (!out) {
+                return false;
+            }
+            out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+            out.write(reinterpret_cast<const char*>(pixels.data()), pixels.size());
+            out.close();
+            if (!out) {
+                std::remove(temporaryPath.c_str());
+                return false;
+            }
+            return std::rename(temporaryPath.c_str(), path.c_str()) == 0;
+        }
+    };
+}
+
+#endif //PROJECT_BASE_COOKEDASSETS_H
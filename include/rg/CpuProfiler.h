@@ -0,0 +1,217 @@
+//
+// Created by matf-rg on 16.10.26..
+//
+
+#ifndef PROJECT_BASE_CPUPROFILER_H
+#define PROJECT_BASE_CPUPROFILER_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// CPU scope markers, written out as a Chrome trace (open in chrome://tracing or https://ui.perfetto.dev).
+// Configure with -DRG_ENABLE_PROFILER=ON to define RG_PROFILE; without it every macro expands to nothing.
+//
+//   void Model::loadModel(...) { RG_PROFILE_FUNCTION(); ... }
+//   { RG_PROFILE_SCOPE("glfwSwapBuffers"); glfwSwapBuffers(window); }
+//   RG_PROFILE_WRITE("cpu_trace.json");
+#ifdef RG_PROFILE
+#define RG_PROFILE_CONCAT_(a, b) a##b
+#define RG_PROFILE_CONCAT(a, b) RG_PROFILE_CONCAT_(a, b)
+#define RG_PROFILE_SCOPE(name) ::rg::CpuScope RG_PROFILE_CONCAT(rgProfileScope, __LINE__)(name)
+#define RG_PROFILE_FUNCTION() RG_PROFILE_SCOPE(__func__)
+#define RG_PROFILE_THREAD(name) ::rg::CpuProfiler::instance().setThreadName(name)
+#define RG_PROFILE_WRITE(path) ::rg::CpuProfiler::instance().writeTrace(path)
+#else
+#define RG_PROFILE_SCOPE(name) ((void)0)
+#define RG_PROFILE_FUNCTION() ((void)0)
+#define RG_PROFILE_THREAD(name) ((void)0)
+#define RG_PROFILE_WRITE(path) ((void)0)
+#endif
+
+namespace rg {
+
+    // one finished scope, times in nanoseconds since the profiler's epoch
+    struct CpuEvent {
+        const char* name;
+        uint64_t begin;
+        uint64_t end;
+    };
+
+    // Events of a single thread. Only the owning thread appends, so recording takes no lock: events go into
+    // fixed size chunks that never move, and each chunk publishes its count with a release store.
+    // A reader walking the chunks with acquire loads sees complete events only.
+    class CpuEventBuffer {
+    public:
+        CpuEventBuffer(unsigned int threadId) : m_threadId(threadId) {}
+        CpuEventBuffer(const CpuEventBuffer&) = delete;
+        CpuEventBuffer& operator=(const CpuEventBuffer&) = delete;
+
+        void push(const CpuEvent& event) {
+            size_t count = m_tail->count.load(std::memory_order_relaxed);
+            if (count == kChunkEvents) {
+                if (m_chunks == kMaxChunks) {
+                    m_dropped.fetch_add(1, std::memory_order_relaxed);
+                    return;
+                }
+                Chunk* chunk = new Chunk;
+                m_tail->next.store(chunk, std::memory_order_release);
+                m_tail = chunk;
+                m_chunks++;
+                count = 0;
+            }
+            m_tail->events[count] = event;
+            m_tail->count.store(count + 1, std::memory_order_release);
+        }
+
+        // safe to call from any thread while the owner keeps recording
+        template<typename F>
+        void forEach(F&& visit) const {
+            for (const Chunk* chunk = &m_head; chunk; chunk = chunk->next.load(std::memory_order_acquire)) {
+                size_t count = chunk->count.load(std::memory_order_acquire);
+                for (size_t i = 0; i < count; ++i) {
+                    visit(chunk->events[i]);
+                }
+            }
+        }
+
+        unsigned int threadId() const { return m_threadId; }
+        size_t dropped() const { return m_dropped.load(std::memory_order_relaxed); }
+
+        // set by the owning thread, read when writing the trace
+        std::atomic<const char*> name{nullptr};
+
+    private:
+        static constexpr size_t kChunkEvents = 4096;
+        // 1M events, 24 MB per thread. later events are dropped and counted
+        static constexpr size_t kMaxChunks = 256;
+
+        struct Chunk {
+            CpuEvent events[kChunkEvents];
+            std::atomic<size_t> count{0};
+            std::atomic<Chunk*> next{nullptr};
+        };
+
+        unsigned int m_threadId;
+        Chunk m_head;
+        Chunk* m_tail = &m_head;
+        size_t m_chunks = 1;
+        std::atomic<size_t> m_dropped{0};
+    };
+
+    // owns the per-thread buffers and writes them out. the registry lock is taken once per thread, on its first
+    // event, and while writing the trace; recording itself never locks.
+    class CpuProfiler {
+    public:
+        static CpuProfiler& instance() {
+            // never destroyed, pool threads may still record while static destructors run
+            static CpuProfiler* profiler = new CpuProfiler;
+            return *profiler;
+        }
+
+        static uint64_t now() {
+            static const std::chrono::steady_clock::time_point epoch = std::chrono::steady_clock::now();
+            return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    std::chrono::steady_clock::now() - epoch).count());
+        }
+
+        CpuEventBuffer& threadBuffer() {
+            static thread_local CpuEventBuffer* buffer = nullptr;
+            if (!buffer) {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                buffer = new CpuEventBuffer(static_cast<unsigned int>(m_buffers.size()) + 1);
+                m_buffers.push_back(buffer);
+            }
+            return *buffer;
+        }
+
+        // name shown for the calling thread's track, must outlive the profiler (pass a literal)
+        void setThreadName(const char* name) {
+            threadBuffer().name.store(name, std::memory_order_relaxed);
+        }
+
+        // writes every event recorded so far as Chrome trace_event JSON. may be called repeatedly,
+        // each file holds the whole session up to that point.
+        bool writeTrace(const std::string& path) {
+            std::FILE* file = std::fopen(path.c_str(), "w");
+            if (!file) {
+                std::cout << "ERROR::PROFILER:: could not write " << path << std::endl;
+                return false;
+            }
+            size_t events = 0, dropped = 0;
+            bool first = true;
+            std::fputs("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n", file);
+            std::lock_guard<std::mutex> lock(m_mutex);
+            for (const CpuEventBuffer* buffer : m_buffers) {
+                const char* name = buffer->name.load(std::memory_order_relaxed);
+                std::fprintf(file, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":\"",
+                             first ? "" : ",\n", buffer->threadId());
+                if (name) {
+                    writeEscaped(file, name);
+                } else {
+                    std::fprintf(file, "thread %u", buffer->threadId());
+                }
+                std::fputs("\"}}", file);
+                first = false;
+                buffer->forEach([&](const CpuEvent& event) {
+                    std::fputs(",\n{\"name\":\"", file);
+                    writeEscaped(file, event.name);
+                    std::fprintf(file, "\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}",
+                                 buffer->threadId(), event.begin / 1000.0, (event.end - event.begin) / 1000.0);
+                    events++;
+                });
+                dropped += buffer->dropped();
+            }
+            std::fputs("\n]}\n", file);
+            bool ok = std::ferror(file) == 0;
+            ok = std::fclose(file) == 0 && ok;
+            std::cout << "PROFILER:: " << events << " events on " << m_buffers.size() << " threads written to " << path;
+            if (dropped > 0) {
+                std::cout << ", " << dropped << " dropped after the buffers filled up";
+            }
+            std::cout << std::endl;
+            return ok;
+        }
+
+    private:
+        CpuProfiler() {
+            now();
+        }
+
+        std::mutex m_mutex;
+        std::vector<CpuEventBuffer*> m_buffers;
+
+        static void writeEscaped(std::FILE* file, const char* text) {
+            for (; *text; ++text) {
+                if (*text == '"' || *text == '\\') {
+                    std::fputc('\\', file);
+                }
+                std::fputc(*text, file);
+            }
+        }
+    };
+
+    // records the enclosing block as one complete event on the calling thread
+    class CpuScope {
+    public:
+        explicit CpuScope(const char* name) : m_name(name), m_begin(CpuProfiler::now()) {}
+        CpuScope(const CpuScope&) = delete;
+        CpuScope& operator=(const CpuScope&) = delete;
+
+        ~CpuScope() {
+            uint64_t end = CpuProfiler::now();
+            CpuProfiler::instance().threadBuffer().push(CpuEvent{m_name, m_begin, end});
+        }
+
+    private:
+        const char* m_name;
+        uint64_t m_begin;
+    };
+}
+
+#endif //PROJECT_BASE_CPUPROFILER_H
@@ -0,0 +1,246 @@
+//
+// Created by matf-rg on 16.10.26..
+//
+
+#ifndef PROJECT_BASE_DEPTHPYRAMID_H
+#define PROJECT_BASE_DEPTHPYRAMID_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <learnopengl/shader.h>
+#include <rg/Bounds.h>
+#include <rg/GLState.h>
+#include <rg/Readback.h>
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <vector>
+
+namespace rg {
+
+    // Hierarchical Z: the scene's depth reduced to a mip chain where every texel holds the farthest depth of the
+    // pixels it covers, starting at half resolution. A box whose nearest depth is farther than the texels under
+    // its screen rectangle is hidden. Built from the finished frame's depth buffer and tested against in the
+    // next one, so it keeps the view projection it was built with.
+    class DepthPyramid {
+    public:
+        DepthPyramid(unsigned int width, unsigned int height)
+        : m_downsample("resources/shaders/blur.vs", "resources/shaders/hiz_downsample.fs"), m_sourceSize(width, height) {
+            unsigned int w = std::max(width / 2, 1u), h = std::max(height / 2, 1u);
+            GLState& state = GLState::instance();
+            glGenTextures(1, &m_texture);
+            state.bindTexture(0, GL_TEXTURE_2D, m_texture);
+            for (unsigned int level = 0;; ++level) {
+                glTexImage2D(GL_TEXTURE_2D, level, GL_R32F, w, h, 0, GL_RED, GL_FLOAT, nullptr);
+                m_sizes.push_back(glm::uvec2(w, h));
+                if (w == 1 && h == 1) {
+                    break;
+                }
+                w = std::max(w / 2, 1u);
+                h = std::max(h / 2, 1u);
+            }
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, levels() - 1);
+
+            m_framebuffers.resize(levels());
+            glGenFramebuffers(levels(), m_framebuffers.data());
+            for (unsigned int level = 0; level < levels(); ++level) {
+                glBindFramebuffer(GL_FRAMEBUFFER, m_framebuffers[level]);
+                glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, m_texture, level);
+                if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+                    std::cout << "ERROR::DEPTH_PYRAMID:: level " << level << " framebuffer not complete" << std::endl;
+                }
+            }
+            glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+            m_downsample.use();
+            m_downsample.setInt("depth", 0);
+        }
+
+        DepthPyramid(const DepthPyramid&) = delete;
+        DepthPyramid& operator=(const DepthPyramid&) = delete;
+
+        ~DepthPyramid() {
+            GLState::instance().forgetTexture(m_texture);
+            glDeleteTextures(1, &m_texture);
+            glDeleteFramebuffers(levels(), m_framebuffers.data());
+        }
+
+        // reduces depthTexture (window space depth, as rendered with viewProjection) into the pyramid. leaves
+        // the default framebuffer bound with the viewport it found.
+        void build(unsigned int depthTexture, unsigned int quadVAO, const glm::mat4& viewProjection) {
+            GLState& state = GLState::instance();
+            GLint viewport[4];
+            glGetIntegerv(GL_VIEWPORT, viewport);
+            state.bindVertexArray(quadVAO);
+            state.disable(GL_BLEND);
+            m_downsample.use();
+
+            // level n reads level n - 1 of the same texture, limiting sampling to that level keeps the
+            // framebuffer attachment out of the sampled range
+            drawInto(0, depthTexture);
+            for (unsigned int level = 1; level < levels(); ++level) {
+                state.bindTexture(0, GL_TEXTURE_2D, m_texture);
+                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, level - 1);
+                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, level - 1);
+                drawInto(level, m_texture);
+            }
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 0);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, levels() - 1);
+
+            glBindFramebuffer(GL_FRAMEBUFFER, 0);
+            glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+            m_viewProjection = viewProjection;
+            m_built = true;
+        }
+
+        // false until the first build, there is nothing to test against before
+        bool built() const { return m_built; }
+        // forgets the last build, for when frames went by without one
+        void invalidate() { m_built = false; }
+        unsigned int texture() const { return m_texture; }
+        unsigned int levels() const { return static_cast<unsigned int>(m_sizes.size()); }
+        glm::uvec2 size(unsigned int level = 0) const { return m_sizes[level]; }
+        // the depth buffer size it is built from, level l holds its pixel p in texel min(p >> (l + 1), size(l) - 1)
+        glm::uvec2 sourceSize() const { return m_sourceSize; }
+        const glm::mat4& viewProjection() const { return m_viewProjection; }
+        // renders to level, for reading it back
+        GLuint framebuffer(unsigned int level) const { return m_framebuffers[level]; }
+
+    private:
+        Shader m_downsample;
+        glm::uvec2 m_sourceSize;
+        unsigned int m_texture = 0;
+        std::vector<glm::uvec2> m_sizes;
+        std::vector<GLuint> m_framebuffers;
+        glm::mat4 m_viewProjection = glm::mat4(1.0f);
+        bool m_built = false;
+
+        void drawInto(unsigned int level, unsigned int source) {
+            glBindFramebuffer(GL_FRAMEBUFFER, m_framebuffers[level]);
+            glViewport(0, 0, m_sizes[level].x, m_sizes[level].y);
+            GLState::instance().bindTexture(0, GL_TEXTURE_2D, source);
+            glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+        }
+    };
+
+    // CPU copy of one small level of a DepthPyramid, for occlusion tests where culling runs on the CPU. The level
+    // comes back through a ReadbackRing, so it is a few frames old; each copy keeps the view projection it was
+    // rendered with, which keeps the test right for the static scene while the camera moves, but something
+    // that comes into view from behind an occluder can show up those few frames late.
+    class HiZReadback {
+    public:
+        // reads the first level at most maxWidth texels wide
+        explicit HiZReadback(const DepthPyramid& pyramid, unsigned int maxWidth = 128)
+        : m_pyramid(pyramid), m_level(firstLevelWithin(pyramid, maxWidth)), m_size(pyramid.size(m_level)),
+          m_ring(m_size.x * m_size.y * sizeof(float)) {
+            m_depth.resize(m_size.x * m_size.y);
+            m_viewProjections.resize(m_ring.slots());
+        }
+
+        // call after every DepthPyramid::build: starts copying the level back and takes the newest copy that
+        // arrived
+        void update() {
+            int slot = m_ring.acquire();
+            if (slot >= 0) {
+                glBindFramebuffer(GL_READ_FRAMEBUFFER, m_pyramid.framebuffer(m_level));
+                glReadBuffer(GL_COLOR_ATTACHMENT0);
+                glBindBuffer(GL_PIXEL_PACK_BUFFER, m_ring.buffer(slot));
+                glReadPixels(0, 0, m_size.x, m_size.y, GL_RED, GL_FLOAT, nullptr);
+                glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+                glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+                m_viewProjections[slot] = m_pyramid.viewProjection();
+                m_ring.submit(slot);
+            }
+            int newest = m_ring.poll(m_depth.data());
+            if (newest >= 0) {
+                m_viewProjection = m_viewProjections[newest];
+                m_available = true;
+            }
+        }
+
+        // drops the current copy and the ones in flight, for when frames went by without update
+        void invalidate() {
+            m_ring.discard();
+            m_available = false;
+        }
+
+        bool available() const { return m_available; }
+
+        // true if the box is hidden behind the copied depth: its nearest depth, as projected with the copy's
+        // view projection, is farther than every texel under its screen rectangle. the same test as
+        // resources/shaders/cull_instances.comp, on a single level.
+        bool occluded(const AABB& box) const {
+            if (!m_available) {
+                return false;
+            }
+            float rectMin[2] = {1.0f, 1.0f}, rectMax[2] = {0.0f, 0.0f};
+            float nearest = 1.0f;
+            for (int corner = 0; corner < 8; ++corner) {
+                glm::vec4 position((corner & 1) ? box.max.x : box.min.x, (corner & 2) ? box.max.y : box.min.y,
+                                   (corner & 4) ? box.max.z : box.min.z, 1.0f);
+                glm::vec4 clip = m_viewProjection * position;
+                // boxes reaching behind the camera can't be projected, keep them
+                if (clip.w <= 0.0f) {
+                    return false;
+                }
+                for (int axis = 0; axis < 2; ++axis) {
+                    float window = clip[axis] / clip.w * 0.5f + 0.5f;
+                    rectMin[axis] = std::min(rectMin[axis], window);
+                    rectMax[axis] = std::max(rectMax[axis], window);
+                }
+                nearest = std::min(nearest, clip.z / clip.w * 0.5f + 0.5f);
+            }
+            // depth buffer pixel p is in texel min(p >> (level + 1), size - 1)
+            unsigned int texelMin[2], texelMax[2];
+            glm::uvec2 source = m_pyramid.sourceSize();
+            unsigned int sourceSize[2] = {source.x, source.y}, size[2] = {m_size.x, m_size.y};
+            for (int axis = 0; axis < 2; ++axis) {
+                texelMin[axis] = texel(rectMin[axis], sourceSize[axis], size[axis]);
+                texelMax[axis] = texel(rectMax[axis], sourceSize[axis], size[axis]);
+            }
+            for (unsigned int y = texelMin[1]; y <= texelMax[1]; ++y) {
+                const float* row = &m_depth[y * m_size.x];
+                for (unsigned int x = texelMin[0]; x <= texelMax[0]; ++x) {
+                    if (row[x] >= nearest) {
+                        return false;
+                    }
+                }
+            }
+            return true;
+        }
+
+        unsigned int level() const { return m_level; }
+
+    private:
+        const DepthPyramid& m_pyramid;
+        unsigned int m_level;
+        glm::uvec2 m_size;
+        ReadbackRing m_ring;
+        std::vector<float> m_depth;
+        std::vector<glm::mat4> m_viewProjections; // per ring slot, the view projection of the copy in it
+        glm::mat4 m_viewProjection = glm::mat4(1.0f);
+        bool m_available = false;
+
+        static unsigned int firstLevelWithin(const DepthPyramid& pyramid, unsigned int maxWidth) {
+            unsigned int level = 0;
+            while (level + 1 < pyramid.levels() && pyramid.size(level).x > maxWidth) {
+                ++level;
+            }
+            return level;
+        }
+
+        unsigned int texel(float window, unsigned int sourceSize, unsigned int size) const {
+            float pixel = std::floor(std::min(std::max(window, 0.0f), 1.0f) * sourceSize);
+            unsigned int clamped = std::min(static_cast<unsigned int>(pixel), sourceSize - 1);
+            return std::min(clamped >> (m_level + 1), size - 1);
+        }
+    };
+}
+
+#endif //PROJECT_BASE_DEPTHPYRAMID_H
@@ -0,0 +1,112 @@
+//
+// Created by matf-rg on 16.10.26..
+//
+
+#ifndef PROJECT_BASE_FRAMESTATS_H
+#define PROJECT_BASE_FRAMESTATS_H
+
+#include <ostream>
+
+namespace rg {
+
+    // counters collected over one frame. code anywhere in the renderer bumps frameStats(),
+    // main rolls them over with beginFrameStats() and prints lastFrameStats() on request.
+    struct FrameStats {
+        // glUniform* calls issued
+        unsigned int uniformUploads = 0;
+        // uniforms set by name, each costs a hash table lookup
+        unsigned int uniformNameLookups = 0;
+        // glGetUniformLocation calls, made only while a shader reflects its uniforms after linking, so nonzero in
+        // the frame a shader is built and zero in every other
+        unsigned int uniformDriverLookups = 0;
+        // state changes that went through GLState and reached GL / were dropped as redundant
+        unsigned int stateChangesIssued = 0;
+        unsigned int stateChangesSkipped = 0;
+        // draws submitted by the render queue and the triangles they cover, counting every instance
+        unsigned int drawCalls = 0;
+        unsigned long long triangles = 0;
+        // glBindVertexArray calls that reached GL and re-pointings of the per-instance attributes of a shared VAO
+        unsigned int vertexArrayBinds = 0;
+        unsigned int instanceAttributeUpdates = 0;
+        // frustum culling: whole instances first, then the meshes of the instances that passed. instances in
+        // the frustum but hidden behind the depth pyramid count as occluded instead of visible
+        unsigned int instancesTested = 0;
+        unsigned int instancesVisible = 0;
+        unsigned int instancesCulled = 0;
+        unsigned int instancesOccluded = 0;
+        unsigned int meshesTested = 0;
+        unsigned int meshesCulled = 0;
+        // (mesh, instance) pairs handed to the compute culling shader, and of those in the frustum how many it
+        // kept and how many were occluded, read back a few frames late
+        unsigned int gpuCullTests = 0;
+        unsigned int gpuCullVisible = 0;
+        unsigned int gpuCullOccluded = 0;
+        // triangles the compute culled draws cover, read back like the counts above
+        unsigned long long gpuCullTriangles = 0;
+        // (mesh, instance) pairs drawn at each level of detail, level 0 is the full mesh (rg/MeshLod.h)
+        unsigned int lodInstances[4] = {};
+        // triangles of occluder proxies the software occlusion rasterizer drew
+        unsigned int occluderTriangles = 0;
+        // bloom: which implementation ran (nullptr when bloom is off), its GPU time as of a few frames ago
+        // and the bytes it samples per frame, estimated from a model of its passes
+        const char* bloomPath = nullptr;
+        double bloomMilliseconds = 0.0;
+        double bloomBytesRead = 0.0;
+
+        // share of the instances (CPU) or (mesh, instance) pairs (GPU) inside the frustum that were occluded
+        double occludedRatio() const {
+            unsigned int inFrustum = instancesVisible + instancesOccluded + gpuCullVisible + gpuCullOccluded;
+            return inFrustum == 0 ? 0.0 : double(instancesOccluded + gpuCullOccluded) / inFrustum;
+        }
+
+        // triangles submitted, whichever path culled them
+        unsigned long long trianglesSubmitted() const {
+            return triangles + gpuCullTriangles;
+        }
+
+        void print(std::ostream& out) const {
+            out << "FRAME:: uniforms: " << uniformUploads << " uploads, " << uniformNameLookups << " by name, "
+                << uniformDriverLookups << " driver lookups" << std::endl;
+            out << "FRAME:: state changes: " << stateChangesIssued << " issued, " << stateChangesSkipped << " skipped" << std::endl;
+            out << "FRAME:: draws: " << drawCalls << ", " << trianglesSubmitted() << " triangles (" << gpuCullTriangles
+                << " of them by GPU culled draws)" << std::endl;
+            out << "FRAME:: vertex arrays: " << vertexArrayBinds << " binds, " << instanceAttributeUpdates
+                << " instance attribute updates" << std::endl;
+            out << "FRAME:: culling: " << instancesTested << " instances tested, " << instancesVisible << " visible, "
+                << instancesCulled << " culled, " << instancesOccluded << " occluded; " << meshesTested << " meshes tested, "
+                << meshesCulled << " culled; " << gpuCullTests << " tested on the GPU, " << gpuCullVisible << " visible, "
+                << gpuCullOccluded << " occluded" << std::endl;
+            out << "FRAME:: occlusion: " << occludedRatio() * 100.0 << "% of the instances in the frustum occluded, "
+                << occluderTriangles << " occluder triangles rasterized" << std::endl;
+            out << "FRAME:: lod: instances per level";
+            for (unsigned int instances : lodInstances) {
+                out << " " << instances;
+            }
+            out << std::endl;
+            if (bloomPath) {
+                out << "FRAME:: bloom: " << bloomPath << ", " << bloomMilliseconds << " ms GPU, "
+                    << bloomBytesRead / 1.0e6 << " MB read (estimated)" << std::endl;
+            } else {
+                out << "FRAME:: bloom: off" << std::endl;
+            }
+        }
+    };
+
+    inline FrameStats& frameStats() {
+        static FrameStats stats;
+        return stats;
+    }
+
+    inline FrameStats& lastFrameStats() {
+        static FrameStats stats;
+        return stats;
+    }
+
+    // call once at the start of every frame
+    inline void beginFrameStats() {
+        lastFrameStats() = frameStats();
+        frameStats() = FrameStats();
+    }
+}
+
+#endif //PROJECT_BASE_FRAMESTATS_H
@@ -0,0 +1,192 @@
+//
+// Created by matf-rg on 16.10.26..
+//
+
+#ifndef PROJECT_BASE_FRUSTUM_H
+#define PROJECT_BASE_FRUSTUM_H
+
+#include <glm/glm.hpp>
+#include <rg/Bounds.h>
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#if defined(__SSE2__) || defined(__AVX__)
+#include <immintrin.h>
+#endif
+
+namespace rg {
+
+    // the six planes of a view frustum, normals pointing inwards: a point p is inside a plane if dot(xyz, p) + w >= 0
+    struct Frustum {
+        glm::vec4 planes[6];
+
+        // extracts the planes from a projection * view matrix (Gribb/Hartmann)
+        static Frustum fromMatrix(const glm::mat4& viewProjection) {
+            glm::vec4 rows[4];
+            for (int row = 0; row < 4; ++row) {
+                rows[row] = glm::vec4(viewProjection[0][row], viewProjection[1][row], viewProjection[2][row], viewProjection[3][row]);
+            }
+            Frustum frustum;
+            frustum.planes[0] = rows[3] + rows[0]; // left
+            frustum.planes[1] = rows[3] - rows[0]; // right
+            frustum.planes[2] = rows[3] + rows[1]; // bottom
+            frustum.planes[3] = rows[3] - rows[1]; // top
+            frustum.planes[4] = rows[3] + rows[2]; // near
+            frustum.planes[5] = rows[3] - rows[2]; // far
+            for (glm::vec4& plane : frustum.planes) {
+                plane /= glm::length(glm::vec3(plane));
+            }
+            return frustum;
+        }
+
+        // false only if the box lies entirely behind one of the planes. conservative: boxes near a frustum
+        // corner can pass without touching it.
+        bool intersects(const AABB& box) const {
+            glm::vec3 center = box.center();
+            glm::vec3 extent = box.extent();
+            for (const glm::vec4& plane : planes) {
+                float distance = glm::dot(glm::vec3(plane), center) + plane.w;
+                float radius = glm::dot(glm::abs(glm::vec3(plane)), extent);
+                if (distance + radius < 0.0f) {
+                    return false;
+                }
+            }
+            return true;
+        }
+    };
+
+    // boxes as center/extent in structure of arrays form, padded to a whole number of SIMD batches
+    // so the culling loop never needs a scalar tail
+    struct BoundsSoA {
+        static constexpr size_t kBatch = 8;
+
+        std::vector<float> centerX, centerY, centerZ;
+        std::vector<float> extentX, extentY, extentZ;
+        size_t count = 0;
+
+        void assign(const std::vector<AABB>& boxes) {
+            count = boxes.size();
+            size_t padded = (count + kBatch - 1) / kBatch * kBatch;
+            for (std::vector<float>* column : {&centerX, &centerY, &centerZ, &extentX, &extentY, &extentZ}) {
+                column->assign(padded, 0.0f);
+            }
+            for (size_t i = 0; i < count; ++i) {
+                glm::vec3 center = boxes[i].center();
+                glm::vec3 extent = boxes[i].extent();
+                centerX[i] = center.x;
+                centerY[i] = center.y;
+                centerZ[i] = center.z;
+                extentX[i] = extent.x;
+                extentY[i] = extent.y;
+                extentZ[i] = extent.z;
+            }
+        }
+    };
+
+    // one box at a time, the reference the SIMD paths are checked against. the terms are added in the same order
+    // as in the SIMD lanes, so boxes touching a plane come out the same on every path
+    inline size_t cullBoxesScalar(const Frustum& frustum, const BoundsSoA& bounds, uint8_t* visible) {
+        size_t visibleCount = 0;
+        for (size_t i = 0; i < bounds.count; ++i) {
+            bool inside = true;
+            for (const glm::vec4& plane : frustum.planes) {
+                float distance = (plane.x * bounds.centerX[i] + plane.y * bounds.centerY[i]) + (plane.z * bounds.centerZ[i] + plane.w);
+                float radius = (std::abs(plane.x) * bounds.extentX[i] + std::abs(plane.y) * bounds.extentY[i]) + std::abs(plane.z) * bounds.extentZ[i];
+                if (distance + radius < 0.0f) {
+                    inside = false;
+                    break;
+                }
+            }
+            visible[i] = inside;
+            visibleCount += inside;
+        }
+        return visibleCount;
+    }
+
+    // Tests every box against the frustum, 8 boxes per iteration with AVX (configure with -DRG_ENABLE_AVX=ON),
+    // 4 with SSE, one at a time otherwise. Writes 1 to visible[i] for boxes that may be visible and returns their count.
+    inline size_t cullBoxes(const Frustum& frustum, const BoundsSoA& bounds, uint8_t* visible) {
+#if defined(__AVX__)
+        __m256 planeX[6], planeY[6], planeZ[6], planeW[6], absX[6], absY[6], absZ[6];
+        for (int p = 0; p < 6; ++p) {
+            const glm::vec4& plane = frustum.planes[p];
+            planeX[p] = _mm256_set1_ps(plane.x);
+            planeY[p] = _mm256_set1_ps(plane.y);
+            planeZ[p] = _mm256_set1_ps(plane.z);
+            planeW[p] = _mm256_set1_ps(plane.w);
+            absX[p] = _mm256_set1_ps(std::abs(plane.x));
+            absY[p] = _mm256_set1_ps(std::abs(plane.y));
+            absZ[p] = _mm256_set1_ps(std::abs(plane.z));
+        }
+        const __m256 zero = _mm256_setzero_ps();
+        size_t visibleCount = 0;
+        for (size_t i = 0; i < bounds.count; i += 8) {
+            __m256 cx = _mm256_loadu_ps(&bounds.centerX[i]);
+            __m256 cy = _mm256_loadu_ps(&bounds.centerY[i]);
+            __m256 cz = _mm256_loadu_ps(&bounds.centerZ[i]);
+            __m256 ex = _mm256_loadu_ps(&bounds.extentX[i]);
+            __m256 ey = _mm256_loadu_ps(&bounds.extentY[i]);
+            __m256 ez = _mm256_loadu_ps(&bounds.extentZ[i]);
+            __m256 outside = zero;
+            for (int p = 0; p < 6; ++p) {
+                __m256 distance = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(planeX[p], cx), _mm256_mul_ps(planeY[p], cy)),
+                                                _mm256_add_ps(_mm256_mul_ps(planeZ[p], cz), planeW[p]));
+                __m256 radius = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(absX[p], ex), _mm256_mul_ps(absY[p], ey)),
+                                              _mm256_mul_ps(absZ[p], ez));
+                outside = _mm256_or_ps(outside, _mm256_cmp_ps(_mm256_add_ps(distance, radius), zero, _CMP_LT_OQ));
+            }
+            int mask = _mm256_movemask_ps(outside);
+            for (size_t lane = 0; lane < 8 && i + lane < bounds.count; ++lane) {
+                uint8_t inside = !((mask >> lane) & 1);
+                visible[i + lane] = inside;
+                visibleCount += inside;
+            }
+        }
+        return visibleCount;
+#elif defined(__SSE2__)
+        __m128 planeX[6], planeY[6], planeZ[6], planeW[6], absX[6], absY[6], absZ[6];
+        for (int p = 0; p < 6; ++p) {
+            const glm::vec4& plane = frustum.planes[p];
+            planeX[p] = _mm_set1_ps(plane.x);
+            planeY[p] = _mm_set1_ps(plane.y);
+            planeZ[p] = _mm_set1_ps(plane.z);
+            planeW[p] = _mm_set1_ps(plane.w);
+            absX[p] = _mm_set1_ps(std::abs(plane.x));
+            absY[p] = _mm_set1_ps(std::abs(plane.y));
+            absZ[p] = _mm_set1_ps(std::abs(plane.z));
+        }
+        const __m128 zero = _mm_setzero_ps();
+        size_t visibleCount = 0;
+        for (size_t i = 0; i < bounds.count; i += 4) {
+            __m128 cx = _mm_loadu_ps(&bounds.centerX[i]);
+            __m128 cy = _mm_loadu_ps(&bounds.centerY[i]);
+            __m128 cz = _mm_loadu_ps(&bounds.centerZ[i]);
+            __m128 ex = _mm_loadu_ps(&bounds.extentX[i]);
+            __m128 ey = _mm_loadu_ps(&bounds.extentY[i]);
+            __m128 ez = _mm_loadu_ps(&bounds.extentZ[i]);
+            __m128 outside = zero;
+            for (int p = 0; p < 6; ++p) {
+                __m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(planeX[p], cx), _mm_mul_ps(planeY[p], cy)),
+                                             _mm_add_ps(_mm_mul_ps(planeZ[p], cz), planeW[p]));
+                __m128 radius = _mm_add_ps(_mm_add_ps(_mm_mul_ps(absX[p], ex), _mm_mul_ps(absY[p], ey)),
+                                           _mm_mul_ps(absZ[p], ez));
+                outside = _mm_or_ps(outside, _mm_cmplt_ps(_mm_add_ps(distance, radius), zero));
+            }
+            int mask = _mm_movemask_ps(outside);
+            for (size_t lane = 0; lane < 4 && i + lane < bounds.count; ++lane) {
+                uint8_t inside = !((mask >> lane) & 1);
+                visible[i + lane] = inside;
+                visibleCount += inside;
+            }
+        }
+        return visibleCount;
+#else
+        return cullBoxesScalar(frustum, bounds, visible);
+#endif
+    }
+}
+
+#endif //PROJECT_BASE_FRUSTUM_H
@@ -0,0 +1,248 @@
+//
+// Created by matf-rg on 16.10.26..
+//
+
+#ifndef PROJECT_BASE_GLSTATE_H
+#define PROJECT_BASE_GLSTATE_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <rg/FrameStats.h>
+
+namespace rg {
+
+    // Shadow copy of the GL state the renderer touches every frame. Every setter compares against the
+    // last value it issued and drops the call if nothing would change; issued and skipped calls are
+    // counted in frameStats().
+    //
+    // The cache only knows about calls that go through it. Code that binds programs, vertex arrays or
+    // textures directly (setup code, third party code) has to call invalidate() afterwards.
+    class GLState {
+    public:
+        static GLState& instance() {
+            static GLState state;
+            return state;
+        }
+
+        GLState(const GLState&) = delete;
+        GLState& operator=(const GLState&) = delete;
+
+        void useProgram(GLuint program) {
+            if (changed(m_program, program)) {
+                glUseProgram(program);
+            }
+        }
+
+        void bindVertexArray(GLuint vertexArray) {
+            if (changed(m_vertexArray, vertexArray)) {
+                glBindVertexArray(vertexArray);
+                frameStats().vertexArrayBinds++;
+            }
+        }
+
+        void activeTexture(GLuint unit) {
+            if (changed(m_activeUnit, unit)) {
+                glActiveTexture(GL_TEXTURE0 + unit);
+            }
+        }
+
+        // binds texture to the given unit, switching the active unit only if the binding has to change
+        void bindTexture(GLuint unit, GLenum target, GLuint texture) {
+            int targetIndex = textureTargetIndex(target);
+            if (unit >= kMaxTextureUnits || targetIndex < 0) {
+                activeTexture(unit);
+                issued();
+                glBindTexture(target, texture);
+                return;
+            }
+            GLuint& bound = m_textures[unit][targetIndex];
+            if (bound == texture) {
+                skipped();
+                return;
+            }
+            bound = texture;
+            activeTexture(unit);
+            issued();
+            glBindTexture(target, texture);
+        }
+
+        void enable(GLenum capability) { setCapability(capability, true); }
+        void disable(GLenum capability) { setCapability(capability, false); }
+
+        void setCapability(GLenum capability, bool enabled) {
+            int index = capabilityIndex(capability);
+            if (index < 0) {
+                issued();
+            } else if (!changed(m_capabilities[index], enabled ? 1u : 0u)) {
+                return;
+            }
+            if (enabled) {
+                glEnable(capability);
+            } else {
+                glDisable(capability);
+            }
+        }
+
+        void blendFunc(GLenum source, GLenum destination) {
+            if (changed(m_blendSource, source, m_blendDestination, destination)) {
+                glBlendFunc(source, destination);
+            }
+        }
+
+        void depthMask(bool write) {
+            if (changed(m_depthMask, write ? 1u : 0u)) {
+                glDepthMask(write ? GL_TRUE : GL_FALSE);
+            }
+        }
+
+        void depthFunc(GLenum function) {
+            if (changed(m_depthFunc, function)) {
+                glDepthFunc(function);
+            }
+        }
+
+        void cullFace(GLenum face) {
+            if (changed(m_cullFace, face)) {
+                glCullFace(face);
+            }
+        }
+
+        // the current value of a generic vertex attribute, what shaders read at that location while its array is
+        // disabled. it is context state, not part of a vertex array
+        void vertexAttrib(GLuint location, const glm::vec4& value) {
+            if (location < kMaxVertexAttribs) {
+                if (m_vertexAttribKnown[location] && m_vertexAttribs[location] == value) {
+                    skipped();
+                    return;
+                }
+                m_vertexAttribs[location] = value;
+                m_vertexAttribKnown[location] = true;
+            }
+            issued();
+            glVertexAttrib4fv(location, &value[0]);
+        }
+
+        // a draw reading the attribute from an enabled array may leave its current value undefined
+        void forgetVertexAttrib(GLuint location) {
+            if (location < kMaxVertexAttribs) {
+                m_vertexAttribKnown[location] = false;
+            }
+        }
+
+        // forget everything, the next call of every setter reaches GL
+        void invalidate() {
+            m_program = kUnknown;
+            m_vertexArray = kUnknown;
+            m_activeUnit = kUnknown;
+            for (auto& unit : m_textures) {
+                unit[0] = unit[1] = kUnknown;
+            }
+            for (GLuint& capability : m_capabilities) {
+                capability = kUnknown;
+            }
+            m_blendSource = m_blendDestination = kUnknown;
+            m_depthMask = kUnknown;
+            m_depthFunc = kUnknown;
+            m_cullFace = kUnknown;
+            for (bool& known : m_vertexAttribKnown) {
+                known = false;
+            }
+        }
+
+        // call before deleting an object, GL may hand its name out again and the cache must not
+        // mistake the new object for the deleted one
+        void forgetTexture(GLuint texture) {
+            for (auto& unit : m_textures) {
+                for (GLuint& bound : unit) {
+                    if (bound == texture) {
+                        bound = kUnknown;
+                    }
+                }
+            }
+        }
+
+        void forgetVertexArray(GLuint vertexArray) {
+            if (m_vertexArray == vertexArray) {
+                m_vertexArray = kUnknown;
+            }
+        }
+
+        void forgetProgram(GLuint program) {
+            if (m_program == program) {
+                m_program = kUnknown;
+            }
+        }
+
+    private:
+        static constexpr GLuint kUnknown = ~0u;
+        static constexpr GLuint kMaxTextureUnits = 32;
+        static constexpr GLuint kMaxVertexAttribs = 16; // the minimum GL_MAX_VERTEX_ATTRIBS
+
+        GLuint m_program;
+        GLuint m_vertexArray;
+        GLuint m_activeUnit;
+        // [unit][0] is GL_TEXTURE_2D, [unit][1] GL_TEXTURE_CUBE_MAP
+        GLuint m_textures[kMaxTextureUnits][2];
+        // GL_BLEND, GL_DEPTH_TEST, GL_CULL_FACE
+        GLuint m_capabilities[3];
+        GLuint m_blendSource;
+        GLuint m_blendDestination;
+        GLuint m_depthMask;
+        GLuint m_depthFunc;
+        GLuint m_cullFace;
+        glm::vec4 m_vertexAttribs[kMaxVertexAttribs];
+        bool m_vertexAttribKnown[kMaxVertexAttribs];
+
+        GLState() {
+            invalidate();
+        }
+
+        static int textureTargetIndex(GLenum target) {
+            switch (target) {
+                case GL_TEXTURE_2D: return 0;
+                case GL_TEXTURE_CUBE_MAP: return 1;
+                default: return -1;
+            }
+        }
+
+        static int capabilityIndex(GLenum capability) {
+            switch (capability) {
+                case GL_BLEND: return 0;
+                case GL_DEPTH_TEST: return 1;
+                case GL_CULL_FACE: return 2;
+                default: return -1;
+            }
+        }
+
+        static void issued() {
+            rg::frameStats().stateChangesIssued++;
+        }
+
+        static void skipped() {
+            rg::frameStats().stateChangesSkipped++;
+        }
+
+        static bool changed(GLuint& cached, GLuint value) {
+            if (cached == value) {
+                skipped();
+                return false;
+            }
+            cached = value;
+            issued();
+            return true;
+        }
+
+        static bool changed(GLuint& cachedA, GLuint valueA, GLuint& cachedB, GLuint valueB) {
+            if (cachedA == valueA && cachedB == valueB) {
+                skipped();
+                return false;
+            }
+            cachedA = valueA;
+            cachedB = valueB;
+            issued();
+            return true;
+        }
+    };
+}
+
+#endif //PROJECT_BASE_GLSTATE_H
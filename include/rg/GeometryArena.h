@@ -0,0 +1,428 @@
+//
+// Created by matf-rg on 16.10.26..
+//
+
+#ifndef PROJECT_BASE_GEOMETRYARENA_H
+#define PROJECT_BASE_GEOMETRYARENA_H
+
+#include <glad/glad.h>
+
+#include <rg/GLState.h>
+#include <rg/MultiDrawIndirect.h>
+#include <rg/VertexFormat.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <iostream>
+#include <map>
+#include <vector>
+
+namespace rg {
+
+    // First fit allocator over [0, capacity) in whatever unit the caller counts in. Free ranges are kept sorted
+    // by offset and merged with their neighbours when freed, so freeing everything leaves one range again.
+    class FreeListAllocator {
+    public:
+        static constexpr size_t kInvalid = ~size_t(0);
+
+        explicit FreeListAllocator(size_t capacity = 0) { reset(capacity); }
+
+        // forgets every allocation
+        void reset(size_t capacity) {
+            m_free.clear();
+            if (capacity > 0) {
+                m_free[0] = capacity;
+            }
+            m_capacity = capacity;
+            m_used = 0;
+        }
+
+        // start of a free range of size units at a multiple of alignment, kInvalid if none is large enough
+        size_t allocate(size_t size, size_t alignment = 1) {
+            for (auto range = m_free.begin(); range != m_free.end(); ++range) {
+                size_t rangeStart = range->first, rangeEnd = range->first + range->second;
+                size_t start = (rangeStart + alignment - 1) / alignment * alignment;
+                if (start + size > rangeEnd) {
+                    continue;
+                }
+                m_free.erase(range);
+                if (start > rangeStart) {
+                    m_free[rangeStart] = start - rangeStart;
+                }
+                if (start + size < rangeEnd) {
+                    m_free[start + size] = rangeEnd - (start + size);
+                }
+                m_used += size;
+                return start;
+            }
+            return kInvalid;
+        }
+
+        void free(size_t offset, size_t size) {
+            m_used -= size;
+            auto next = m_free.lower_bound(offset);
+            if (next != m_free.end() && offset + size == next->first) {
+                size += next->second;
+                next = m_free.erase(next);
+            }
+            if (next != m_free.begin()) {
+                auto previous = std::prev(next);
+                if (previous->first + previous->second == offset) {
+                    previous->second += size;
+                    return;
+                }
+            }
+            m_free[offset] = size;
+        }
+
+        // extends the range to capacity, the new space is free
+        void grow(size_t capacity) {
+            if (capacity > m_capacity) {
+                size_t added = capacity - m_capacity;
+                m_used += added;
+                free(m_capacity, added);
+                m_capacity = capacity;
+            }
+        }
+
+        size_t capacity() const { return m_capacity; }
+        size_t used() const { return m_used; }
+        size_t freeRanges() const { return m_free.size(); }
+
+    private:
+        std::map<size_t, size_t> m_free; // offset -> size
+        size_t m_capacity = 0;
+        size_t m_used = 0;
+    };
+
+    // a mesh's geometry in the arena, valid until released
+    using GeometryHandle = uint32_t;
+    constexpr GeometryHandle kNoGeometry = ~GeometryHandle(0);
+
+    // Vertex and index data of every mesh, in one vertex buffer, one index buffer and one VAO per vertex format.
+    // Meshes get ranges of them from free lists and draw with glDrawElements*BaseVertex, so consecutive draws of
+    // one format never rebind a VAO. Indices are stored as 16 bit whenever the mesh has at most 65536 vertices.
+    // Coarser levels of detail (addLod) are ranges of indices only, drawing their parent mesh's vertices.
+    // Buffers grow by copying into larger ones; released ranges go back to the free lists and compact() packs
+    // the live ranges to the front and shrinks the buffers. Handles stay valid through both.
+    class GeometryArena {
+    public:
+        // per instance attributes bound to a pool's VAO, see Mesh::DrawInstanced
+        struct InstanceBinding {
+            GLuint buffer = 0;
+            size_t offset = 0;
+        };
+
+        static GeometryArena& instance() {
+            static GeometryArena arena;
+            return arena;
+        }
+
+        GeometryArena(const GeometryArena&) = delete;
+        GeometryArena& operator=(const GeometryArena&) = delete;
+
+        // uploads vertices already in Format's layout and their indices
+        template<typename Format>
+        GeometryHandle add(const typename Format::Stored* vertices, size_t vertexCount, const unsigned int* indices, size_t indexCount) {
+            Pool& pool = m_pools[static_cast<int>(Format::id())];
+            if (pool.vertexArray == 0) {
+                createPool<Format>(pool);
+            }
+            Range range;
+            range.format = Format::id();
+            range.vertexCount = vertexCount;
+            range.indexCount = indexCount;
+            range.indexType = vertexCount <= 65536 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+            size_t indexSize = range.indexType == GL_UNSIGNED_SHORT ? 2 : 4;
+
+            range.firstVertex = pool.vertices.allocate(vertexCount);
+            range.indexOffset = pool.indexBytes.allocate(indexCount * indexSize, indexSize);
+            if (range.firstVertex == FreeListAllocator::kInvalid || range.indexOffset == FreeListAllocator::kInvalid) {
+                // grow whichever buffer is out of space, at least doubling it, so the range fits at its end
+                size_t vertexCapacity = pool.vertices.capacity(), indexCapacity = pool.indexBytes.capacity();
+                if (range.firstVertex == FreeListAllocator::kInvalid) {
+                    vertexCapacity = std::max(vertexCapacity * 2, vertexCapacity + vertexCount);
+                }
+                if (range.indexOffset == FreeListAllocator::kInvalid) {
+                    indexCapacity = std::max(indexCapacity * 2, indexCapacity + indexCount * indexSize + indexSize);
+                }
+                resize(pool, vertexCapacity, indexCapacity, false);
+                if (range.firstVertex == FreeListAllocator::kInvalid) {
+                    range.firstVertex = pool.vertices.allocate(vertexCount);
+                }
+                if (range.indexOffset == FreeListAllocator::kInvalid) {
+                    range.indexOffset = pool.indexBytes.allocate(indexCount * indexSize, indexSize);
+                }
+            }
+
+            glBindBuffer(GL_ARRAY_BUFFER, pool.vertexBuffer);
+            glBufferSubData(GL_ARRAY_BUFFER, range.firstVertex * pool.stride, vertexCount * pool.stride, vertices);
+            glBindBuffer(GL_ARRAY_BUFFER, 0);
+            uploadIndices(pool, range, indices);
+            return store(range);
+        }
+
+        // a coarser level of detail of parent's mesh: indices into parent's vertices (see rg/MeshLod.h), stored
+        // with parent's index type so the levels can share a multi draw. release it before its parent.
+        GeometryHandle addLod(GeometryHandle parent, const unsigned int* indices, size_t indexCount) {
+            const Range& parentRange = m_ranges[parent];
+            Pool& pool = m_pools[static_cast<int>(parentRange.format)];
+            Range range;
+            range.format = parentRange.format;
+            range.firstVertex = parentRange.firstVertex;
+            range.indexCount = indexCount;
+            range.indexType = parentRange.indexType;
+            range.parent = parent;
+            size_t indexSize = range.indexType == GL_UNSIGNED_SHORT ? 2 : 4;
+
+            range.indexOffset = pool.indexBytes.allocate(indexCount * indexSize, indexSize);
+            if (range.indexOffset == FreeListAllocator::kInvalid) {
+                size_t indexCapacity = pool.indexBytes.capacity();
+                resize(pool, pool.vertices.capacity(), std::max(indexCapacity * 2, indexCapacity + indexCount * indexSize + indexSize), false);
+                range.indexOffset = pool.indexBytes.allocate(indexCount * indexSize, indexSize);
+            }
+            uploadIndices(pool, range, indices);
+            return store(range);
+        }
+
+        // returns the handle's ranges to the free lists, the space is reused by later adds or reclaimed by compact()
+        void release(GeometryHandle handle) {
+            Range& range = m_ranges[handle];
+            if (!range.live) {
+                return;
+            }
+            Pool& pool = m_pools[static_cast<int>(range.format)];
+            if (range.vertexCount > 0) {
+                pool.vertices.free(range.firstVertex, range.vertexCount);
+            }
+            pool.indexBytes.free(range.indexOffset, range.indexCount * indexSize(range));
+            range.live = false;
+            m_freeHandles.push_back(handle);
+        }
+
+        // moves every live range to the front of its pool, in handle order, and shrinks the buffers to fit
+        void compact() {
+            for (int format = 0; format < kFormatCount; ++format) {
+                Pool& pool = m_pools[format];
+                if (pool.vertexArray == 0) {
+                    continue;
+                }
+                size_t vertices = 0, indexBytes = 0;
+                for (const Range& range : m_ranges) {
+                    if (range.live && static_cast<int>(range.format) == format) {
+                        vertices += range.vertexCount;
+                        indexBytes += range.indexCount * indexSize(range) + 2; // room for 4 byte alignment
+                    }
+                }
+                resize(pool, std::max<size_t>(vertices, 1), std::max<size_t>(indexBytes, 4), true);
+            }
+        }
+
+        // baseInstance (needs baseInstanceSupported()) skips that many instances of the bound per instance attributes
+        void draw(GeometryHandle handle, unsigned int instanceCount = 0, unsigned int baseInstance = 0) {
+            const Range& range = m_ranges[handle];
+            GLState::instance().bindVertexArray(m_pools[static_cast<int>(range.format)].vertexArray);
+            if (baseInstance > 0) {
+                drawElementsInstancedBaseVertexBaseInstance(static_cast<GLsizei>(range.indexCount), range.indexType, (void*)range.indexOffset,
+                                                            instanceCount, static_cast<GLint>(range.firstVertex), baseInstance);
+            } else if (instanceCount > 0) {
+                glDrawElementsInstancedBaseVertex(GL_TRIANGLES, static_cast<GLsizei>(range.indexCount), range.indexType,
+                                                  (void*)range.indexOffset, instanceCount, static_cast<GLint>(range.firstVertex));
+            } else {
+                glDrawElementsBaseVertex(GL_TRIANGLES, static_cast<GLsizei>(range.indexCount), range.indexType,
+                                         (void*)range.indexOffset, static_cast<GLint>(range.firstVertex));
+            }
+        }
+
+        // the handle's draw as a command for multiDraw, firstInstance indexes the bound per instance attributes
+        DrawElementsIndirectCommand indirectCommand(GeometryHandle handle, unsigned int instanceCount, unsigned int firstInstance) const {
+            const Range& range = m_ranges[handle];
+            return DrawElementsIndirectCommand{static_cast<GLuint>(range.indexCount), instanceCount,
+                                               static_cast<GLuint>(range.indexOffset / indexSize(range)),
+                                               static_cast<GLint>(range.firstVertex), firstInstance};
+        }
+
+        // draws commandCount commands from the bound GL_DRAW_INDIRECT_BUFFER, starting commandOffset bytes in,
+        // with one call. every command has to come from a handle with the same format and index type as handle.
+        void multiDraw(GeometryHandle handle, size_t commandOffset, size_t commandCount) {
+            const Range& range = m_ranges[handle];
+            GLState::instance().bindVertexArray(m_pools[static_cast<int>(range.format)].vertexArray);
+            multiDrawElementsIndirect(range.indexType, commandOffset, static_cast<GLsizei>(commandCount));
+        }
+
+        GLenum indexType(GeometryHandle handle) const {
+            return m_ranges[handle].indexType;
+        }
+
+        GLuint vertexArray(GeometryHandle handle) const {
+            return m_pools[static_cast<int>(m_ranges[handle].format)].vertexArray;
+        }
+
+        // what the VAO of the handle's format currently sources its per instance attributes from
+        InstanceBinding& instanceBinding(GeometryHandle handle) {
+            return m_pools[static_cast<int>(m_ranges[handle].format)].instances;
+        }
+
+        // vertex and index memory per format, used against allocated
+        void report(std::ostream& out) const {
+            for (int format = 0; format < kFormatCount; ++format) {
+                const Pool& pool = m_pools[format];
+                if (pool.vertexArray == 0) {
+                    continue;
+                }
+                size_t meshes = 0, shortIndexed = 0, lods = 0;
+                for (const Range& range : m_ranges) {
+                    if (range.live && static_cast<int>(range.format) == format) {
+                        if (range.parent != kNoGeometry) {
+                            lods++;
+                            continue;
+                        }
+                        meshes++;
+                        shortIndexed += range.indexType == GL_UNSIGNED_SHORT;
+                    }
+                }
+                out << "GEOMETRY:: " << vertexFormatName(static_cast<VertexFormat>(format)) << ": " << meshes << " meshes ("
+                    << shortIndexed << " with 16 bit indices) and " << lods << " coarser levels, vertices " << pool.vertices.used() * pool.stride / 1024.0
+                    << " of " << pool.vertices.capacity() * pool.stride / 1024.0 << " KiB, indices "
+                    << pool.indexBytes.used() / 1024.0 << " of " << pool.indexBytes.capacity() / 1024.0 << " KiB, "
+                    << pool.vertices.freeRanges() + pool.indexBytes.freeRanges() << " free ranges" << std::endl;
+            }
+        }
+
+    private:
+        GeometryArena() = default;
+
+        static constexpr int kFormatCount = 3;
+        static constexpr size_t kInitialVertices = 1 << 16;
+        static constexpr size_t kInitialIndexBytes = 1 << 19;
+
+        struct Range {
+            VertexFormat format = VertexFormat::Float;
+            size_t firstVertex = 0;
+            size_t vertexCount = 0;
+            size_t indexOffset = 0; // bytes
+            size_t indexCount = 0;
+            GLenum indexType = GL_UNSIGNED_INT;
+            GeometryHandle parent = kNoGeometry; // for levels of detail, whose vertices are the parent's
+            bool live = false;
+        };
+
+        struct Pool {
+            GLuint vertexArray = 0;
+            GLuint vertexBuffer = 0;
+            GLuint indexBuffer = 0;
+            size_t stride = 0;
+            void (*setupAttributes)() = nullptr;
+            FreeListAllocator vertices;   // in vertices
+            FreeListAllocator indexBytes; // in bytes, ranges aligned to their index size
+            InstanceBinding instances;
+        };
+
+        Pool m_pools[kFormatCount];
+        std::vector<Range> m_ranges;
+        std::vector<GeometryHandle> m_freeHandles;
+
+        static size_t indexSize(const Range& range) { return range.indexType == GL_UNSIGNED_SHORT ? 2 : 4; }
+
+        void uploadIndices(const Pool& pool, const Range& range, const unsigned int* indices) {
+            // the element buffer binding is VAO state, bind it through the pool's VAO
+            GLState::instance().bindVertexArray(pool.vertexArray);
+            if (range.indexType == GL_UNSIGNED_SHORT) {
+                std::vector<uint16_t> shortIndices(indices, indices + range.indexCount);
+                glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, range.indexOffset, range.indexCount * 2, shortIndices.data());
+            } else {
+                glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, range.indexOffset, range.indexCount * 4, indices);
+            }
+            GLState::instance().bindVertexArray(0);
+        }
+
+        GeometryHandle store(Range range) {
+            range.live = true;
+            if (!m_freeHandles.empty()) {
+                GeometryHandle handle = m_freeHandles.back();
+                m_freeHandles.pop_back();
+                m_ranges[handle] = range;
+                return handle;
+            }
+            m_ranges.push_back(range);
+            return static_cast<GeometryHandle>(m_ranges.size() - 1);
+        }
+
+        template<typename Format>
+        void createPool(Pool& pool) {
+            pool.stride = sizeof(typename Format::Stored);
+            pool.setupAttributes = &setupVertexAttributes<Format>;
+            glGenVertexArrays(1, &pool.vertexArray);
+            pool.vertices.reset(0);
+            pool.indexBytes.reset(0);
+            resize(pool, kInitialVertices, kInitialIndexBytes, false);
+        }
+
+        // moves the pool to new buffers of the given capacity. without compacting every range keeps its offsets
+        // (capacity may only grow), compacting packs the live ranges of the pool to the front.
+        void resize(Pool& pool, size_t vertexCapacity, size_t indexCapacity, bool compacting) {
+            GLuint vertexBuffer, indexBuffer;
+            glGenBuffers(1, &vertexBuffer);
+            glGenBuffers(1, &indexBuffer);
+            glBindBuffer(GL_COPY_WRITE_BUFFER, vertexBuffer);
+            glBufferData(GL_COPY_WRITE_BUFFER, vertexCapacity * pool.stride, nullptr, GL_STATIC_DRAW);
+            glBindBuffer(GL_COPY_WRITE_BUFFER, indexBuffer);
+            glBufferData(GL_COPY_WRITE_BUFFER, indexCapacity, nullptr, GL_STATIC_DRAW);
+
+            if (!compacting) {
+                copy(pool.vertexBuffer, vertexBuffer, 0, 0, pool.vertices.capacity() * pool.stride);
+                copy(pool.indexBuffer, indexBuffer, 0, 0, pool.indexBytes.capacity());
+                pool.vertices.grow(vertexCapacity);
+                pool.indexBytes.grow(indexCapacity);
+            } else {
+                pool.vertices.reset(vertexCapacity);
+                pool.indexBytes.reset(indexCapacity);
+                for (Range& range : m_ranges) {
+                    if (!range.live || &m_pools[static_cast<int>(range.format)] != &pool) {
+                        continue;
+                    }
+                    size_t firstVertex = range.vertexCount > 0 ? pool.vertices.allocate(range.vertexCount) : range.firstVertex;
+                    size_t indexOffset = pool.indexBytes.allocate(range.indexCount * indexSize(range), indexSize(range));
+                    copy(pool.vertexBuffer, vertexBuffer, range.firstVertex * pool.stride, firstVertex * pool.stride,
+                         range.vertexCount * pool.stride);
+                    copy(pool.indexBuffer, indexBuffer, range.indexOffset, indexOffset, range.indexCount * indexSize(range));
+                    range.firstVertex = firstVertex;
+                    range.indexOffset = indexOffset;
+                }
+                // levels of detail follow their parent's vertices
+                for (Range& range : m_ranges) {
+                    if (range.live && range.parent != kNoGeometry && &m_pools[static_cast<int>(range.format)] == &pool) {
+                        range.firstVertex = m_ranges[range.parent].firstVertex;
+                    }
+                }
+            }
+            glBindBuffer(GL_COPY_READ_BUFFER, 0);
+            glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+            if (pool.vertexBuffer != 0) {
+                glDeleteBuffers(1, &pool.vertexBuffer);
+                glDeleteBuffers(1, &pool.indexBuffer);
+            }
+            pool.vertexBuffer = vertexBuffer;
+            pool.indexBuffer = indexBuffer;
+
+            // point the VAO at the new buffers, its per instance attributes stay as they are
+            GLState::instance().bindVertexArray(pool.vertexArray);
+            glBindBuffer(GL_ARRAY_BUFFER, pool.vertexBuffer);
+            pool.setupAttributes();
+            glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, pool.indexBuffer);
+            GLState::instance().bindVertexArray(0);
+            glBindBuffer(GL_ARRAY_BUFFER, 0);
+        }
+
+        static void copy(GLuint source, GLuint target, size_t sourceOffset, size_t targetOffset, size_t size) {
+            if (source == 0 || size == 0) {
+                return;
+            }
+            glBindBuffer(GL_COPY_READ_BUFFER, source);
+            glBindBuffer(GL_COPY_WRITE_BUFFER, target);
+            glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, sourceOffset, targetOffset, size);
+        }
+    };
+}
+
+#endif //PROJECT_BASE_GEOMETRYARENA_H
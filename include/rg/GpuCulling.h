@@ -0,0 +1,365 @@
+//
+// Created by matf-rg on 16.10.26..
+//
+
+#ifndef PROJECT_BASE_GPUCULLING_H
+#define PROJECT_BASE_GPUCULLING_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <learnopengl/mesh.h>
+#include <learnopengl/model.h>
+#include <learnopengl/shader.h>
+#include <rg/Compute.h>
+#include <rg/CpuProfiler.h>
+#include <rg/DepthPyramid.h>
+#include <rg/FrameStats.h>
+#include <rg/Frustum.h>
+#include <rg/GeometryArena.h>
+#include <rg/GLState.h>
+#include <rg/MeshLod.h>
+#include <rg/MultiDrawIndirect.h>
+#include <rg/Readback.h>
+#include <rg/RenderQueue.h>
+
+#include <cfloat>
+#include <string>
+#include <vector>
+
+namespace rg {
+
+    // GPU driven culling of instanced models. Every (mesh, instance) pair becomes a cull item with its world
+    // bounds and its instance data (the mesh's vertex decode folded in, as for multi draws). Each frame a compute
+    // shader (resources/shaders/cull_instances.comp) tests the items against the frustum and last frame's depth
+    // pyramid, picks a level of detail for each survivor (rg::LodSelection, with the level of the last frame kept
+    // on the GPU for the hysteresis) and appends it to its mesh's range of one instance buffer for that level,
+    // counting it in the level's indirect command. Every level of a mesh has its own command and room for all
+    // instances. Meshes that can share a multi draw (Mesh::SharesMultiDraw) are drawn with one
+    // glMultiDrawElementsIndirect, so the CPU never sees the visible instances; only the counts (visible,
+    // occluded, triangles, instances per level) come back, through a ReadbackRing, for the frame statistics.
+    //
+    // Needs compute shaders and multi draw indirect; instances are taken once, when the first cull runs after
+    // addModel. Model::Cull and RenderQueue::addModel stay the path for everything else.
+    class GpuCuller {
+    public:
+        GpuCuller()
+        : m_cull("resources/shaders/cull_instances.comp"), m_counterReadback(sizeof(m_counts)) {
+            m_itemCount = m_cull.uniform(UNIFORM("itemCount"));
+            for (int i = 0; i < 6; ++i) {
+                m_frustumPlanes[i] = m_cull.uniform("frustumPlanes[" + std::to_string(i) + "]");
+            }
+            m_occlusion = m_cull.uniform(UNIFORM("occlusion"));
+            m_depthSize = m_cull.uniform(UNIFORM("depthSize"));
+            m_pyramidViewProjection = m_cull.uniform(UNIFORM("pyramidViewProjection"));
+            m_lod = m_cull.uniform(UNIFORM("lod"));
+            m_cameraPosition = m_cull.uniform(UNIFORM("cameraPosition"));
+            m_lodPixelScale = m_cull.uniform(UNIFORM("lodPixelScale"));
+            m_lodThreshold = m_cull.uniform(UNIFORM("lodThreshold"));
+            m_lodHysteresis = m_cull.uniform(UNIFORM("lodHysteresis"));
+            m_cull.use();
+            m_cull.setInt(m_cull.uniform(UNIFORM("depthPyramid")), 0);
+            m_counterBuffer = createBuffer(GL_SHADER_STORAGE_BUFFER, sizeof(m_counts), nullptr, GL_DYNAMIC_COPY);
+        }
+
+        GpuCuller(const GpuCuller&) = delete;
+        GpuCuller& operator=(const GpuCuller&) = delete;
+
+        ~GpuCuller() {
+            releaseBuffers();
+            glDeleteBuffers(1, &m_counterBuffer);
+        }
+
+        // culls and draws every mesh of model (with the instances it has by the next cull) with shader. meshes
+        // drawn blended are culled with Model::Cull instead and queued per instance (RenderQueue::addBlendedMeshes):
+        // the compute shader appends instances in no particular order, and those have to go back to front.
+        void addModel(Model& model, Shader& shader, RenderLayer layer, bool cullBackFaces = false) {
+            bool blended = false;
+            for (unsigned int m = 0; m < model.meshes.size(); ++m) {
+                RenderLayer meshDrawLayer = meshLayer(model.meshes[m], layer);
+                if (meshDrawLayer == RenderLayer::Blended) {
+                    blended = true;
+                    continue;
+                }
+                m_draws.push_back(Draw{&model, &model.meshes[m], &shader, meshDrawLayer, cullBackFaces});
+            }
+            if (blended) {
+                m_blendedModels.push_back(BlendedModel{&model, &shader, layer, cullBackFaces});
+            }
+            m_dirty = true;
+        }
+
+        // fills this frame's indirect commands and visible instances. pyramid may be null (or not built yet),
+        // then only the frustum test runs; without lod every mesh is drawn in full.
+        void cull(const Frustum& frustum, const DepthPyramid* pyramid, const LodSelection* lod = nullptr) {
+            RG_PROFILE_SCOPE("GpuCuller::cull");
+            for (const BlendedModel& blended : m_blendedModels) {
+                blended.model->Cull<HiZReadback>(frustum, nullptr, lod);
+            }
+            if (m_dirty) {
+                build();
+            }
+            if (m_items == 0) {
+                return;
+            }
+            // counts start from zero, the rest of each command is fixed
+            glBindBuffer(GL_COPY_READ_BUFFER, m_commandTemplate);
+            glBindBuffer(GL_COPY_WRITE_BUFFER, m_commandBuffer);
+            glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, m_commandCount * sizeof(DrawElementsIndirectCommand));
+            glBindBuffer(GL_COPY_READ_BUFFER, 0);
+            glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+            m_cull.use();
+            m_cull.setInt(m_itemCount, static_cast<int>(m_items));
+            for (int i = 0; i < 6; ++i) {
+                m_cull.setVec4(m_frustumPlanes[i], frustum.planes[i]);
+            }
+            bool occlusion = pyramid && pyramid->built();
+            m_cull.setBool(m_occlusion, occlusion);
+            if (occlusion) {
+                m_cull.setVec2(m_depthSize, glm::vec2(pyramid->sourceSize().x, pyramid->sourceSize().y));
+                m_cull.setMat4(m_pyramidViewProjection, pyramid->viewProjection());
+                GLState::instance().bindTexture(0, GL_TEXTURE_2D, pyramid->texture());
+            }
+            m_cull.setBool(m_lod, lod != nullptr);
+            if (lod) {
+                m_cull.setVec3(m_cameraPosition, lod->cameraPosition);
+                m_cull.setFloat(m_lodPixelScale, lod->pixelScale);
+                m_cull.setFloat(m_lodThreshold, lod->threshold);
+                m_cull.setFloat(m_lodHysteresis, lod->hysteresis);
+            }
+            glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, m_itemBuffer);
+            glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, m_instanceBuffer);
+            glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, m_commandBuffer);
+            glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, m_visibleBuffer);
+            const GLuint zero[kCounters] = {};
+            glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_counterBuffer);
+            glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(zero), zero);
+            glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 4, m_counterBuffer);
+            glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 5, m_lodErrorBuffer);
+            glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 6, m_previousLodBuffer);
+            dispatchCompute(static_cast<GLuint>((m_items + kGroupSize - 1) / kGroupSize));
+            // the draws read the counts as commands and the instances as vertex attributes, the next
+            // frame's reset and the counter readback copy from the buffers, and the next dispatch reads the
+            // levels this one stored in previousLods
+            memoryBarrier(GL_COMMAND_BARRIER_BIT | GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT | GL_BUFFER_UPDATE_BARRIER_BIT
+                          | GL_SHADER_STORAGE_BARRIER_BIT);
+            readCounters();
+            FrameStats& stats = frameStats();
+            stats.gpuCullTests += static_cast<unsigned int>(m_items);
+            stats.gpuCullVisible += m_counts[0];
+            stats.gpuCullOccluded += m_counts[1];
+            stats.gpuCullTriangles += m_counts[2] | (static_cast<unsigned long long>(m_counts[3]) << 32);
+            for (unsigned int level = 0; level < kMaxLodLevels; ++level) {
+                stats.lodInstances[level] += m_counts[4 + level];
+            }
+        }
+
+        // one queue item per multi draw batch, sorted with everything else by shader and textures
+        void addTo(RenderQueue& queue) {
+            for (Batch& batch : m_batches) {
+                DrawItem item;
+                item.shader = batch.shader;
+                item.draw = &GpuCuller::drawBatch;
+                item.context = &batch;
+                item.material = batch.mesh->MaterialID();
+                item.vertexArray = batch.mesh->VAO;
+                item.layer = batch.layer;
+                item.cullBackFaces = batch.cullBackFaces;
+                queue.add(item, batch.center);
+            }
+            for (const BlendedModel& blended : m_blendedModels) {
+                queue.addBlendedMeshes(*blended.model, *blended.shader, blended.layer, blended.cullBackFaces);
+            }
+        }
+
+        size_t batchCount() const { return m_batches.size(); }
+        size_t itemCount() const { return m_items; }
+
+    private:
+        static constexpr size_t kGroupSize = 64; // local_size_x of the compute shader
+        // Counters in the compute shader: visible, occluded, triangles (low and high word) and one per level of detail
+        static constexpr unsigned int kCounters = 4 + kMaxLodLevels;
+        static_assert(kMaxLodLevels == 4, "the compute shader keeps the errors of a mesh's levels in a vec4");
+
+        // std430 layout of CullItem in the compute shader
+        struct CullItem {
+            float boundsMin[3];
+            GLuint command;    // the mesh's level 0 command, the other levels follow
+            float boundsMax[3];
+            float errorScale;  // the instance's maxScale, object space errors to world space
+        };
+        static_assert(sizeof(CullItem) == 32, "must match the std430 layout of CullItem");
+        static_assert(sizeof(InstanceData) == 25 * sizeof(float), "the compute shader copies InstanceData as 25 floats");
+
+        struct Draw {
+            Model* model;
+            Mesh* mesh;
+            Shader* shader;
+            RenderLayer layer;
+            bool cullBackFaces;
+        };
+
+        // a model with meshes drawn blended, those are culled on the CPU
+        struct BlendedModel {
+            Model* model;
+            Shader* shader;
+            RenderLayer layer;
+            bool cullBackFaces;
+        };
+
+        // consecutive commands drawn by one multi draw, their meshes share shader, state and textures
+        struct Batch {
+            GpuCuller* culler;
+            Mesh* mesh;
+            Shader* shader;
+            RenderLayer layer;
+            bool cullBackFaces;
+            size_t firstCommand;
+            size_t commandCount;
+            glm::vec3 center; // for depth sorting, the average instance origin of the first model
+        };
+
+        Shader m_cull;
+        UniformHandle m_itemCount;
+        UniformHandle m_frustumPlanes[6];
+        UniformHandle m_occlusion;
+        UniformHandle m_depthSize;
+        UniformHandle m_pyramidViewProjection;
+        UniformHandle m_lod;
+        UniformHandle m_cameraPosition;
+        UniformHandle m_lodPixelScale;
+        UniformHandle m_lodThreshold;
+        UniformHandle m_lodHysteresis;
+
+        std::vector<Draw> m_draws;
+        std::vector<BlendedModel> m_blendedModels;
+        std::vector<Batch> m_batches;
+        bool m_dirty = false;
+        size_t m_items = 0;
+        size_t m_commandCount = 0;
+        GLuint m_itemBuffer = 0;
+        GLuint m_instanceBuffer = 0;
+        GLuint m_commandTemplate = 0;
+        GLuint m_commandBuffer = 0;
+        GLuint m_visibleBuffer = 0;
+        GLuint m_lodErrorBuffer = 0;
+        GLuint m_previousLodBuffer = 0;
+        GLuint m_counterBuffer = 0;
+        ReadbackRing m_counterReadback;
+        GLuint m_counts[kCounters] = {}; // the counters of the newest cull read back
+
+        static void drawBatch(void* context) {
+            Batch& batch = *static_cast<Batch*>(context);
+            batch.mesh->BindMultiDraw(*batch.shader, batch.culler->m_visibleBuffer);
+            glBindBuffer(GL_DRAW_INDIRECT_BUFFER, batch.culler->m_commandBuffer);
+            GeometryArena::instance().multiDraw(batch.mesh->Geometry(), batch.firstCommand * sizeof(DrawElementsIndirectCommand),
+                                                batch.commandCount);
+        }
+
+        // queues this cull's counters for reading and takes the newest that arrived
+        void readCounters() {
+            int slot = m_counterReadback.acquire();
+            if (slot >= 0) {
+                glBindBuffer(GL_COPY_READ_BUFFER, m_counterBuffer);
+                glBindBuffer(GL_COPY_WRITE_BUFFER, m_counterReadback.buffer(slot));
+                glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, sizeof(m_counts));
+                glBindBuffer(GL_COPY_READ_BUFFER, 0);
+                glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+                m_counterReadback.submit(slot);
+            }
+            m_counterReadback.poll(m_counts);
+        }
+
+        // groups the draws into batches and uploads items, instances and commands. each level of each mesh gets
+        // room for all of its model's instances in the visible buffer.
+        void build() {
+            RG_PROFILE_SCOPE("GpuCuller::build");
+            releaseBuffers();
+            m_dirty = false;
+
+            std::vector<std::vector<const Draw*>> groups;
+            for (const Draw& draw : m_draws) {
+                bool placed = false;
+                for (std::vector<const Draw*>& group : groups) {
+                    const Draw& first = *group.front();
+                    if (first.shader == draw.shader && first.layer == draw.layer && first.cullBackFaces == draw.cullBackFaces
+                        && first.mesh->SharesMultiDraw(*draw.mesh)) {
+                        group.push_back(&draw);
+                        placed = true;
+                        break;
+                    }
+                }
+                if (!placed) {
+                    groups.push_back(std::vector<const Draw*>{&draw});
+                }
+            }
+
+            std::vector<DrawElementsIndirectCommand> commands;
+            std::vector<glm::vec4> lodErrors; // per command, filled at each mesh's level 0 command
+            std::vector<CullItem> items;
+            std::vector<InstanceData> instances;
+            m_batches.clear();
+            unsigned int firstInstance = 0;
+            for (const std::vector<const Draw*>& group : groups) {
+                const Draw& first = *group.front();
+                size_t firstCommand = commands.size();
+                for (const Draw* draw : group) {
+                    GLuint command = static_cast<GLuint>(commands.size());
+                    const vector<InstanceData>& modelInstances = draw->model->Instances();
+                    glm::vec4 errors(FLT_MAX);
+                    for (unsigned int level = 0; level < draw->mesh->LodCount(); ++level) {
+                        commands.push_back(draw->mesh->IndirectCommand(0, firstInstance, level));
+                        lodErrors.push_back(glm::vec4(0.0f));
+                        errors[level] = draw->mesh->LodError(level);
+                        firstInstance += static_cast<unsigned int>(modelInstances.size());
+                    }
+                    lodErrors[command] = errors;
+                    for (const InstanceData& instance : modelInstances) {
+                        AABB bounds = draw->mesh->bounds.transformed(instance.Model);
+                        items.push_back(CullItem{{bounds.min.x, bounds.min.y, bounds.min.z}, command,
+                                                 {bounds.max.x, bounds.max.y, bounds.max.z}, maxScale(instance.Model)});
+                        draw->mesh->AppendMultiDrawInstances(&instance, 1, instances);
+                    }
+                }
+                m_batches.push_back(Batch{this, first.mesh, first.shader, first.layer, first.cullBackFaces,
+                                          firstCommand, commands.size() - firstCommand, first.model->instanceCenter});
+            }
+            m_items = items.size();
+            m_commandCount = commands.size();
+            if (m_items == 0) {
+                return;
+            }
+
+            m_itemBuffer = createBuffer(GL_SHADER_STORAGE_BUFFER, items.size() * sizeof(CullItem), items.data(), GL_STATIC_DRAW);
+            m_instanceBuffer = createBuffer(GL_SHADER_STORAGE_BUFFER, instances.size() * sizeof(InstanceData), instances.data(), GL_STATIC_DRAW);
+            m_commandTemplate = createBuffer(GL_COPY_READ_BUFFER, commands.size() * sizeof(DrawElementsIndirectCommand), commands.data(), GL_STATIC_DRAW);
+            m_commandBuffer = createBuffer(GL_DRAW_INDIRECT_BUFFER, commands.size() * sizeof(DrawElementsIndirectCommand), nullptr, GL_DYNAMIC_COPY);
+            m_visibleBuffer = createBuffer(GL_ARRAY_BUFFER, firstInstance * sizeof(InstanceData), nullptr, GL_DYNAMIC_COPY);
+            m_lodErrorBuffer = createBuffer(GL_SHADER_STORAGE_BUFFER, lodErrors.size() * sizeof(glm::vec4), lodErrors.data(), GL_STATIC_DRAW);
+            std::vector<GLuint> previousLods(items.size(), 0);
+            m_previousLodBuffer = createBuffer(GL_SHADER_STORAGE_BUFFER, previousLods.size() * sizeof(GLuint), previousLods.data(), GL_DYNAMIC_COPY);
+        }
+
+        static GLuint createBuffer(GLenum target, size_t size, const void* data, GLenum usage) {
+            GLuint buffer;
+            glGenBuffers(1, &buffer);
+            glBindBuffer(target, buffer);
+            glBufferData(target, size, data, usage);
+            glBindBuffer(target, 0);
+            return buffer;
+        }
+
+        void releaseBuffers() {
+            for (GLuint* buffer : {&m_itemBuffer, &m_instanceBuffer, &m_commandTemplate, &m_commandBuffer, &m_visibleBuffer,
+                                   &m_lodErrorBuffer, &m_previousLodBuffer}) {
+                if (*buffer != 0) {
+                    glDeleteBuffers(1, buffer);
+                    *buffer = 0;
+                }
+            }
+        }
+    };
+}
+
+#endif //PROJECT_BASE_GPUCULLING_H
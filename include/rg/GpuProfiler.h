@@ -0,0 +1,247 @@
+//
+// Created by matf-rg on 16.10.26..
+//
+
+#ifndef PROJECT_BASE_GPUPROFILER_H
+#define PROJECT_BASE_GPUPROFILER_H
+
+#include <glad/glad.h>
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace rg {
+
+    // Per-pass GPU timing. Every scope drops a GL_TIMESTAMP query at its start and end, so scopes may nest.
+    // A scope that runs more than once in a frame counts once, with the sum of its times.
+    // Queries of a frame are read back kFrameLatency frames later, and only if the GPU is done with them;
+    // a frame whose results aren't ready is dropped instead of waited for.
+    //
+    //   profiler.beginFrame();
+    //   { GpuScope scope(profiler, "bloom"); ... }
+    //   profiler.stats("bloom").average
+    class GpuProfiler {
+    public:
+        static constexpr unsigned int kFrameLatency = 4;
+        static constexpr unsigned int kWindow = 240; // samples the rolling statistics cover
+
+        struct Stats {
+            const char* name;
+            unsigned int samples = 0;
+            double last = 0.0;
+            double min = 0.0;
+            double average = 0.0;
+            double p99 = 0.0;
+        };
+
+        GpuProfiler() = default;
+        GpuProfiler(const GpuProfiler&) = delete;
+        GpuProfiler& operator=(const GpuProfiler&) = delete;
+
+        ~GpuProfiler() {
+            for (FrameQueries& frame : m_frames) {
+                if (!frame.queries.empty()) {
+                    glDeleteQueries(static_cast<GLsizei>(frame.queries.size()), frame.queries.data());
+                }
+            }
+        }
+
+        // call once per frame before the first scope. collects the frame kFrameLatency frames back.
+        void beginFrame() {
+            m_current = &m_frames[m_frameIndex++ % kFrameLatency];
+            collect(*m_current);
+            m_current->records.clear();
+            m_current->used = 0;
+        }
+
+        // named scopes are identified by the pointer, pass string literals
+        unsigned int beginScope(const char* name) {
+            unsigned int record = static_cast<unsigned int>(m_current->records.size());
+            m_current->records.push_back(Record{scopeIndex(name), nextQuery(), 0});
+            glQueryCounter(m_current->queries[m_current->records.back().beginQuery], GL_TIMESTAMP);
+            return record;
+        }
+
+        void endScope(unsigned int record) {
+            unsigned int query = nextQuery();
+            m_current->records[record].endQuery = query;
+            glQueryCounter(m_current->queries[query], GL_TIMESTAMP);
+        }
+
+        // statistics over the last kWindow collected frames, samples is 0 for a scope that never ran
+        Stats stats(const char* name) const {
+            for (const Scope& scope : m_scopes) {
+                if (scope.name == name || std::strcmp(scope.name, name) == 0) {
+                    return summarize(scope);
+                }
+            }
+            Stats none;
+            none.name = name;
+            return none;
+        }
+
+        // newest result of a scope without sorting the window, cheap enough to call every frame
+        double last(const char* name) const {
+            for (const Scope& scope : m_scopes) {
+                if (scope.name == name || std::strcmp(scope.name, name) == 0) {
+                    return scope.samples.empty() ? 0.0 : scope.samples[(scope.next + kWindow - 1) % kWindow];
+                }
+            }
+            return 0.0;
+        }
+
+        std::vector<Stats> allStats() const {
+            std::vector<Stats> result;
+            for (const Scope& scope : m_scopes) {
+                result.push_back(summarize(scope));
+            }
+            return result;
+        }
+
+        unsigned int droppedFrames() const { return m_droppedFrames; }
+
+        void print(std::ostream& out) const {
+            for (const Stats& stats : allStats()) {
+                out << "GPU:: " << stats.name << ": last " << stats.last << " ms, min " << stats.min << ", avg "
+                    << stats.average << ", p99 " << stats.p99 << " (" << stats.samples << " frames)" << std::endl;
+            }
+            if (m_droppedFrames > 0) {
+                out << "GPU:: " << m_droppedFrames << " frames dropped, results were not ready in time" << std::endl;
+            }
+        }
+
+        // writes the statistics as CSV, one scope per line
+        bool dump(const std::string& path) const {
+            std::ofstream out(path);
+            if (!out) {
+                return false;
+            }
+            out << "scope,samples,last_ms,min_ms,avg_ms,p99_ms\n";
+            for (const Stats& stats : allStats()) {
+                out << stats.name << ',' << stats.samples << ',' << stats.last << ',' << stats.min << ','
+                    << stats.average << ',' << stats.p99 << '\n';
+            }
+            return static_cast<bool>(out);
+        }
+
+    private:
+        struct Record {
+            unsigned int scope;
+            unsigned int beginQuery;
+            unsigned int endQuery;
+        };
+
+        struct FrameQueries {
+            std::vector<GLuint> queries;
+            unsigned int used = 0;
+            std::vector<Record> records;
+        };
+
+        struct Scope {
+            const char* name;
+            std::vector<double> samples; // ring of the last kWindow results, in milliseconds
+            unsigned int next = 0;
+        };
+
+        FrameQueries m_frames[kFrameLatency];
+        FrameQueries* m_current = &m_frames[0];
+        unsigned long long m_frameIndex = 0;
+        std::vector<Scope> m_scopes;
+        std::vector<double> m_frameTotals; // per scope while collecting a frame, negative if it didn't run
+        unsigned int m_droppedFrames = 0;
+
+        unsigned int nextQuery() {
+            if (m_current->used == m_current->queries.size()) {
+                GLuint query;
+                glGenQueries(1, &query);
+                m_current->queries.push_back(query);
+            }
+            return m_current->used++;
+        }
+
+        unsigned int scopeIndex(const char* name) {
+            for (unsigned int i = 0; i < m_scopes.size(); ++i) {
+                if (m_scopes[i].name == name) {
+                    return i;
+                }
+            }
+            Scope scope;
+            scope.name = name;
+            m_scopes.push_back(scope);
+            return static_cast<unsigned int>(m_scopes.size() - 1);
+        }
+
+        // timestamps complete in submission order, once the last query of the frame is available all are
+        void collect(const FrameQueries& frame) {
+            if (frame.used == 0) {
+                return;
+            }
+            GLint available = 0;
+            glGetQueryObjectiv(frame.queries[frame.used - 1], GL_QUERY_RESULT_AVAILABLE, &available);
+            if (!available) {
+                m_droppedFrames++;
+                return;
+            }
+            m_frameTotals.assign(m_scopes.size(), -1.0);
+            for (const Record& record : frame.records) {
+                GLuint64 begin = 0, end = 0;
+                glGetQueryObjectui64v(frame.queries[record.beginQuery], GL_QUERY_RESULT, &begin);
+                glGetQueryObjectui64v(frame.queries[record.endQuery], GL_QUERY_RESULT, &end);
+                double& total = m_frameTotals[record.scope];
+                total = std::max(total, 0.0) + (end - begin) / 1.0e6;
+            }
+            for (size_t i = 0; i < m_scopes.size(); ++i) {
+                if (m_frameTotals[i] < 0.0) {
+                    continue;
+                }
+                Scope& scope = m_scopes[i];
+                double milliseconds = m_frameTotals[i];
+                if (scope.samples.size() < kWindow) {
+                    scope.samples.push_back(milliseconds);
+                } else {
+                    scope.samples[scope.next] = milliseconds;
+                }
+                scope.next = (scope.next + 1) % kWindow;
+            }
+        }
+
+        static Stats summarize(const Scope& scope) {
+            Stats stats;
+            stats.name = scope.name;
+            stats.samples = static_cast<unsigned int>(scope.samples.size());
+            if (scope.samples.empty()) {
+                return stats;
+            }
+            stats.last = scope.samples[(scope.next + kWindow - 1) % kWindow];
+            std::vector<double> sorted = scope.samples;
+            std::sort(sorted.begin(), sorted.end());
+            stats.min = sorted.front();
+            double sum = 0.0;
+            for (double sample : sorted) {
+                sum += sample;
+            }
+            stats.average = sum / sorted.size();
+            stats.p99 = sorted[std::min(sorted.size() - 1, static_cast<size_t>(sorted.size() * 0.99))];
+            return stats;
+        }
+    };
+
+    // times the enclosing block as one named scope
+    class GpuScope {
+    public:
+        GpuScope(GpuProfiler& profiler, const char* name) : m_profiler(profiler), m_record(profiler.beginScope(name)) {}
+        GpuScope(const GpuScope&) = delete;
+        GpuScope& operator=(const GpuScope&) = delete;
+        ~GpuScope() { m_profiler.endScope(m_record); }
+
+    private:
+        GpuProfiler& m_profiler;
+        unsigned int m_record;
+    };
+}
+
+#endif //PROJECT_BASE_GPUPROFILER_H
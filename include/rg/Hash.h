@@ -0,0 +1,49 @@
+//
+// Created by matf-rg on 16.10.26..
+//
+
+#ifndef PROJECT_BASE_HASH_H
+#define PROJECT_BASE_HASH_H
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <fstream>
+
+namespace rg {
+
+    // 64-bit FNV-1a. Cheap, good enough for content addressing of assets and for hashing uniform names.
+    constexpr uint64_t kFnvOffsetBasis = 14695981039346656037ull;
+    constexpr uint64_t kFnvPrime = 1099511628211ull;
+
+    constexpr uint64_t hashString(const char* str, uint64_t hash = kFnvOffsetBasis) {
+        while (*str) {
+            hash = (hash ^ static_cast<uint8_t>(*str++)) * kFnvPrime;
+        }
+        return hash;
+    }
+
+    inline uint64_t hashBytes(const void* data, size_t size, uint64_t hash = kFnvOffsetBasis) {
+        const uint8_t* bytes = static_cast<const uint8_t*>(data);
+        for (size_t i = 0; i < size; ++i) {
+            hash = (hash ^ bytes[i]) * kFnvPrime;
+        }
+        return hash;
+    }
+
+    // hashes the whole file, returns false if it could not be read
+    inline bool hashFile(const std::string& path, uint64_t& hash) {
+        std::ifstream in(path, std::ios::binary);
+        if (!in) {
+            return false;
+        }
+        char buffer[64 * 1024];
+        while (in) {
+            in.read(buffer, sizeof(buffer));
+            hash = hashBytes(buffer, static_cast<size_t>(in.gcount()), hash);
+        }
+        return true;
+    }
+}
+
+#endif //PROJECT_BASE_HASH_H
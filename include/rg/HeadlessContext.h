@@ -0,0 +1,117 @@
+//
+// Created by matf-rg on 16.10.26..
+//
+
+#ifndef PROJECT_BASE_HEADLESSCONTEXT_H
+#define PROJECT_BASE_HEADLESSCONTEXT_H
+
+#ifdef RG_HAS_EGL
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#endif
+
+#include <cstring>
+#include <iostream>
+
+namespace rg {
+
+    // An OpenGL 3.3 core context without a window, for benchmarks and CI. Uses EGL's surfaceless platform
+    // (EGL_MESA_platform_surfaceless), which runs on llvmpipe without a display server, and falls back to
+    // the default display. There is no default framebuffer: everything has to be drawn into FBOs.
+    //
+    // Only available when CMake found EGL (RG_HAS_EGL), otherwise create() reports an error.
+    class HeadlessContext {
+    public:
+        HeadlessContext() = default;
+        HeadlessContext(const HeadlessContext&) = delete;
+        HeadlessContext& operator=(const HeadlessContext&) = delete;
+
+        ~HeadlessContext() {
+#ifdef RG_HAS_EGL
+            if (m_display != EGL_NO_DISPLAY) {
+                eglMakeCurrent(m_display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+                if (m_context != EGL_NO_CONTEXT) {
+                    eglDestroyContext(m_display, m_context);
+                }
+                eglTerminate(m_display);
+            }
+#endif
+        }
+
+        // creates the context and makes it current on the calling thread
+        bool create() {
+#ifdef RG_HAS_EGL
+            m_display = surfacelessDisplay();
+            if (m_display == EGL_NO_DISPLAY) {
+                m_display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+            }
+            if (m_display == EGL_NO_DISPLAY || !eglInitialize(m_display, nullptr, nullptr)) {
+                std::cout << "ERROR::HEADLESS:: no EGL display" << std::endl;
+                m_display = EGL_NO_DISPLAY;
+                return false;
+            }
+            if (!eglBindAPI(EGL_OPENGL_API)) {
+                std::cout << "ERROR::HEADLESS:: EGL can't create desktop OpenGL contexts" << std::endl;
+                return false;
+            }
+            // the default surface type is EGL_WINDOW_BIT, which the surfaceless platform has no configs for
+            const EGLint configAttributes[] = {EGL_SURFACE_TYPE, EGL_PBUFFER_BIT, EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT, EGL_NONE};
+            EGLConfig config;
+            EGLint configCount = 0;
+            if (!eglChooseConfig(m_display, configAttributes, &config, 1, &configCount) || configCount == 0) {
+                std::cout << "ERROR::HEADLESS:: no EGL config with OpenGL support" << std::endl;
+                return false;
+            }
+            const EGLint contextAttributes[] = {
+                    EGL_CONTEXT_MAJOR_VERSION, 3,
+                    EGL_CONTEXT_MINOR_VERSION, 3,
+                    EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+                    EGL_NONE
+            };
+            m_context = eglCreateContext(m_display, config, EGL_NO_CONTEXT, contextAttributes);
+            if (m_context == EGL_NO_CONTEXT) {
+                std::cout << "ERROR::HEADLESS:: failed to create an OpenGL 3.3 core context" << std::endl;
+                return false;
+            }
+            if (!eglMakeCurrent(m_display, EGL_NO_SURFACE, EGL_NO_SURFACE, m_context)) {
+                std::cout << "ERROR::HEADLESS:: context can't be made current without a surface" << std::endl;
+                return false;
+            }
+            return true;
+#else
+            std::cout << "ERROR::HEADLESS:: built without EGL, install the EGL development files and reconfigure" << std::endl;
+            return false;
+#endif
+        }
+
+        // loader for gladLoadGLLoader
+        static void* getProcAddress(const char* name) {
+#ifdef RG_HAS_EGL
+            return reinterpret_cast<void*>(eglGetProcAddress(name));
+#else
+            return nullptr;
+#endif
+        }
+
+    private:
+#ifdef RG_HAS_EGL
+        EGLDisplay m_display = EGL_NO_DISPLAY;
+        EGLContext m_context = EGL_NO_CONTEXT;
+
+        static EGLDisplay surfacelessDisplay() {
+            const char* extensions = eglQueryString(EGL_NO_DISPLAY, EGL_EXTENSIONS);
+            if (!extensions || !std::strstr(extensions, "EGL_MESA_platform_surfaceless")) {
+                return EGL_NO_DISPLAY;
+            }
+            auto getPlatformDisplay = reinterpret_cast<PFNEGLGETPLATFORMDISPLAYEXTPROC>(
+                    eglGetProcAddress("eglGetPlatformDisplayEXT"));
+            if (!getPlatformDisplay) {
+                return EGL_NO_DISPLAY;
+            }
+            return getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+        }
+#endif
+    };
+}
+
+#endif //PROJECT_BASE_HEADLESSCONTEXT_H
@@ -0,0 +1,366 @@
+//
+// Created by matf-rg on 16.10.26..
+//
+
+#ifndef PROJECT_BASE_MESHCACHE_H
+#define PROJECT_BASE_MESHCACHE_H
+
+#include <learnopengl/mesh.h>
+#include <rg/Hash.h>
+#include <rg/MeshLod.h>
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+
+namespace rg {
+
+    // read-only memory mapping of a whole file, unmapped on destruction
+    class MappedFile {
+    public:
+        MappedFile() = default;
+        MappedFile(const MappedFile&) = delete;
+        MappedFile& operator=(const MappedFile&) = delete;
+        ~MappedFile() { close(); }
+
+        bool open(const std::string& path) {
+            close();
+            int fd = ::open(path.c_str(), O_RDONLY);
+            if (fd < 0) {
+                return false;
+            }
+            struct stat st;
+            if (fstat(fd, &st) != 0 || st.st_size == 0) {
+                ::close(fd);
+                return false;
+            }
+            void* mapped = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+            ::close(fd);
+            if (mapped == MAP_FAILED) {
+                return false;
+            }
+            m_data = static_cast<const char*>(mapped);
+            m_size = static_cast<size_t>(st.st_size);
+            return true;
+        }
+
+        void close() {
+            if (m_data) {
+                munmap(const_cast<char*>(m_data), m_size);
+                m_data = nullptr;
+                m_size = 0;
+            }
+        }
+
+        const char* data() const { return m_data; }
+        size_t size() const { return m_size; }
+
+    private:
+        const char* m_data = nullptr;
+        size_t m_size = 0;
+    };
+
+    // On-disk layout of a <model>.meshcache file:
+    //   MeshCacheHeader
+    //   MeshCacheEntry[meshCount] (with the object space bounds of each mesh)
+    //   per mesh: texture table ("type\0path\0" pairs), then Vertex[vertexCount],
+    //   unsigned[indexCount] and the indices of its coarser levels of detail back to back,
+    //   each 16 byte aligned so they can be handed to glBufferData as they are.
+    constexpr char kMeshCacheMagic[8] = {'R', 'G', 'M', 'E', 'S', 'H', '\0', '\0'};
+    // bump whenever Vertex, the import flags or the layout below change
+    constexpr uint32_t kMeshCacheVersion = 4;
+
+    struct MeshCacheHeader {
+        char magic[8];
+        uint32_t version;
+        uint32_t meshCount;
+        uint64_t sourceHash;
+        double coldLoadMilliseconds;
+    };
+
+    struct MeshCacheEntry {
+        uint32_t vertexCount;
+        uint32_t indexCount;
+        uint32_t textureCount;
+        uint32_t textureTableSize;
+        uint64_t textureTableOffset;
+        uint64_t vertexOffset;
+        uint64_t indexOffset;
+        float boundsMin[3];
+        float boundsMax[3];
+        // coarser levels of detail (rg/MeshLod.h), their indices start at lodIndexOffset
+        uint64_t lodIndexOffset;
+        uint32_t lodCount;
+        uint32_t lodIndexCounts[kMaxLodLevels - 1];
+        float lodErrors[kMaxLodLevels - 1];
+    };
+
+    struct TextureRef {
+        std::string type;
+        std::string path;
+    };
+
+    // a coarser level of a cached mesh
+    struct CachedLod {
+        const unsigned int* indices;
+        uint32_t indexCount;
+        float error;
+    };
+
+    // view into a mapped cache file, valid as long as the MeshCacheReader is alive
+    struct CachedMesh {
+        const Vertex* vertices;
+        uint32_t vertexCount;
+        const unsigned int* indices;
+        uint32_t indexCount;
+        AABB bounds;
+        std::vector<TextureRef> textures;
+        std::vector<CachedLod> lods;
+    };
+
+    // where the next array of the file starts after one ending at offset
+    inline uint64_t alignCacheOffset(uint64_t offset) {
+        return (offset + 15) & ~uint64_t(15);
+    }
+
+    inline std::string meshCachePath(const std::string& sourcePath) {
+        return sourcePath + ".meshcache";
+    }
+
+    // Hash of everything the processed meshes depend on: the .obj itself, the material libraries it
+    // references, the cache version and the LOD settings. Returns 0 if the source can't be read.
+    inline uint64_t meshSourceHash(const std::string& sourcePath) {
+        uint64_t hash = hashBytes(&kMeshCacheVersion, sizeof(kMeshCacheVersion));
+        const LodSettings& lod = lodSettings();
+        const float lodSettingsKey[3] = {static_cast<float>(lod.levels), lod.reduction, lod.maxError};
+        hash = hashBytes(lodSettingsKey, sizeof(lodSettingsKey), hash);
+        if (!hashFile(sourcePath, hash)) {
+            return 0;
+        }
+        std::string directory = sourcePath.substr(0, sourcePath.find_last_of('/'));
+        std::ifstream in(sourcePath);
+        std::string line;
+        while (std::getline(in, line)) {
+            if (line.compare(0, 7, "mtllib ") != 0) {
+                continue;
+            }
+            std::string library = line.substr(7);
+            while (!library.empty() && (library.back() == '\r' || library.back() == ' ')) {
+                library.pop_back();
+            }
+            hashFile(directory + '/' + library, hash);
+        }
+        return hash;
+    }
+
+    class MeshCacheReader {
+    public:
+        // maps the cache and validates it against the expected source hash
+        bool open(const std::string& cachePath, uint64_t sourceHash) {
+            m_staleSource = false;
+            if (!m_file.open(cachePath)) {
+                return false;
+            }
+            if (m_file.size() < sizeof(MeshCacheHeader)) {
+                return fail();
+            }
+            std::memcpy(&m_header, m_file.data(), sizeof(MeshCacheHeader));
+            if (std::memcmp(m_header.magic, kMeshCacheMagic, sizeof(kMeshCacheMagic)) != 0
+                || m_header.version != kMeshCacheVersion) {
+                return fail();
+            }
+            if (m_header.sourceHash != sourceHash) {
+                m_staleSource = true;
+                return fail();
+            }
+            uint64_t entriesEnd = sizeof(MeshCacheHeader) + uint64_t(m_header.meshCount) * sizeof(MeshCacheEntry);
+            if (entriesEnd > m_file.size()) {
+                return fail();
+            }
+            const MeshCacheEntry* entries = reinterpret_cast<const MeshCacheEntry*>(m_file.data() + sizeof(MeshCacheHeader));
+            m_meshes.clear();
+            m_meshes.reserve(m_header.meshCount);
+            for (uint32_t i = 0; i < m_header.meshCount; ++i) {
+                const MeshCacheEntry& entry = entries[i];
+                if (!inBounds(entry.textureTableOffset, entry.textureTableSize)
+                    || !inBounds(entry.vertexOffset, uint64_t(entry.vertexCount) * sizeof(Vertex))
+                    || !inBounds(entry.indexOffset, uint64_t(entry.indexCount) * sizeof(unsigned int))
+                    || entry.lodCount > kMaxLodLevels - 1) {
+                    return fail();
+                }
+                CachedMesh mesh;
+                mesh.vertices = reinterpret_cast<const Vertex*>(m_file.data() + entry.vertexOffset);
+                mesh.vertexCount = entry.vertexCount;
+                mesh.indices = reinterpret_cast<const unsigned int*>(m_file.data() + entry.indexOffset);
+                mesh.indexCount = entry.indexCount;
+                mesh.bounds.min = glm::vec3(entry.boundsMin[0], entry.boundsMin[1], entry.boundsMin[2]);
+                mesh.bounds.max = glm::vec3(entry.boundsMax[0], entry.boundsMax[1], entry.boundsMax[2]);
+                const char* table = m_file.data() + entry.textureTableOffset;
+                const char* tableEnd = table + entry.textureTableSize;
+                for (uint32_t t = 0; t < entry.textureCount; ++t) {
+                    TextureRef ref;
+                    if (!readString(table, tableEnd, ref.type) || !readString(table, tableEnd, ref.path)) {
+                        return fail();
+                    }
+                    mesh.textures.push_back(ref);
+                }
+                uint64_t lodOffset = entry.lodIndexOffset;
+                for (uint32_t l = 0; l < entry.lodCount; ++l) {
+                    uint64_t size = uint64_t(entry.lodIndexCounts[l]) * sizeof(unsigned int);
+                    if (!inBounds(lodOffset, size)) {
+                        return fail();
+                    }
+                    mesh.lods.push_back(CachedLod{reinterpret_cast<const unsigned int*>(m_file.data() + lodOffset),
+                                                  entry.lodIndexCounts[l], entry.lodErrors[l]});
+                    lodOffset = alignCacheOffset(lodOffset + size);
+                }
+                m_meshes.push_back(std::move(mesh));
+            }
+            return true;
+        }
+
+        const std::vector<CachedMesh>& meshes() const { return m_meshes; }
+        double coldLoadMilliseconds() const { return m_header.coldLoadMilliseconds; }
+        // the last open() found a valid file made from a different source, version or LOD settings
+        bool staleSource() const { return m_staleSource; }
+
+    private:
+        MappedFile m_file;
+        MeshCacheHeader m_header;
+        std::vector<CachedMesh> m_meshes;
+        bool m_staleSource = false;
+
+        bool fail() {
+            m_file.close();
+            m_meshes.clear();
+            return false;
+        }
+
+        bool inBounds(uint64_t offset, uint64_t size) const {
+            return offset <= m_file.size() && size <= m_file.size() - offset;
+        }
+
+        static bool readString(const char*& cursor, const char* end, std::string& out) {
+            const char* terminator = static_cast<const char*>(std::memchr(cursor, '\0', end - cursor));
+            if (!terminator) {
+                return false;
+            }
+            out.assign(cursor, terminator);
+            cursor = terminator + 1;
+            return true;
+        }
+    };
+
+    class MeshCacheWriter {
+    public:
+        // the vectors are written as they are when write() runs, they have to outlive it. lods may be null
+        void addMesh(const std::vector<Vertex>& vertices, const std::vector<unsigned int>& indices, const std::vector<Texture>& textures,
+                     const AABB& bounds, const std::vector<MeshLod>* lods = nullptr) {
+            PendingMesh mesh{&vertices, &indices, {}, static_cast<uint32_t>(textures.size()), bounds, lods};
+            for (const Texture& texture : textures) {
+                mesh.textureTable.append(texture.type).push_back('\0');
+                mesh.textureTable.append(texture.path).push_back('\0');
+            }
+            m_meshes.push_back(std::move(mesh));
+        }
+
+        // writes to a temporary file first so a crash never leaves a truncated cache behind
+        bool write(const std::string& cachePath, uint64_t sourceHash, double coldLoadMilliseconds) const {
+            MeshCacheHeader header;
+            std::memcpy(header.magic, kMeshCacheMagic, sizeof(kMeshCacheMagic));
+            header.version = kMeshCacheVersion;
+            header.meshCount = static_cast<uint32_t>(m_meshes.size());
+            header.sourceHash = sourceHash;
+            header.coldLoadMilliseconds = coldLoadMilliseconds;
+
+            std::vector<MeshCacheEntry> entries(m_meshes.size());
+            uint64_t offset = sizeof(MeshCacheHeader) + entries.size() * sizeof(MeshCacheEntry);
+            for (size_t i = 0; i < m_meshes.size(); ++i) {
+                const PendingMesh& mesh = m_meshes[i];
+                MeshCacheEntry& entry = entries[i];
+                entry.vertexCount = static_cast<uint32_t>(mesh.vertices->size());
+                entry.indexCount = static_cast<uint32_t>(mesh.indices->size());
+                entry.textureCount = mesh.textureCount;
+                entry.textureTableSize = static_cast<uint32_t>(mesh.textureTable.size());
+                for (int axis = 0; axis < 3; ++axis) {
+                    entry.boundsMin[axis] = mesh.bounds.min[axis];
+                    entry.boundsMax[axis] = mesh.bounds.max[axis];
+                }
+                entry.textureTableOffset = offset;
+                offset = alignCacheOffset(offset + entry.textureTableSize);
+                entry.vertexOffset = offset;
+                offset = alignCacheOffset(offset + uint64_t(entry.vertexCount) * sizeof(Vertex));
+                entry.indexOffset = offset;
+                offset = alignCacheOffset(offset + uint64_t(entry.indexCount) * sizeof(unsigned int));
+                entry.lodIndexOffset = offset;
+                entry.lodCount = mesh.lods ? static_cast<uint32_t>(std::min<size_t>(mesh.lods->size(), kMaxLodLevels - 1)) : 0;
+                for (uint32_t l = 0; l < entry.lodCount; ++l) {
+                    entry.lodIndexCounts[l] = static_cast<uint32_t>((*mesh.lods)[l].indices.size());
+                    entry.lodErrors[l] = (*mesh.lods)[l].error;
+                    offset = alignCacheOffset(offset + uint64_t(entry.lodIndexCounts[l]) * sizeof(unsigned int));
+                }
+            }
+
+            std::string temporaryPath = cachePath + ".tmp";
+            std::ofstream out(temporaryPath, std::ios::binary | std::ios::trunc);
+            if (!out) {
+                return false;
+            }
+            out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+            out.write(reinterpret_cast<const char*>(entries.data()), entries.size() * sizeof(MeshCacheEntry));
+            for (size_t i = 0; i < m_meshes.size(); ++i) {
+                const PendingMesh& mesh = m_meshes[i];
+                const MeshCacheEntry& entry = entries[i];
+                padTo(out, entry.textureTableOffset);
+                out.write(mesh.textureTable.data(), mesh.textureTable.size());
+                padTo(out, entry.vertexOffset);
+                out.write(reinterpret_cast<const char*>(mesh.vertices->data()), entry.vertexCount * sizeof(Vertex));
+                padTo(out, entry.indexOffset);
+                out.write(reinterpret_cast<const char*>(mesh.indices->data()), entry.indexCount * sizeof(unsigned int));
+                uint64_t lodOffset = entry.lodIndexOffset;
+                for (uint32_t l = 0; l < entry.lodCount; ++l) {
+                    padTo(out, lodOffset);
+                    out.write(reinterpret_cast<const char*>((*mesh.lods)[l].indices.data()), entry.lodIndexCounts[l] * sizeof(unsigned int));
+                    lodOffset = alignCacheOffset(lodOffset + uint64_t(entry.lodIndexCounts[l]) * sizeof(unsigned int));
+                }
+            }
+            out.close();
+            if (!out) {
+                std::remove(temporaryPath.c_str());
+                return false;
+            }
+            return std::rename(temporaryPath.c_str(), cachePath.c_str()) == 0;
+        }
+
+    private:
+        struct PendingMesh {
+            const std::vector<Vertex>* vertices;
+            const std::vector<unsigned int>* indices;
+            std::string textureTable;
+            uint32_t textureCount;
+            AABB bounds;
+            const std::vector<MeshLod>* lods;
+        };
+        std::vector<PendingMesh> m_meshes;
+
+        static void padTo(std::ofstream& out, uint64_t offset) {
+            static const char zeros[16] = {};
+            uint64_t position = static_cast<uint64_t>(out.tellp());
+            if (offset > position) {
+                out.write(zeros, offset - position);
+            }
+        }
+    };
+}
+
+#endif //PROJECT_BASE_MESHCACHE_H
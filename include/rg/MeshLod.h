@@ -0,0 +1,564 @@
+//
+// Created by matf-rg on 16.10.26..
+//
+
+#ifndef PROJECT_BASE_MESHLOD_H
+#define PROJECT_BASE_MESHLOD_H
+
+#include <glm/glm.hpp>
+#include <rg/Bounds.h>
+#include <rg/FrameStats.h>
+#include <rg/MeshOptimizer.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <numeric>
+#include <tuple>
+#include <vector>
+
+namespace rg {
+
+    // levels a mesh can have, the full mesh included. FrameStats::lodInstances and the per mesh error vector
+    // of resources/shaders/cull_instances.comp have one entry per level
+    constexpr unsigned int kMaxLodLevels = 4;
+    static_assert(sizeof(FrameStats::lodInstances) / sizeof(FrameStats::lodInstances[0]) == kMaxLodLevels,
+                  "FrameStats counts instances per level");
+
+    // how buildLods simplifies, set before models load. the mesh cache hashes them with the source
+    struct LodSettings {
+        unsigned int levels = kMaxLodLevels; // at most, the full mesh included
+        float reduction = 0.5f;              // triangles of each level relative to the level before
+        float maxError = 0.02f;              // error budget of the coarsest level, relative to the bounds diagonal
+    };
+
+    inline LodSettings& lodSettings() {
+        static LodSettings settings;
+        return settings;
+    }
+
+    // a coarser version of a mesh: indices into the full mesh's vertices, and how far (object space) its surface
+    // is from the full mesh's at most, as estimated by the error quadrics
+    struct MeshLod {
+        std::vector<unsigned int> indices;
+        float error = 0.0f;
+    };
+
+    namespace detail {
+        // Garland and Heckbert's error quadric: the squared distances to a set of planes as one symmetric 4x4
+        // matrix. the planes are weighted (by area) and error() divides by the total weight, so it is a mean
+        // squared distance whatever the tessellation.
+        struct Quadric {
+            double a2 = 0.0, ab = 0.0, ac = 0.0, ad = 0.0, b2 = 0.0, bc = 0.0, bd = 0.0, c2 = 0.0, cd = 0.0, d2 = 0.0;
+            double weight = 0.0;
+
+            // the plane dot(normal, p) + d = 0, normal of unit length
+            void addPlane(const glm::vec3& normal, float d, double planeWeight) {
+                double a = normal.x, b = normal.y, c = normal.z;
+                a2 += planeWeight * a * a; ab += planeWeight * a * b; ac += planeWeight * a * c; ad += planeWeight * a * d;
+                b2 += planeWeight * b * b; bc += planeWeight * b * c; bd += planeWeight * b * d;
+                c2 += planeWeight * c * c; cd += planeWeight * c * d;
+                d2 += planeWeight * double(d) * d;
+                weight += planeWeight;
+            }
+
+            void add(const Quadric& other) {
+                a2 += other.a2; ab += other.ab; ac += other.ac; ad += other.ad;
+                b2 += other.b2; bc += other.bc; bd += other.bd;
+                c2 += other.c2; cd += other.cd;
+                d2 += other.d2;
+                weight += other.weight;
+            }
+
+            double error(const glm::vec3& p) const {
+                if (weight <= 0.0) {
+                    return 0.0;
+                }
+                double x = p.x, y = p.y, z = p.z;
+                double sum = a2 * x * x + b2 * y * y + c2 * z * z + 2.0 * (ab * x * y + ac * x * z + bc * y * z)
+                           + 2.0 * (ad * x + bd * y + cd * z) + d2;
+                return std::max(sum, 0.0) / weight;
+            }
+        };
+
+        // Edge collapse simplification that only moves a vertex onto a neighbour, so every level indexes the
+        // full mesh's vertex buffer and only needs its own indices. Topology is that of the positions: vertices
+        // that share a position but not their normal or texture coordinates (seams, hard edges) move together,
+        // each onto the vertex across the edge on its side of the seam, or failing that onto the vertex at the
+        // far end whose normal and texture coordinates are closest within tolerance; a collapse one of them has
+        // no such vertex for is not done. Border vertices only move along the border, edges of more than two triangles
+        // are locked, and collapses that fold a triangle over are skipped.
+        //
+        // Each pass ranks every edge by the quadric error of its cheaper direction and collapses in that order,
+        // skipping edges next to one collapsed in the same pass, so the checks always see the current mesh.
+        class Simplifier {
+        public:
+            template<typename VertexT>
+            Simplifier(const std::vector<VertexT>& vertices, const std::vector<unsigned int>& indices)
+            : m_indices(indices), m_vertexPosition(vertices.size()), m_vertexTarget(vertices.size()),
+              m_normals(vertices.size()), m_texCoords(vertices.size()) {
+                for (size_t v = 0; v < vertices.size(); ++v) {
+                    m_normals[v] = vertices[v].Normal;
+                    m_texCoords[v] = vertices[v].TexCoords;
+                }
+                std::vector<unsigned int> order(vertices.size());
+                std::iota(order.begin(), order.end(), 0u);
+                auto key = [&vertices](unsigned int v) {
+                    const glm::vec3& p = vertices[v].Position;
+                    return std::make_tuple(p.x, p.y, p.z);
+                };
+                std::sort(order.begin(), order.end(), [&key](unsigned int a, unsigned int b) { return key(a) < key(b); });
+                for (size_t i = 0; i < order.size(); ++i) {
+                    if (i == 0 || key(order[i]) != key(order[i - 1])) {
+                        m_positions.push_back(vertices[order[i]].Position);
+                    }
+                    m_vertexPosition[order[i]] = static_cast<unsigned int>(m_positions.size() - 1);
+                }
+                std::iota(m_vertexTarget.begin(), m_vertexTarget.end(), 0u);
+
+                // triangle planes weighted by area, and at the border planes through the border edges standing
+                // on their triangle, so open edges keep their outline
+                buildTopology();
+                m_texCoordSpan.assign(vertices.size(), 0.0f);
+                for (size_t i = 0; i < m_indices.size(); ++i) {
+                    unsigned int vertex = m_indices[i], next = m_indices[i - i % 3 + (i + 1) % 3];
+                    float span = glm::length(m_texCoords[vertex] - m_texCoords[next]);
+                    m_texCoordSpan[vertex] = std::max(m_texCoordSpan[vertex], span);
+                    m_texCoordSpan[next] = std::max(m_texCoordSpan[next], span);
+                }
+                m_quadrics.resize(m_positions.size());
+                for (size_t t = 0; t < triangleCount(); ++t) {
+                    glm::vec3 normal;
+                    float area;
+                    if (!trianglePlane(t, normal, area)) {
+                        continue;
+                    }
+                    float d = -glm::dot(normal, m_positions[position(t * 3)]);
+                    for (int corner = 0; corner < 3; ++corner) {
+                        m_quadrics[position(t * 3 + corner)].addPlane(normal, d, area);
+                    }
+                }
+                for (size_t e = 0; e < m_edges.size(); ++e) {
+                    if (edgeTriangles(e) != 1) {
+                        continue;
+                    }
+                    const Edge& edge = m_edges[e];
+                    glm::vec3 normal;
+                    float area;
+                    if (!trianglePlane(edge.triangle, normal, area)) {
+                        continue;
+                    }
+                    glm::vec3 along = m_positions[edge.b] - m_positions[edge.a];
+                    glm::vec3 across = glm::cross(along, normal);
+                    float length = glm::length(across);
+                    if (length == 0.0f) {
+                        continue;
+                    }
+                    across = across / length;
+                    float d = -glm::dot(across, m_positions[edge.a]);
+                    double weight = kBorderWeight * glm::dot(along, along);
+                    m_quadrics[edge.a].addPlane(across, d, weight);
+                    m_quadrics[edge.b].addPlane(across, d, weight);
+                }
+            }
+
+            // collapses until at most targetTriangles are left or every remaining collapse would cost more than
+            // maxError (object space distance)
+            void simplify(size_t targetTriangles, float maxError) {
+                double maxCost = double(maxError) * maxError;
+                while (triangleCount() > targetTriangles) {
+                    buildTopology();
+                    std::vector<Collapse> collapses = rankCollapses();
+                    std::vector<uint8_t> touched(m_positions.size(), 0);
+                    size_t triangles = triangleCount();
+                    size_t collapsed = 0;
+                    for (const Collapse& collapse : collapses) {
+                        if (collapse.cost > maxCost || triangles <= targetTriangles) {
+                            break;
+                        }
+                        if (touched[collapse.from] || touched[collapse.to] || !collapsible(collapse)) {
+                            continue;
+                        }
+                        for (const Wedge& wedge : m_wedges) {
+                            m_vertexTarget[wedge.vertex] = wedge.target;
+                        }
+                        m_quadrics[collapse.to].add(m_quadrics[collapse.from]);
+                        m_maxCost = std::max(m_maxCost, collapse.cost);
+                        touched[collapse.from] = touched[collapse.to] = 1;
+                        for (unsigned int neighbour : m_fromNeighbours) {
+                            touched[neighbour] = 1;
+                        }
+                        triangles -= collapse.triangles;
+                        ++collapsed;
+                    }
+                    if (collapsed == 0) {
+                        break;
+                    }
+                    applyCollapses();
+                }
+            }
+
+            const std::vector<unsigned int>& indices() const { return m_indices; }
+            size_t triangleCount() const { return m_indices.size() / 3; }
+            // largest error of a collapse so far, the distance the current mesh may be off the original
+            float error() const { return static_cast<float>(std::sqrt(m_maxCost)); }
+
+        private:
+            // border planes count this much more than the surface, or the outline erodes first
+            static constexpr double kBorderWeight = 10.0;
+            // how far a vertex's attributes may be from those of the vertex it turns into across a seam: normals
+            // within 90 degrees, texture coordinates within the longest texture space edge at the vertex, so a
+            // tiled texture may slide a little while faces that sample one texel of a palette keep their colour
+            static constexpr float kSeamNormalCosine = 0.0f;
+            static constexpr float kSeamTexCoordStretch = 1.0f;
+            static constexpr float kSeamTexCoordEpsilon = 1e-4f;
+
+            struct Edge {
+                unsigned int a, b; // positions, a < b
+                size_t triangle;
+            };
+
+            struct Collapse {
+                unsigned int from, to;
+                unsigned int triangles; // on the edge, removed by the collapse
+                double cost;
+            };
+
+            // a vertex at the collapsing position and the one it becomes
+            struct Wedge {
+                unsigned int vertex;
+                unsigned int target;
+            };
+
+            std::vector<glm::vec3> m_positions;
+            std::vector<unsigned int> m_indices;        // the current triangles, into the original vertices
+            std::vector<unsigned int> m_vertexPosition; // vertex -> position
+            std::vector<unsigned int> m_vertexTarget;   // vertex -> vertex it moves to in this pass
+            std::vector<glm::vec3> m_normals;           // per vertex, for matching vertices across seams
+            std::vector<glm::vec2> m_texCoords;
+            std::vector<float> m_texCoordSpan;          // per vertex, the longest texture space edge at it
+            std::vector<Quadric> m_quadrics;            // per position
+            double m_maxCost = 0.0;
+
+            // topology of the current triangles: their edges sorted by position pair, the triangles around each
+            // position at m_triangles[m_triangleOffsets[p] .. m_triangleOffsets[p + 1]), border and locked positions
+            std::vector<Edge> m_edges;
+            std::vector<size_t> m_edgeRunEnd;
+            std::vector<size_t> m_triangleOffsets;
+            std::vector<size_t> m_triangles;
+            std::vector<uint8_t> m_border;
+            std::vector<uint8_t> m_locked;
+
+            // what collapsible() found for the collapse it accepted
+            std::vector<Wedge> m_wedges;
+            std::vector<unsigned int> m_fromNeighbours;
+            std::vector<unsigned int> m_toNeighbours;
+
+            unsigned int position(size_t index) const { return m_vertexPosition[m_indices[index]]; }
+
+            bool trianglePlane(size_t triangle, glm::vec3& normal, float& area) const {
+                const glm::vec3& p0 = m_positions[position(triangle * 3)];
+                normal = glm::cross(m_positions[position(triangle * 3 + 1)] - p0, m_positions[position(triangle * 3 + 2)] - p0);
+                float length = glm::length(normal);
+                if (length == 0.0f) {
+                    return false;
+                }
+                normal = normal / length;
+                area = 0.5f * length;
+                return true;
+            }
+
+            // triangles sharing edge e, the edge's run of equal position pairs in m_edges
+            size_t edgeTriangles(size_t e) const {
+                size_t start = e;
+                while (start > 0 && m_edges[start - 1].a == m_edges[e].a && m_edges[start - 1].b == m_edges[e].b) {
+                    --start;
+                }
+                return m_edgeRunEnd[start] - start;
+            }
+
+            void buildTopology() {
+                size_t positionCount = m_positions.size();
+                m_edges.clear();
+                m_triangleOffsets.assign(positionCount + 1, 0);
+                for (size_t t = 0; t < triangleCount(); ++t) {
+                    for (int corner = 0; corner < 3; ++corner) {
+                        unsigned int a = position(t * 3 + corner), b = position(t * 3 + (corner + 1) % 3);
+                        m_edges.push_back(Edge{std::min(a, b), std::max(a, b), t});
+                        m_triangleOffsets[a + 1]++;
+                    }
+                }
+                std::partial_sum(m_triangleOffsets.begin(), m_triangleOffsets.end(), m_triangleOffsets.begin());
+                m_triangles.resize(m_triangleOffsets.back());
+                std::vector<size_t> fill(m_triangleOffsets.begin(), m_triangleOffsets.end() - 1);
+                for (size_t t = 0; t < triangleCount(); ++t) {
+                    for (int corner = 0; corner < 3; ++corner) {
+                        m_triangles[fill[position(t * 3 + corner)]++] = t;
+                    }
+                }
+
+                std::sort(m_edges.begin(), m_edges.end(), [](const Edge& x, const Edge& y) {
+                    return x.a != y.a ? x.a < y.a : x.b < y.b;
+                });
+                m_edgeRunEnd.assign(m_edges.size(), 0);
+                m_border.assign(positionCount, 0);
+                m_locked.assign(positionCount, 0);
+                for (size_t start = 0, end; start < m_edges.size(); start = end) {
+                    end = start + 1;
+                    while (end < m_edges.size() && m_edges[end].a == m_edges[start].a && m_edges[end].b == m_edges[start].b) {
+                        ++end;
+                    }
+                    m_edgeRunEnd[start] = end;
+                    if (end - start == 1) {
+                        m_border[m_edges[start].a] = m_border[m_edges[start].b] = 1;
+                    } else if (end - start > 2) {
+                        m_locked[m_edges[start].a] = m_locked[m_edges[start].b] = 1;
+                    }
+                }
+            }
+
+            // every edge's cheaper allowed direction, cheapest first
+            std::vector<Collapse> rankCollapses() const {
+                std::vector<Collapse> collapses;
+                for (size_t start = 0; start < m_edges.size(); start = m_edgeRunEnd[start]) {
+                    unsigned int a = m_edges[start].a, b = m_edges[start].b;
+                    unsigned int triangles = static_cast<unsigned int>(m_edgeRunEnd[start] - start);
+                    if (triangles > 2) {
+                        continue;
+                    }
+                    Collapse best{0, 0, triangles, -1.0};
+                    for (int direction = 0; direction < 2; ++direction) {
+                        unsigned int from = direction == 0 ? a : b, to = direction == 0 ? b : a;
+                        if (m_locked[from] || (m_border[from] && triangles != 1)) {
+                            continue;
+                        }
+                        Quadric merged = m_quadrics[from];
+                        merged.add(m_quadrics[to]);
+                        double cost = merged.error(m_positions[to]);
+                        if (best.cost < 0.0 || cost < best.cost) {
+                            best.from = from;
+                            best.to = to;
+                            best.cost = cost;
+                        }
+                    }
+                    if (best.cost >= 0.0) {
+                        collapses.push_back(best);
+                    }
+                }
+                std::sort(collapses.begin(), collapses.end(), [](const Collapse& x, const Collapse& y) { return x.cost < y.cost; });
+                return collapses;
+            }
+
+            // whether moving collapse.from onto collapse.to keeps seams, topology and orientation intact. fills
+            // m_wedges and the neighbour lists for the caller
+            bool collapsible(const Collapse& collapse) {
+                m_wedges.clear();
+                m_fromNeighbours.clear();
+                m_toNeighbours.clear();
+                for (size_t i = m_triangleOffsets[collapse.from]; i < m_triangleOffsets[collapse.from + 1]; ++i) {
+                    size_t t = m_triangles[i];
+                    unsigned int vertex = 0, target = ~0u;
+                    for (int corner = 0; corner < 3; ++corner) {
+                        unsigned int p = position(t * 3 + corner);
+                        if (p == collapse.from) {
+                            vertex = m_indices[t * 3 + corner];
+                        } else if (p == collapse.to) {
+                            target = m_indices[t * 3 + corner];
+                        } else if (std::find(m_fromNeighbours.begin(), m_fromNeighbours.end(), p) == m_fromNeighbours.end()) {
+                            m_fromNeighbours.push_back(p);
+                        }
+                    }
+                    auto wedge = std::find_if(m_wedges.begin(), m_wedges.end(), [vertex](const Wedge& w) { return w.vertex == vertex; });
+                    if (wedge == m_wedges.end()) {
+                        m_wedges.push_back(Wedge{vertex, target});
+                    } else if (wedge->target == ~0u) {
+                        wedge->target = target;
+                    }
+                }
+                // every vertex at from needs a vertex at to on its side of any seam. one that has no vertex across
+                // the edge may take the vertex at to whose attributes nearly match its own
+                for (Wedge& wedge : m_wedges) {
+                    if (wedge.target == ~0u) {
+                        wedge.target = closestVertex(wedge.vertex, collapse.to);
+                    }
+                    if (wedge.target == ~0u) {
+                        return false;
+                    }
+                }
+
+                // the only neighbours from and to may share are the far corners of the edge's triangles, more
+                // would pinch the surface into an edge of more than two triangles
+                for (size_t i = m_triangleOffsets[collapse.to]; i < m_triangleOffsets[collapse.to + 1]; ++i) {
+                    size_t t = m_triangles[i];
+                    for (int corner = 0; corner < 3; ++corner) {
+                        unsigned int p = position(t * 3 + corner);
+                        if (p != collapse.to && p != collapse.from
+                            && std::find(m_toNeighbours.begin(), m_toNeighbours.end(), p) == m_toNeighbours.end()) {
+                            m_toNeighbours.push_back(p);
+                        }
+                    }
+                }
+                unsigned int shared = 0;
+                for (unsigned int p : m_fromNeighbours) {
+                    shared += std::find(m_toNeighbours.begin(), m_toNeighbours.end(), p) != m_toNeighbours.end();
+                }
+                if (shared > collapse.triangles) {
+                    return false;
+                }
+
+                // the triangles that stay must not turn over or collapse to a line
+                const glm::vec3& target = m_positions[collapse.to];
+                for (size_t i = m_triangleOffsets[collapse.from]; i < m_triangleOffsets[collapse.from + 1]; ++i) {
+                    size_t t = m_triangles[i];
+                    glm::vec3 before[3], after[3];
+                    bool onEdge = false;
+                    for (int corner = 0; corner < 3; ++corner) {
+                        unsigned int p = position(t * 3 + corner);
+                        onEdge |= p == collapse.to;
+                        before[corner] = m_positions[p];
+                        after[corner] = p == collapse.from ? target : before[corner];
+                    }
+                    if (onEdge) {
+                        continue;
+                    }
+                    glm::vec3 normalBefore = glm::cross(before[1] - before[0], before[2] - before[0]);
+                    glm::vec3 normalAfter = glm::cross(after[1] - after[0], after[2] - after[0]);
+                    float lengths = glm::length(normalBefore) * glm::length(normalAfter);
+                    if (glm::length(normalBefore) > 0.0f && glm::dot(normalBefore, normalAfter) <= 0.25f * lengths) {
+                        return false;
+                    }
+                }
+                return true;
+            }
+
+            // the vertex at position to whose normal and texture coordinates are within tolerance of vertex's and
+            // closest to them, ~0u if there is none
+            unsigned int closestVertex(unsigned int vertex, unsigned int to) const {
+                unsigned int closest = ~0u;
+                float closestDistance = 0.0f;
+                for (size_t i = m_triangleOffsets[to]; i < m_triangleOffsets[to + 1]; ++i) {
+                    for (int corner = 0; corner < 3; ++corner) {
+                        unsigned int candidate = m_indices[m_triangles[i] * 3 + corner];
+                        if (m_vertexPosition[candidate] != to) {
+                            continue;
+                        }
+                        float normalCosine = glm::dot(m_normals[vertex], m_normals[candidate]);
+                        float texCoordDistance = glm::length(m_texCoords[vertex] - m_texCoords[candidate]);
+                        if (normalCosine < kSeamNormalCosine || texCoordDistance > kSeamTexCoordStretch * m_texCoordSpan[vertex] + kSeamTexCoordEpsilon) {
+                            continue;
+                        }
+                        float distance = (1.0f - normalCosine) + texCoordDistance;
+                        if (closest == ~0u || distance < closestDistance) {
+                            closest = candidate;
+                            closestDistance = distance;
+                        }
+                    }
+                }
+                return closest;
+            }
+
+            // rewrites the indices with this pass's collapses and drops the triangles that became degenerate
+            void applyCollapses() {
+                size_t kept = 0;
+                for (size_t t = 0; t < triangleCount(); ++t) {
+                    unsigned int corners[3];
+                    for (int corner = 0; corner < 3; ++corner) {
+                        corners[corner] = m_vertexTarget[m_indices[t * 3 + corner]];
+                    }
+                    unsigned int p0 = m_vertexPosition[corners[0]], p1 = m_vertexPosition[corners[1]], p2 = m_vertexPosition[corners[2]];
+                    if (p0 == p1 || p1 == p2 || p0 == p2) {
+                        continue;
+                    }
+                    for (int corner = 0; corner < 3; ++corner) {
+                        m_indices[kept * 3 + corner] = corners[corner];
+                    }
+                    ++kept;
+                }
+                m_indices.resize(kept * 3);
+                std::iota(m_vertexTarget.begin(), m_vertexTarget.end(), 0u);
+            }
+        };
+    }
+
+    // Builds up to settings.levels - 1 coarser levels of a mesh, each with about settings.reduction times the
+    // triangles of the one before, as long as the simplification stays within the error budget. Stops early when a
+    // level would drop less than a tenth of the triangles. Levels are vertex cache ordered like the mesh itself
+    // (optimizeVertexCache) and their errors ascend.
+    template<typename VertexT>
+    std::vector<MeshLod> buildLods(const std::vector<VertexT>& vertices, const std::vector<unsigned int>& indices,
+                                   const LodSettings& settings = lodSettings()) {
+        std::vector<MeshLod> lods;
+        unsigned int levels = std::min(settings.levels, kMaxLodLevels);
+        if (indices.size() < 3 || levels < 2) {
+            return lods;
+        }
+        AABB bounds;
+        for (const VertexT& vertex : vertices) {
+            bounds.expand(vertex.Position);
+        }
+        float maxError = settings.maxError * glm::length(bounds.max - bounds.min);
+
+        detail::Simplifier simplifier(vertices, indices);
+        size_t triangles = indices.size() / 3;
+        for (unsigned int level = 1; level < levels; ++level) {
+            simplifier.simplify(static_cast<size_t>(triangles * settings.reduction), maxError);
+            size_t remaining = simplifier.triangleCount();
+            if (remaining == 0 || remaining * 10 > triangles * 9) {
+                break;
+            }
+            MeshLod lod;
+            lod.indices = simplifier.indices();
+            optimizeVertexCache(lod.indices, vertices.size());
+            lod.error = simplifier.error();
+            lods.push_back(std::move(lod));
+            triangles = remaining;
+        }
+        return lods;
+    }
+
+    // largest factor the upper 3x3 of transform scales lengths by, for object space errors of scaled instances
+    inline float maxScale(const glm::mat4& transform) {
+        return std::max(glm::length(glm::vec3(transform[0])), std::max(glm::length(glm::vec3(transform[1])), glm::length(glm::vec3(transform[2]))));
+    }
+
+    // Picks levels by the screen space size of their error: an error e at distance d covers e * pixelScale / d
+    // pixels, pixelScale being viewport height / (2 tan(fovy / 2)). An instance takes its coarsest level under
+    // threshold pixels, measured at the nearest point of its bounds. Levels only change once the error is
+    // hysteresis (a fraction of the threshold) past the threshold, so an instance hovering at the switching
+    // distance doesn't flip between two levels every frame.
+    struct LodSelection {
+        glm::vec3 cameraPosition = glm::vec3(0.0f);
+        float pixelScale = 1.0f;
+        float threshold = 1.0f;
+        float hysteresis = 0.25f;
+
+        static LodSelection perspective(const glm::vec3& cameraPosition, float fovyDegrees, float viewportHeight,
+                                        float thresholdPixels) {
+            LodSelection selection;
+            selection.cameraPosition = cameraPosition;
+            selection.pixelScale = viewportHeight / (2.0f * std::tan(glm::radians(fovyDegrees) * 0.5f));
+            selection.threshold = thresholdPixels;
+            return selection;
+        }
+
+        float pixels(float error, float scale, const AABB& worldBounds) const {
+            glm::vec3 outside = glm::max(glm::max(worldBounds.min - cameraPosition, cameraPosition - worldBounds.max), glm::vec3(0.0f));
+            return error * scale * pixelScale / std::max(glm::length(outside), 1e-4f);
+        }
+
+        // errors[0 .. levels) ascending with errors[0] = 0, previous is the level of the last frame
+        unsigned int select(const float* errors, unsigned int levels, float scale, const AABB& worldBounds,
+                            unsigned int previous) const {
+            unsigned int level = std::min(previous, levels - 1);
+            while (level > 0 && pixels(errors[level], scale, worldBounds) > threshold * (1.0f + hysteresis)) {
+                --level;
+            }
+            while (level + 1 < levels && pixels(errors[level + 1], scale, worldBounds) <= threshold * (1.0f - hysteresis)) {
+                ++level;
+            }
+            return level;
+        }
+    };
+}
+
+#endif //PROJECT_BASE_MESHLOD_H
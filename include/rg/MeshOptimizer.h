@@ -0,0 +1,373 @@
+//
+// Created by matf-rg on 16.10.26..
+//
+
+#ifndef PROJECT_BASE_MESHOPTIMIZER_H
+#define PROJECT_BASE_MESHOPTIMIZER_H
+
+#include <glm/glm.hpp>
+
+#include <rg/Hash.h>
+
+#include <algorithm>
+#include <cstring>
+#include <numeric>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace rg {
+
+    // Index and vertex reordering for indexed triangle lists, run once per mesh at import:
+    //   weldVertices         merges bitwise identical vertices
+    //   optimizeVertexCache  orders triangles for the post-transform cache (Tipsify, Sander et al. 2007)
+    //   optimizeOverdraw     reorders clusters of those triangles front to back, keeping their cache order
+    //   optimizeVertexFetch  orders vertices by first use, so the vertex buffer is read front to back
+    // The vertex functions need only a Position member, so they work for any vertex layout.
+
+    // FIFO entries assumed by the cache optimizer and the statistics; 16 is a conservative size for current GPUs
+    constexpr unsigned int kVertexCacheSize = 16;
+
+    // post-transform cache behaviour of an index buffer under a simulated FIFO cache. sums over several meshes
+    // with add(), the ratios are then weighted by triangle and vertex count.
+    struct VertexCacheStats {
+        size_t vertices = 0;   // vertices in the vertex buffer
+        size_t triangles = 0;
+        size_t transforms = 0; // vertex shader invocations, i.e. cache misses
+
+        // average cache miss ratio: transforms per triangle, 3 is the worst case and 0.5 the ideal for large grids
+        double acmr() const { return triangles ? double(transforms) / triangles : 0.0; }
+        // average transform to vertex ratio: 1 means every vertex is transformed exactly once
+        double atvr() const { return vertices ? double(transforms) / vertices : 0.0; }
+
+        void add(const VertexCacheStats& other) {
+            vertices += other.vertices;
+            triangles += other.triangles;
+            transforms += other.transforms;
+        }
+    };
+
+    // one line with vertex counts, ACMR and ATVR before and after optimizeMesh
+    inline void printVertexCacheStats(std::ostream& out, const std::string& name, const VertexCacheStats& before,
+                                      const VertexCacheStats& after) {
+        out << "MESH_OPT:: " << name << " vertices " << before.vertices << " -> " << after.vertices
+            << ", ACMR " << before.acmr() << " -> " << after.acmr()
+            << ", ATVR " << before.atvr() << " -> " << after.atvr() << std::endl;
+    }
+
+    namespace detail {
+        // FIFO cache simulation with timestamps: a vertex is cached while fewer than cacheSize newer vertices
+        // have entered since it did. advancing time by cacheSize + 1 flushes the cache.
+        struct VertexCacheSimulation {
+            std::vector<unsigned int> entered;
+            unsigned int time;
+            unsigned int cacheSize;
+
+            VertexCacheSimulation(size_t vertexCount, unsigned int cacheSize)
+            : entered(vertexCount, 0), time(cacheSize + 1), cacheSize(cacheSize) {}
+
+            bool cached(unsigned int vertex) const { return time - entered[vertex] <= cacheSize; }
+
+            // returns 1 if the vertex had to be transformed
+            unsigned int access(unsigned int vertex) {
+                if (cached(vertex)) {
+                    return 0;
+                }
+                entered[vertex] = time++;
+                return 1;
+            }
+
+            void flush() { time += cacheSize + 1; }
+        };
+
+        // triangles using each vertex: those of vertex v are triangles[offsets[v] .. offsets[v + 1])
+        struct VertexTriangles {
+            std::vector<unsigned int> offsets;
+            std::vector<unsigned int> triangles;
+
+            VertexTriangles(const std::vector<unsigned int>& indices, size_t vertexCount)
+            : offsets(vertexCount + 1, 0), triangles(indices.size()) {
+                for (unsigned int index : indices) {
+                    offsets[index + 1]++;
+                }
+                std::partial_sum(offsets.begin(), offsets.end(), offsets.begin());
+                std::vector<unsigned int> fill(offsets.begin(), offsets.end() - 1);
+                for (size_t i = 0; i < indices.size(); ++i) {
+                    triangles[fill[indices[i]]++] = static_cast<unsigned int>(i / 3);
+                }
+            }
+
+            unsigned int count(unsigned int vertex) const { return offsets[vertex + 1] - offsets[vertex]; }
+        };
+
+        template<typename VertexT>
+        struct VertexBytesHash {
+            const VertexT* vertices;
+            size_t operator()(unsigned int index) const {
+                return static_cast<size_t>(hashBytes(&vertices[index], sizeof(VertexT)));
+            }
+        };
+
+        template<typename VertexT>
+        struct VertexBytesEqual {
+            const VertexT* vertices;
+            bool operator()(unsigned int a, unsigned int b) const {
+                return std::memcmp(&vertices[a], &vertices[b], sizeof(VertexT)) == 0;
+            }
+        };
+    }
+
+    inline VertexCacheStats analyzeVertexCache(const std::vector<unsigned int>& indices, size_t vertexCount,
+                                               unsigned int cacheSize = kVertexCacheSize) {
+        VertexCacheStats stats;
+        stats.vertices = vertexCount;
+        stats.triangles = indices.size() / 3;
+        detail::VertexCacheSimulation cache(vertexCount, cacheSize);
+        for (unsigned int index : indices) {
+            stats.transforms += cache.access(index);
+        }
+        return stats;
+    }
+
+    // merges vertices whose bytes are identical and rewrites the indices to match; vertex order is first occurrence.
+    // VertexT must have no padding, which holds for the float-only Vertex.
+    template<typename VertexT>
+    void weldVertices(std::vector<VertexT>& vertices, std::vector<unsigned int>& indices) {
+        detail::VertexBytesHash<VertexT> hash{vertices.data()};
+        detail::VertexBytesEqual<VertexT> equal{vertices.data()};
+        std::unordered_map<unsigned int, unsigned int, detail::VertexBytesHash<VertexT>, detail::VertexBytesEqual<VertexT>>
+                unique(vertices.size(), hash, equal);
+        std::vector<unsigned int> remap(vertices.size());
+        unsigned int welded = 0;
+        for (unsigned int i = 0; i < vertices.size(); ++i) {
+            auto inserted = unique.emplace(i, welded);
+            if (inserted.second) {
+                welded++;
+            }
+            remap[i] = inserted.first->second;
+        }
+        std::vector<VertexT> result(welded);
+        for (unsigned int i = 0; i < vertices.size(); ++i) {
+            result[remap[i]] = vertices[i];
+        }
+        vertices.swap(result);
+        for (unsigned int& index : indices) {
+            index = remap[index];
+        }
+    }
+
+    // Tipsify: fans around one vertex at a time, emitting all its remaining triangles, then continues with the
+    // neighbour that entered the cache longest ago but will still be cached after its own fan. Linear time, and
+    // close to Forsyth's ACMR without its per triangle scoring.
+    inline void optimizeVertexCache(std::vector<unsigned int>& indices, size_t vertexCount, unsigned int cacheSize = kVertexCacheSize) {
+        size_t triangleCount = indices.size() / 3;
+        if (triangleCount == 0) {
+            return;
+        }
+        detail::VertexTriangles adjacency(indices, vertexCount);
+        std::vector<unsigned int> live(vertexCount);
+        for (unsigned int v = 0; v < vertexCount; ++v) {
+            live[v] = adjacency.count(v);
+        }
+        std::vector<bool> emitted(triangleCount, false);
+        detail::VertexCacheSimulation cache(vertexCount, cacheSize);
+        std::vector<unsigned int> deadEnd;    // recently used vertices to fall back to when no neighbour is good
+        std::vector<unsigned int> candidates;
+        std::vector<unsigned int> result;
+        result.reserve(indices.size());
+        unsigned int cursor = 0;              // next vertex to try once the dead-end stack is exhausted
+
+        long fanning = indices[0];
+        while (fanning >= 0) {
+            candidates.clear();
+            for (unsigned int i = adjacency.offsets[fanning]; i < adjacency.offsets[fanning + 1]; ++i) {
+                unsigned int triangle = adjacency.triangles[i];
+                if (emitted[triangle]) {
+                    continue;
+                }
+                emitted[triangle] = true;
+                for (unsigned int corner = 0; corner < 3; ++corner) {
+                    unsigned int v = indices[triangle * 3 + corner];
+                    result.push_back(v);
+                    deadEnd.push_back(v);
+                    candidates.push_back(v);
+                    live[v]--;
+                    cache.access(v);
+                }
+            }
+
+            // the candidate that entered the cache longest ago but will survive fanning its live triangles
+            fanning = -1;
+            long bestPriority = -1;
+            for (unsigned int v : candidates) {
+                if (live[v] == 0) {
+                    continue;
+                }
+                long priority = 0;
+                unsigned int age = cache.time - cache.entered[v];
+                if (age + 2 * live[v] <= cacheSize) {
+                    priority = age;
+                }
+                if (priority > bestPriority) {
+                    bestPriority = priority;
+                    fanning = v;
+                }
+            }
+            if (fanning >= 0) {
+                continue;
+            }
+            while (!deadEnd.empty()) {
+                unsigned int v = deadEnd.back();
+                deadEnd.pop_back();
+                if (live[v] > 0) {
+                    fanning = v;
+                    break;
+                }
+            }
+            while (fanning < 0 && cursor < vertexCount) {
+                if (live[cursor] > 0) {
+                    fanning = cursor;
+                }
+                cursor++;
+            }
+        }
+        indices.swap(result);
+    }
+
+    // Splits the cache ordered triangles into clusters and draws the clusters facing away from the mesh centre
+    // first, so outer surfaces tend to be drawn before what they hide (Sander et al. 2007). A cluster ends where
+    // the running ACMR reaches threshold times that of its surrounding fan sequence, so the cache order costs at
+    // most that factor. Run after optimizeVertexCache.
+    template<typename VertexT>
+    void optimizeOverdraw(std::vector<unsigned int>& indices, const std::vector<VertexT>& vertices, float threshold = 1.05f,
+                          unsigned int cacheSize = kVertexCacheSize) {
+        size_t triangleCount = indices.size() / 3;
+        if (triangleCount < 2) {
+            return;
+        }
+        detail::VertexCacheSimulation cache(vertices.size(), cacheSize);
+
+        // hard boundaries: triangles missing the cache on all three vertices, where Tipsify started over
+        std::vector<size_t> hard;
+        for (size_t t = 0; t < triangleCount; ++t) {
+            unsigned int misses = cache.access(indices[t * 3]) + cache.access(indices[t * 3 + 1]) + cache.access(indices[t * 3 + 2]);
+            if (t == 0 || misses == 3) {
+                hard.push_back(t);
+            }
+        }
+        hard.push_back(triangleCount);
+
+        // soft boundaries inside each hard cluster
+        std::vector<size_t> clusters;
+        for (size_t h = 0; h + 1 < hard.size(); ++h) {
+            size_t start = hard[h], end = hard[h + 1];
+            cache.flush();
+            size_t clusterMisses = 0;
+            for (size_t t = start; t < end; ++t) {
+                clusterMisses += cache.access(indices[t * 3]) + cache.access(indices[t * 3 + 1]) + cache.access(indices[t * 3 + 2]);
+            }
+            double clusterThreshold = threshold * double(clusterMisses) / double(end - start);
+
+            clusters.push_back(start);
+            cache.flush();
+            size_t runningMisses = 0, runningTriangles = 0;
+            for (size_t t = start; t < end; ++t) {
+                runningMisses += cache.access(indices[t * 3]) + cache.access(indices[t * 3 + 1]) + cache.access(indices[t * 3 + 2]);
+                runningTriangles++;
+                if (double(runningMisses) / double(runningTriangles) <= clusterThreshold && t + 1 < end) {
+                    clusters.push_back(t + 1);
+                    cache.flush();
+                    runningMisses = 0;
+                    runningTriangles = 0;
+                }
+            }
+            // a few leftover triangles make a poor cluster of their own, keep them with the previous one
+            if (runningTriangles > 0 && clusters.back() != start && runningTriangles < (end - start) / 4) {
+                clusters.pop_back();
+            }
+        }
+        clusters.push_back(triangleCount);
+
+        // area weighted centroid and normal of every cluster and of the whole mesh
+        size_t clusterCount = clusters.size() - 1;
+        std::vector<glm::vec3> centroids(clusterCount, glm::vec3(0.0f)), normals(clusterCount, glm::vec3(0.0f));
+        std::vector<float> areas(clusterCount, 0.0f);
+        glm::vec3 meshCentroid(0.0f);
+        float meshArea = 0.0f;
+        for (size_t c = 0; c < clusterCount; ++c) {
+            for (size_t t = clusters[c]; t < clusters[c + 1]; ++t) {
+                const glm::vec3& a = vertices[indices[t * 3]].Position;
+                const glm::vec3& b = vertices[indices[t * 3 + 1]].Position;
+                const glm::vec3& d = vertices[indices[t * 3 + 2]].Position;
+                glm::vec3 normal = glm::cross(b - a, d - a);
+                float area = glm::length(normal);
+                centroids[c] += (a + b + d) * (area / 3.0f);
+                normals[c] += normal;
+                areas[c] += area;
+            }
+            meshCentroid += centroids[c];
+            meshArea += areas[c];
+            if (areas[c] > 0.0f) {
+                centroids[c] /= areas[c];
+            }
+        }
+        if (meshArea > 0.0f) {
+            meshCentroid /= meshArea;
+        }
+        std::vector<float> keys(clusterCount);
+        for (size_t c = 0; c < clusterCount; ++c) {
+            float length = glm::length(normals[c]);
+            keys[c] = length > 0.0f ? glm::dot(centroids[c] - meshCentroid, normals[c] / length) : 0.0f;
+        }
+
+        std::vector<size_t> order(clusterCount);
+        std::iota(order.begin(), order.end(), size_t(0));
+        std::stable_sort(order.begin(), order.end(), [&keys](size_t a, size_t b) { return keys[a] > keys[b]; });
+        std::vector<unsigned int> result;
+        result.reserve(indices.size());
+        for (size_t c : order) {
+            result.insert(result.end(), indices.begin() + clusters[c] * 3, indices.begin() + clusters[c + 1] * 3);
+        }
+        indices.swap(result);
+    }
+
+    // renumbers vertices in the order the indices first use them and drops unreferenced ones
+    template<typename VertexT>
+    void optimizeVertexFetch(std::vector<VertexT>& vertices, std::vector<unsigned int>& indices) {
+        const unsigned int unused = ~0u;
+        std::vector<unsigned int> remap(vertices.size(), unused);
+        unsigned int next = 0;
+        for (unsigned int& index : indices) {
+            if (remap[index] == unused) {
+                remap[index] = next++;
+            }
+            index = remap[index];
+        }
+        std::vector<VertexT> result(next);
+        for (size_t i = 0; i < vertices.size(); ++i) {
+            if (remap[i] != unused) {
+                result[remap[i]] = vertices[i];
+            }
+        }
+        vertices.swap(result);
+    }
+
+    // the whole pipeline, in the order the passes depend on each other
+    template<typename VertexT>
+    void optimizeMesh(std::vector<VertexT>& vertices, std::vector<unsigned int>& indices,
+                      VertexCacheStats* before = nullptr, VertexCacheStats* after = nullptr) {
+        if (before) {
+            before->add(analyzeVertexCache(indices, vertices.size()));
+        }
+        weldVertices(vertices, indices);
+        optimizeVertexCache(indices, vertices.size());
+        optimizeOverdraw(indices, vertices);
+        optimizeVertexFetch(vertices, indices);
+        if (after) {
+            after->add(analyzeVertexCache(indices, vertices.size()));
+        }
+    }
+}
+
+#endif //PROJECT_BASE_MESHOPTIMIZER_H
@@ -0,0 +1,110 @@
+//
+// Created by matf-rg on 16.10.26..
+//
+
+#ifndef PROJECT_BASE_MODELIMPORT_H
+#define PROJECT_BASE_MODELIMPORT_H
+
+#include <assimp/Importer.hpp>
+#include <assimp/scene.h>
+#include <assimp/postprocess.h>
+
+#include <learnopengl/mesh.h>
+#include <rg/Bounds.h>
+#include <rg/MeshCache.h>
+#include <rg/MeshLod.h>
+#include <rg/MeshOptimizer.h>
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace rg {
+
+    // one mesh as ASSIMP delivers it, before anything touches GL
+    struct ImportedMesh {
+        std::vector<Vertex> vertices;
+        std::vector<unsigned int> indices;
+        std::vector<TextureRef> textures;
+        AABB bounds;
+        std::vector<MeshLod> lods; // coarser levels of detail, filled by importModel
+    };
+
+    // post processing every import runs, Model's cold path and the cooker alike
+    constexpr unsigned int kImportFlags = aiProcess_Triangulate | aiProcess_GenSmoothNormals | aiProcess_FlipUVs | aiProcess_CalcTangentSpace;
+
+    namespace detail {
+        inline ImportedMesh importMesh(const aiMesh* mesh, const aiScene* scene) {
+            ImportedMesh result;
+            result.vertices.resize(mesh->mNumVertices);
+            for (unsigned int i = 0; i < mesh->mNumVertices; i++) {
+                Vertex& vertex = result.vertices[i];
+                vertex.Position = glm::vec3(mesh->mVertices[i].x, mesh->mVertices[i].y, mesh->mVertices[i].z);
+                result.bounds.expand(vertex.Position);
+                if (mesh->HasNormals()) {
+                    vertex.Normal = glm::vec3(mesh->mNormals[i].x, mesh->mNormals[i].y, mesh->mNormals[i].z);
+                }
+                // only the first of the up to 8 texture coordinate sets is used
+                if (mesh->mTextureCoords[0]) {
+                    vertex.TexCoords = glm::vec2(mesh->mTextureCoords[0][i].x, mesh->mTextureCoords[0][i].y);
+                    vertex.Tangent = glm::vec3(mesh->mTangents[i].x, mesh->mTangents[i].y, mesh->mTangents[i].z);
+                    vertex.Bitangent = glm::vec3(mesh->mBitangents[i].x, mesh->mBitangents[i].y, mesh->mBitangents[i].z);
+                } else {
+                    vertex.TexCoords = glm::vec2(0.0f, 0.0f);
+                }
+            }
+            result.indices.reserve(size_t(mesh->mNumFaces) * 3);
+            for (unsigned int i = 0; i < mesh->mNumFaces; i++) {
+                const aiFace& face = mesh->mFaces[i];
+                for (unsigned int j = 0; j < face.mNumIndices; j++) {
+                    result.indices.push_back(face.mIndices[j]);
+                }
+            }
+
+            // sampler names follow the texture_diffuseN, texture_specularN, ... convention of the shaders
+            const aiTextureType types[] = {aiTextureType_DIFFUSE, aiTextureType_SPECULAR, aiTextureType_HEIGHT, aiTextureType_AMBIENT};
+            const char* typeNames[] = {"texture_diffuse", "texture_specular", "texture_normal", "texture_height"};
+            const aiMaterial* material = scene->mMaterials[mesh->mMaterialIndex];
+            for (int t = 0; t < 4; t++) {
+                for (unsigned int i = 0; i < material->GetTextureCount(types[t]); i++) {
+                    aiString path;
+                    material->GetTexture(types[t], i, &path);
+                    result.textures.push_back(TextureRef{typeNames[t], path.C_Str()});
+                }
+            }
+            return result;
+        }
+
+        inline void importNode(const aiNode* node, const aiScene* scene, std::vector<ImportedMesh>& meshes) {
+            for (unsigned int i = 0; i < node->mNumMeshes; i++) {
+                meshes.push_back(importMesh(scene->mMeshes[node->mMeshes[i]], scene));
+            }
+            for (unsigned int i = 0; i < node->mNumChildren; i++) {
+                importNode(node->mChildren[i], scene, meshes);
+            }
+        }
+    }
+
+    // reads a model with ASSIMP, meshes in node order, runs every mesh through optimizeMesh and builds its levels
+    // of detail with the current lodSettings(). the cache statistics of all meshes before and after are summed
+    // into before/after if given.
+    // touches no GL state, safe on any thread.
+    inline bool importModel(const std::string& path, std::vector<ImportedMesh>& meshes,
+                            VertexCacheStats* before = nullptr, VertexCacheStats* after = nullptr) {
+        Assimp::Importer importer;
+        const aiScene* scene = importer.ReadFile(path, kImportFlags);
+        if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode) {
+            std::cout << "ERROR::ASSIMP:: " << importer.GetErrorString() << std::endl;
+            return false;
+        }
+        meshes.clear();
+        detail::importNode(scene->mRootNode, scene, meshes);
+        for (ImportedMesh& mesh : meshes) {
+            optimizeMesh(mesh.vertices, mesh.indices, before, after);
+            mesh.lods = buildLods(mesh.vertices, mesh.indices);
+        }
+        return true;
+    }
+}
+
+#endif //PROJECT_BASE_MODELIMPORT_H
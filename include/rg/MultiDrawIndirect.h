@@ -0,0 +1,100 @@
+//
+// Created by matf-rg on 16.10.26..
+//
+
+#ifndef PROJECT_BASE_MULTIDRAWINDIRECT_H
+#define PROJECT_BASE_MULTIDRAWINDIRECT_H
+
+#include <glad/glad.h>
+
+#include <cstring>
+
+// glad is generated for GL 3.3 core, the GL 4.3 / ARB_multi_draw_indirect entry point and enums are loaded here
+#ifndef GL_DRAW_INDIRECT_BUFFER
+#define GL_DRAW_INDIRECT_BUFFER 0x8F3F
+#endif
+
+namespace rg {
+
+    // one draw of glMultiDrawElementsIndirect, laid out as GL reads it from the indirect buffer.
+    // firstIndex counts indices, not bytes; baseInstance offsets the per instance attributes.
+    struct DrawElementsIndirectCommand {
+        GLuint count;
+        GLuint instanceCount;
+        GLuint firstIndex;
+        GLint baseVertex;
+        GLuint baseInstance;
+    };
+    static_assert(sizeof(DrawElementsIndirectCommand) == 20, "the indirect buffer layout is fixed by GL");
+
+    typedef void (APIENTRYP PFNRGMULTIDRAWELEMENTSINDIRECTPROC)(GLenum mode, GLenum type, const void* indirect,
+                                                                GLsizei drawcount, GLsizei stride);
+    typedef void (APIENTRYP PFNRGDRAWELEMENTSINSTANCEDBASEVERTEXBASEINSTANCEPROC)(GLenum mode, GLsizei count, GLenum type,
+                                                                                 const void* indices, GLsizei instancecount,
+                                                                                 GLint basevertex, GLuint baseinstance);
+
+    namespace detail {
+        inline PFNRGMULTIDRAWELEMENTSINDIRECTPROC& multiDrawElementsIndirectProc() {
+            static PFNRGMULTIDRAWELEMENTSINDIRECTPROC proc = nullptr;
+            return proc;
+        }
+
+        inline PFNRGDRAWELEMENTSINSTANCEDBASEVERTEXBASEINSTANCEPROC& drawElementsInstancedBaseInstanceProc() {
+            static PFNRGDRAWELEMENTSINSTANCEDBASEVERTEXBASEINSTANCEPROC proc = nullptr;
+            return proc;
+        }
+
+        inline bool hasExtension(const char* name) {
+            GLint count = 0;
+            glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+            for (GLint i = 0; i < count; ++i) {
+                const char* extension = reinterpret_cast<const char*>(glGetStringi(GL_EXTENSIONS, i));
+                if (extension && std::strcmp(extension, name) == 0) {
+                    return true;
+                }
+            }
+            return false;
+        }
+    }
+
+    // looks up glMultiDrawElementsIndirect after glad is loaded, with the same loader. needs a GL 4.3 context or
+    // ARB_multi_draw_indirect (baseInstance needs GL 4.2 / ARB_base_instance, which both imply).
+    inline bool loadMultiDrawIndirect(GLADloadproc load) {
+        bool supported = (GLVersion.major > 4 || (GLVersion.major == 4 && GLVersion.minor >= 3))
+                         || (detail::hasExtension("GL_ARB_multi_draw_indirect") && detail::hasExtension("GL_ARB_base_instance"));
+        detail::multiDrawElementsIndirectProc() = supported
+            ? reinterpret_cast<PFNRGMULTIDRAWELEMENTSINDIRECTPROC>(load("glMultiDrawElementsIndirect")) : nullptr;
+        return detail::multiDrawElementsIndirectProc() != nullptr;
+    }
+
+    inline bool multiDrawIndirectSupported() {
+        return detail::multiDrawElementsIndirectProc() != nullptr;
+    }
+
+    // looks up glDrawElementsInstancedBaseVertexBaseInstance, GL 4.2 or ARB_base_instance. with it instanced draws
+    // start at any instance of the bound attributes, so meshes sharing an instance buffer share its binding too
+    inline bool loadBaseInstance(GLADloadproc load) {
+        bool supported = (GLVersion.major > 4 || (GLVersion.major == 4 && GLVersion.minor >= 2))
+                         || detail::hasExtension("GL_ARB_base_instance");
+        detail::drawElementsInstancedBaseInstanceProc() = supported
+            ? reinterpret_cast<PFNRGDRAWELEMENTSINSTANCEDBASEVERTEXBASEINSTANCEPROC>(load("glDrawElementsInstancedBaseVertexBaseInstance")) : nullptr;
+        return detail::drawElementsInstancedBaseInstanceProc() != nullptr;
+    }
+
+    inline bool baseInstanceSupported() {
+        return detail::drawElementsInstancedBaseInstanceProc() != nullptr;
+    }
+
+    inline void drawElementsInstancedBaseVertexBaseInstance(GLsizei count, GLenum type, const void* indices, GLsizei instanceCount,
+                                                            GLint baseVertex, GLuint baseInstance) {
+        detail::drawElementsInstancedBaseInstanceProc()(GL_TRIANGLES, count, type, indices, instanceCount, baseVertex, baseInstance);
+    }
+
+    // draws drawCount commands from the bound GL_DRAW_INDIRECT_BUFFER, starting offset bytes in
+    inline void multiDrawElementsIndirect(GLenum type, size_t offset, GLsizei drawCount) {
+        detail::multiDrawElementsIndirectProc()(GL_TRIANGLES, type, reinterpret_cast<const void*>(offset), drawCount,
+                                                sizeof(DrawElementsIndirectCommand));
+    }
+}
+
+#endif //PROJECT_BASE_MULTIDRAWINDIRECT_H
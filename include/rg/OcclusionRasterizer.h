@@ -0,0 +1,414 @@
+//
+// Created by matf-rg on 16.10.26..
+//
+
+#ifndef PROJECT_BASE_OCCLUSIONRASTERIZER_H
+#define PROJECT_BASE_OCCLUSIONRASTERIZER_H
+
+#include <glm/glm.hpp>
+#include <rg/Bounds.h>
+#include <rg/CpuProfiler.h>
+#include <rg/FrameStats.h>
+#include <rg/ThreadPool.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <future>
+#include <initializer_list>
+#include <map>
+#include <tuple>
+#include <vector>
+
+#if defined(__SSE2__) || defined(__AVX__)
+#include <immintrin.h>
+#endif
+
+namespace rg {
+
+    // object space triangles a model hides things with, drawn by the OcclusionRasterizer instead of the model
+    struct OccluderMesh {
+        std::vector<glm::vec3> positions;
+        std::vector<uint32_t> indices;
+
+        size_t triangleCount() const { return indices.size() / 3; }
+        bool empty() const { return indices.empty(); }
+    };
+
+    // Picks an occluder out of a model's meshes: its largest triangles, until they cover areaFraction of the
+    // total surface or maxTriangles are taken. A subset of the real surface can only hide what the model
+    // hides, so the proxy stays conservative however coarse it gets (vertex clustering or QEM would close
+    // windows and holes and hide things that are visible through them).
+    class OccluderBuilder {
+    public:
+        template<typename V>
+        void addMesh(const V* vertices, size_t vertexCount, const unsigned int* indices, size_t indexCount) {
+            for (size_t i = 0; i + 2 < indexCount; i += 3) {
+                if (indices[i] >= vertexCount || indices[i + 1] >= vertexCount || indices[i + 2] >= vertexCount) {
+                    continue;
+                }
+                Candidate candidate;
+                candidate.corners[0] = vertices[indices[i]].Position;
+                candidate.corners[1] = vertices[indices[i + 1]].Position;
+                candidate.corners[2] = vertices[indices[i + 2]].Position;
+                candidate.area = 0.5f * glm::length(glm::cross(candidate.corners[1] - candidate.corners[0],
+                                                               candidate.corners[2] - candidate.corners[0]));
+                if (candidate.area > 0.0f) {
+                    m_totalArea += candidate.area;
+                    m_candidates.push_back(candidate);
+                }
+            }
+        }
+
+        OccluderMesh build(size_t maxTriangles = 512, float areaFraction = 0.9f) {
+            std::sort(m_candidates.begin(), m_candidates.end(),
+                      [](const Candidate& a, const Candidate& b) { return a.area > b.area; });
+            OccluderMesh occluder;
+            std::map<std::tuple<float, float, float>, uint32_t> welded;
+            float covered = 0.0f;
+            for (const Candidate& candidate : m_candidates) {
+                if (occluder.triangleCount() >= maxTriangles || covered >= areaFraction * m_totalArea) {
+                    break;
+                }
+                for (const glm::vec3& corner : candidate.corners) {
+                    auto inserted = welded.emplace(std::make_tuple(corner.x, corner.y, corner.z),
+                                                   static_cast<uint32_t>(occluder.positions.size()));
+                    if (inserted.second) {
+                        occluder.positions.push_back(corner);
+                    }
+                    occluder.indices.push_back(inserted.first->second);
+                }
+                covered += candidate.area;
+            }
+            return occluder;
+        }
+
+        size_t candidateCount() const { return m_candidates.size(); }
+
+    private:
+        struct Candidate {
+            glm::vec3 corners[3];
+            float area;
+        };
+
+        std::vector<Candidate> m_candidates;
+        float m_totalArea = 0.0f;
+    };
+
+    // Software occlusion culling without GPU latency: occluder meshes are drawn into a small depth buffer on
+    // the CPU for this frame's camera, then boxes are tested against it before anything is queued. The screen is
+    // cut into tiles, triangles are binned per tile and rows of tiles are rasterized in parallel on the thread
+    // pool, 8 pixels at a time with AVX (configure with -DRG_ENABLE_AVX=ON), 4 with SSE, one otherwise.
+    //
+    // Depth is window depth as GL writes it (0 near, 1 far), each pixel keeps the nearest occluder. Triangles
+    // with a corner closer than the near plane (clip z < -w) are dropped rather than clipped, which only loses
+    // occlusion.
+    class OcclusionRasterizer {
+    public:
+        static constexpr int kTileWidth = 32;  // a multiple of the widest SIMD row step
+        static constexpr int kTileHeight = 16;
+
+        enum class Path { Simd, Scalar };
+
+        // width is rounded up to whole tiles
+        OcclusionRasterizer(unsigned int width, unsigned int height)
+        : m_width((std::max(width, 1u) + kTileWidth - 1) / kTileWidth * kTileWidth), m_height(std::max(height, 1u)) {
+            m_tilesX = m_width / kTileWidth;
+            m_tilesY = (m_height + kTileHeight - 1) / kTileHeight;
+            m_depth.assign(m_width * m_height, 1.0f);
+            m_tileMax.assign(m_tilesX * m_tilesY, 1.0f);
+            m_bins.resize(m_tilesX * m_tilesY);
+        }
+
+        // starts a frame seen through viewProjection, with no occluders
+        void begin(const glm::mat4& viewProjection) {
+            m_viewProjection = viewProjection;
+            m_triangles.clear();
+            for (std::vector<uint32_t>& bin : m_bins) {
+                bin.clear();
+            }
+            m_rasterized = false;
+        }
+
+        // sets up and bins the triangles of occluder placed with model
+        void addOccluder(const OccluderMesh& occluder, const glm::mat4& model) {
+            glm::mat4 transform = m_viewProjection * model;
+            m_clip.resize(occluder.positions.size());
+            for (size_t i = 0; i < occluder.positions.size(); ++i) {
+                m_clip[i] = transform * glm::vec4(occluder.positions[i], 1.0f);
+            }
+            for (size_t i = 0; i + 2 < occluder.indices.size(); i += 3) {
+                addTriangle(m_clip[occluder.indices[i]], m_clip[occluder.indices[i + 1]], m_clip[occluder.indices[i + 2]]);
+            }
+        }
+
+        // draws every binned triangle. pool may be null to draw on the calling thread only
+        void rasterize(ThreadPool* pool = &ThreadPool::shared(), Path path = Path::Simd) {
+            RG_PROFILE_SCOPE("OcclusionRasterizer::rasterize");
+            unsigned int jobs = pool ? std::min(pool->size() + 1, m_tilesY) : 1u;
+            unsigned int rowsPerJob = (m_tilesY + jobs - 1) / jobs;
+            std::vector<std::future<void>> pending;
+            for (unsigned int first = rowsPerJob; first < m_tilesY; first += rowsPerJob) {
+                unsigned int last = std::min(first + rowsPerJob, m_tilesY);
+                pending.push_back(pool->submit([this, first, last, path] { rasterizeTileRows(first, last, path); }));
+            }
+            // the first rows on this thread while the workers take the rest
+            rasterizeTileRows(0, std::min(rowsPerJob, m_tilesY), path);
+            for (std::future<void>& job : pending) {
+                job.get();
+            }
+            frameStats().occluderTriangles += static_cast<unsigned int>(m_triangles.size());
+            m_rasterized = true;
+        }
+
+        // false until the first rasterize after begin, nothing is occluded before
+        bool available() const { return m_rasterized; }
+
+        // true if the box is behind the occluders everywhere on screen: its nearest depth is farther than every
+        // pixel under its screen rectangle, grown by a pixel so occluders that only cover a pixel's center don't
+        // hide what peeks out of the rest of it. whole tiles are settled by their farthest depth first.
+        bool occluded(const AABB& box) const {
+            if (!m_rasterized) {
+                return false;
+            }
+            float rectMin[2] = {1.0f, 1.0f}, rectMax[2] = {0.0f, 0.0f};
+            float nearest = 1.0f;
+            for (int corner = 0; corner < 8; ++corner) {
+                glm::vec4 position((corner & 1) ? box.max.x : box.min.x, (corner & 2) ? box.max.y : box.min.y,
+                                   (corner & 4) ? box.max.z : box.min.z, 1.0f);
+                glm::vec4 clip = m_viewProjection * position;
+                // boxes reaching behind the camera can't be projected, keep them
+                if (clip.w <= 0.0f) {
+                    return false;
+                }
+                for (int axis = 0; axis < 2; ++axis) {
+                    float window = clip[axis] / clip.w * 0.5f + 0.5f;
+                    rectMin[axis] = std::min(rectMin[axis], window);
+                    rectMax[axis] = std::max(rectMax[axis], window);
+                }
+                nearest = std::min(nearest, clip.z / clip.w * 0.5f + 0.5f);
+            }
+            int x0 = pixel(rectMin[0], m_width) - 1, x1 = pixel(rectMax[0], m_width) + 1;
+            int y0 = pixel(rectMin[1], m_height) - 1, y1 = pixel(rectMax[1], m_height) + 1;
+            x0 = std::max(x0, 0);
+            y0 = std::max(y0, 0);
+            x1 = std::min(x1, static_cast<int>(m_width) - 1);
+            y1 = std::min(y1, static_cast<int>(m_height) - 1);
+            for (int tileY = y0 / kTileHeight; tileY <= y1 / kTileHeight; ++tileY) {
+                for (int tileX = x0 / kTileWidth; tileX <= x1 / kTileWidth; ++tileX) {
+                    if (m_tileMax[tileY * m_tilesX + tileX] < nearest) {
+                        continue;
+                    }
+                    int rowEnd = std::min(y1, (tileY + 1) * kTileHeight - 1);
+                    int columnEnd = std::min(x1, (tileX + 1) * kTileWidth - 1);
+                    for (int y = std::max(y0, tileY * kTileHeight); y <= rowEnd; ++y) {
+                        const float* row = &m_depth[y * m_width];
+                        for (int x = std::max(x0, tileX * kTileWidth); x <= columnEnd; ++x) {
+                            if (row[x] >= nearest) {
+                                return false;
+                            }
+                        }
+                    }
+                }
+            }
+            return true;
+        }
+
+        unsigned int width() const { return m_width; }
+        unsigned int height() const { return m_height; }
+        size_t triangleCount() const { return m_triangles.size(); }
+        const std::vector<float>& depth() const { return m_depth; }
+
+    private:
+        // edge functions and depth plane of a screen space triangle, all evaluated at pixel centers
+        struct Triangle {
+            float edgeA[3], edgeB[3], edgeC[3];
+            float depthA, depthB, depthC;
+            int minX, maxX, minY, maxY;
+        };
+
+        unsigned int m_width, m_height;
+        unsigned int m_tilesX, m_tilesY;
+        std::vector<float> m_depth;
+        std::vector<float> m_tileMax;              // farthest depth of each tile
+        std::vector<std::vector<uint32_t>> m_bins; // triangles overlapping each tile
+        std::vector<Triangle> m_triangles;
+        std::vector<glm::vec4> m_clip;
+        glm::mat4 m_viewProjection = glm::mat4(1.0f);
+        bool m_rasterized = false;
+
+        static int pixel(float window, unsigned int size) {
+            return static_cast<int>(std::floor(std::min(std::max(window, 0.0f), 1.0f) * size));
+        }
+
+        void addTriangle(const glm::vec4& a, const glm::vec4& b, const glm::vec4& c) {
+            // a corner closer than the near plane (z < -w) would write negative depth over pixels where GL clips
+            // the occluder away, hiding what is visible there
+            const float nearW = 1e-5f;
+            for (const glm::vec4* corner : {&a, &b, &c}) {
+                if (corner->w <= nearW || corner->z < -corner->w) {
+                    return;
+                }
+            }
+            float x[3], y[3], z[3];
+            const glm::vec4* corners[3] = {&a, &b, &c};
+            for (int i = 0; i < 3; ++i) {
+                const glm::vec4& corner = *corners[i];
+                x[i] = (corner.x / corner.w * 0.5f + 0.5f) * m_width;
+                y[i] = (corner.y / corner.w * 0.5f + 0.5f) * m_height;
+                z[i] = corner.z / corner.w * 0.5f + 0.5f;
+            }
+            float area = (x[1] - x[0]) * (y[2] - y[0]) - (x[2] - x[0]) * (y[1] - y[0]);
+            if (std::abs(area) < 1e-8f) {
+                return;
+            }
+            Triangle triangle;
+            triangle.minX = std::max(static_cast<int>(std::floor(std::min(std::min(x[0], x[1]), x[2]))), 0);
+            triangle.maxX = std::min(static_cast<int>(std::ceil(std::max(std::max(x[0], x[1]), x[2]))), static_cast<int>(m_width) - 1);
+            triangle.minY = std::max(static_cast<int>(std::floor(std::min(std::min(y[0], y[1]), y[2]))), 0);
+            triangle.maxY = std::min(static_cast<int>(std::ceil(std::max(std::max(y[0], y[1]), y[2]))), static_cast<int>(m_height) - 1);
+            if (triangle.minX > triangle.maxX || triangle.minY > triangle.maxY) {
+                return;
+            }
+            // both windings draw, the edges are flipped so the inside is positive
+            float sign = area > 0.0f ? 1.0f : -1.0f;
+            for (int i = 0; i < 3; ++i) {
+                int j = (i + 1) % 3;
+                triangle.edgeA[i] = sign * (y[i] - y[j]);
+                triangle.edgeB[i] = sign * (x[j] - x[i]);
+                triangle.edgeC[i] = sign * (x[i] * y[j] - x[j] * y[i]);
+            }
+            // z is linear in window space: z = depthA * x + depthB * y + depthC
+            float inverseArea = 1.0f / area;
+            triangle.depthA = ((z[1] - z[0]) * (y[2] - y[0]) - (z[2] - z[0]) * (y[1] - y[0])) * inverseArea;
+            triangle.depthB = ((z[2] - z[0]) * (x[1] - x[0]) - (z[1] - z[0]) * (x[2] - x[0])) * inverseArea;
+            triangle.depthC = z[0] - triangle.depthA * x[0] - triangle.depthB * y[0];
+
+            uint32_t index = static_cast<uint32_t>(m_triangles.size());
+            m_triangles.push_back(triangle);
+            for (int tileY = triangle.minY / kTileHeight; tileY <= triangle.maxY / kTileHeight; ++tileY) {
+                for (int tileX = triangle.minX / kTileWidth; tileX <= triangle.maxX / kTileWidth; ++tileX) {
+                    m_bins[tileY * m_tilesX + tileX].push_back(index);
+                }
+            }
+        }
+
+        void rasterizeTileRows(unsigned int firstRow, unsigned int lastRow, Path path) {
+            for (unsigned int tileY = firstRow; tileY < lastRow; ++tileY) {
+                for (unsigned int tileX = 0; tileX < m_tilesX; ++tileX) {
+                    rasterizeTile(tileX, tileY, path);
+                }
+            }
+        }
+
+        void rasterizeTile(unsigned int tileX, unsigned int tileY, Path path) {
+            int tileX0 = tileX * kTileWidth, tileX1 = tileX0 + kTileWidth - 1;
+            int tileY0 = tileY * kTileHeight, tileY1 = std::min(tileY0 + kTileHeight, static_cast<int>(m_height)) - 1;
+            for (int y = tileY0; y <= tileY1; ++y) {
+                std::fill(&m_depth[y * m_width + tileX0], &m_depth[y * m_width + tileX1] + 1, 1.0f);
+            }
+            for (uint32_t index : m_bins[tileY * m_tilesX + tileX]) {
+                const Triangle& triangle = m_triangles[index];
+                int x0 = std::max(triangle.minX, tileX0), x1 = std::min(triangle.maxX, tileX1);
+                int y0 = std::max(triangle.minY, tileY0), y1 = std::min(triangle.maxY, tileY1);
+                for (int y = y0; y <= y1; ++y) {
+                    if (path == Path::Simd) {
+                        rasterizeRow(triangle, y, x0, x1);
+                    } else {
+                        rasterizeRowScalar(triangle, y, x0, x1);
+                    }
+                }
+            }
+            float farthest = 0.0f;
+            for (int y = tileY0; y <= tileY1; ++y) {
+                const float* row = &m_depth[y * m_width];
+                for (int x = tileX0; x <= tileX1; ++x) {
+                    farthest = std::max(farthest, row[x]);
+                }
+            }
+            m_tileMax[tileY * m_tilesX + tileX] = farthest;
+        }
+
+        // one pixel at a time, the reference the SIMD rows are checked against. the arithmetic matches them
+        // operation for operation so both give the same depth
+        void rasterizeRowScalar(const Triangle& triangle, int y, int x0, int x1) {
+            float centerY = y + 0.5f;
+            float rowEdge[3];
+            for (int i = 0; i < 3; ++i) {
+                rowEdge[i] = triangle.edgeB[i] * centerY + triangle.edgeC[i];
+            }
+            float rowDepth = triangle.depthB * centerY + triangle.depthC;
+            float* row = &m_depth[y * m_width];
+            for (int x = x0; x <= x1; ++x) {
+                float centerX = x + 0.5f;
+                bool inside = true;
+                for (int i = 0; i < 3; ++i) {
+                    inside = inside && triangle.edgeA[i] * centerX + rowEdge[i] >= 0.0f;
+                }
+                if (inside) {
+                    row[x] = std::min(row[x], triangle.depthA * centerX + rowDepth);
+                }
+            }
+        }
+
+        // covers x0..x1 in aligned steps of the SIMD width. tiles are whole steps wide, so a step never leaves
+        // the tile, and pixels outside the triangle's bounds fail its edge tests
+        void rasterizeRow(const Triangle& triangle, int y, int x0, int x1) {
+#if defined(__AVX__)
+            float centerY = y + 0.5f;
+            __m256 edgeA[3], rowEdge[3];
+            for (int i = 0; i < 3; ++i) {
+                edgeA[i] = _mm256_set1_ps(triangle.edgeA[i]);
+                rowEdge[i] = _mm256_set1_ps(triangle.edgeB[i] * centerY + triangle.edgeC[i]);
+            }
+            __m256 depthA = _mm256_set1_ps(triangle.depthA);
+            __m256 rowDepth = _mm256_set1_ps(triangle.depthB * centerY + triangle.depthC);
+            const __m256 zero = _mm256_setzero_ps();
+            const __m256 lanes = _mm256_setr_ps(0.5f, 1.5f, 2.5f, 3.5f, 4.5f, 5.5f, 6.5f, 7.5f);
+            float* row = &m_depth[y * m_width];
+            for (int x = x0 & ~7; x <= x1; x += 8) {
+                __m256 centerX = _mm256_add_ps(_mm256_set1_ps(static_cast<float>(x)), lanes);
+                __m256 inside = _mm256_cmp_ps(_mm256_add_ps(_mm256_mul_ps(edgeA[0], centerX), rowEdge[0]), zero, _CMP_GE_OQ);
+                inside = _mm256_and_ps(inside, _mm256_cmp_ps(_mm256_add_ps(_mm256_mul_ps(edgeA[1], centerX), rowEdge[1]), zero, _CMP_GE_OQ));
+                inside = _mm256_and_ps(inside, _mm256_cmp_ps(_mm256_add_ps(_mm256_mul_ps(edgeA[2], centerX), rowEdge[2]), zero, _CMP_GE_OQ));
+                if (_mm256_movemask_ps(inside) == 0) {
+                    continue;
+                }
+                __m256 depth = _mm256_add_ps(_mm256_mul_ps(depthA, centerX), rowDepth);
+                __m256 current = _mm256_loadu_ps(row + x);
+                _mm256_storeu_ps(row + x, _mm256_blendv_ps(current, _mm256_min_ps(current, depth), inside));
+            }
+#elif defined(__SSE2__)
+            float centerY = y + 0.5f;
+            __m128 edgeA[3], rowEdge[3];
+            for (int i = 0; i < 3; ++i) {
+                edgeA[i] = _mm_set1_ps(triangle.edgeA[i]);
+                rowEdge[i] = _mm_set1_ps(triangle.edgeB[i] * centerY + triangle.edgeC[i]);
+            }
+            __m128 depthA = _mm_set1_ps(triangle.depthA);
+            __m128 rowDepth = _mm_set1_ps(triangle.depthB * centerY + triangle.depthC);
+            const __m128 zero = _mm_setzero_ps();
+            const __m128 lanes = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+            float* row = &m_depth[y * m_width];
+            for (int x = x0 & ~3; x <= x1; x += 4) {
+                __m128 centerX = _mm_add_ps(_mm_set1_ps(static_cast<float>(x)), lanes);
+                __m128 inside = _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(edgeA[0], centerX), rowEdge[0]), zero);
+                inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(edgeA[1], centerX), rowEdge[1]), zero));
+                inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(edgeA[2], centerX), rowEdge[2]), zero));
+                if (_mm_movemask_ps(inside) == 0) {
+                    continue;
+                }
+                __m128 depth = _mm_add_ps(_mm_mul_ps(depthA, centerX), rowDepth);
+                __m128 current = _mm_loadu_ps(row + x);
+                __m128 nearer = _mm_min_ps(current, depth);
+                _mm_storeu_ps(row + x, _mm_or_ps(_mm_and_ps(inside, nearer), _mm_andnot_ps(inside, current)));
+            }
+#else
+            rasterizeRowScalar(triangle, y, x0, x1);
+#endif
+        }
+    };
+}
+
+#endif //PROJECT_BASE_OCCLUSIONRASTERIZER_H
@@ -0,0 +1,114 @@
+//
+// Created by matf-rg on 16.10.26..
+//
+
+#ifndef PROJECT_BASE_READBACK_H
+#define PROJECT_BASE_READBACK_H
+
+#include <glad/glad.h>
+
+#include <cstring>
+#include <vector>
+
+namespace rg {
+
+    // Results the GPU produces for the CPU, read without stalling: each frame the GPU copies into the next free
+    // buffer of a small ring and a fence marks the copy, the CPU maps a buffer only once its fence has passed.
+    // What the CPU sees is a few frames old, and a frame whose ring is full skips its copy instead of waiting.
+    class ReadbackRing {
+    public:
+        explicit ReadbackRing(size_t bytes, unsigned int slots = 3)
+        : m_bytes(bytes), m_slots(slots) {
+            for (Slot& slot : m_slots) {
+                glGenBuffers(1, &slot.buffer);
+                glBindBuffer(GL_COPY_WRITE_BUFFER, slot.buffer);
+                glBufferData(GL_COPY_WRITE_BUFFER, bytes, nullptr, GL_STREAM_READ);
+            }
+            glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+        }
+
+        ReadbackRing(const ReadbackRing&) = delete;
+        ReadbackRing& operator=(const ReadbackRing&) = delete;
+
+        ~ReadbackRing() {
+            for (Slot& slot : m_slots) {
+                if (slot.fence) {
+                    glDeleteSync(slot.fence);
+                }
+                glDeleteBuffers(1, &slot.buffer);
+            }
+        }
+
+        // the slot the next copy goes to, -1 while every slot is still in flight
+        int acquire() const {
+            if (m_inFlight == m_slots.size()) {
+                return -1;
+            }
+            return static_cast<int>((m_oldest + m_inFlight) % m_slots.size());
+        }
+
+        GLuint buffer(int slot) const { return m_slots[slot].buffer; }
+        size_t bytes() const { return m_bytes; }
+        unsigned int slots() const { return static_cast<unsigned int>(m_slots.size()); }
+
+        // fences the copy just issued into buffer(slot), slot as returned by acquire()
+        void submit(int slot) {
+            Slot& submitted = m_slots[slot];
+            submitted.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+            submitted.discarded = false;
+            ++m_inFlight;
+        }
+
+        // retires every finished copy and reads the newest of them into out (bytes() long). returns its slot,
+        // or -1 when no copy finished since the last call.
+        int poll(void* out) {
+            int newest = -1;
+            while (m_inFlight > 0) {
+                Slot& slot = m_slots[m_oldest];
+                GLenum status = glClientWaitSync(slot.fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+                if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED) {
+                    break;
+                }
+                glDeleteSync(slot.fence);
+                slot.fence = nullptr;
+                if (!slot.discarded) {
+                    newest = static_cast<int>(m_oldest);
+                }
+                m_oldest = (m_oldest + 1) % m_slots.size();
+                --m_inFlight;
+            }
+            if (newest < 0) {
+                return -1;
+            }
+            glBindBuffer(GL_COPY_READ_BUFFER, m_slots[newest].buffer);
+            void* mapped = glMapBufferRange(GL_COPY_READ_BUFFER, 0, m_bytes, GL_MAP_READ_BIT);
+            if (mapped) {
+                std::memcpy(out, mapped, m_bytes);
+                glUnmapBuffer(GL_COPY_READ_BUFFER);
+            }
+            glBindBuffer(GL_COPY_READ_BUFFER, 0);
+            return mapped ? newest : -1;
+        }
+
+        // the copies still in flight are retired by poll without being read
+        void discard() {
+            for (unsigned int i = 0; i < m_inFlight; ++i) {
+                m_slots[(m_oldest + i) % m_slots.size()].discarded = true;
+            }
+        }
+
+    private:
+        struct Slot {
+            GLuint buffer = 0;
+            GLsync fence = nullptr;
+            bool discarded = false;
+        };
+
+        size_t m_bytes;
+        std::vector<Slot> m_slots;
+        size_t m_oldest = 0;
+        size_t m_inFlight = 0;
+    };
+}
+
+#endif //PROJECT_BASE_READBACK_H
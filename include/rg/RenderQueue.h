@@ -0,0 +1,345 @@
+//
+// Created by matf-rg on 16.10.26..
+//
+
+#ifndef PROJECT_BASE_RENDERQUEUE_H
+#define PROJECT_BASE_RENDERQUEUE_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <learnopengl/mesh.h>
+#include <learnopengl/model.h>
+#include <learnopengl/shader.h>
+#include <rg/CpuProfiler.h>
+#include <rg/FrameStats.h>
+#include <rg/GLState.h>
+#include <rg/GpuProfiler.h>
+#include <rg/MultiDrawIndirect.h>
+#include <rg/TextureRegistry.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+namespace rg {
+
+    // submission order of the layers, and the blend state each one is drawn with
+    enum class RenderLayer : uint64_t {
+        Opaque = 0,      // blending off
+        AlphaTested = 1, // blending off, the shader discards
+        Blended = 2      // blending on, drawn back to front
+    };
+
+    // the layer a model's mesh is drawn in. an alpha tested model's meshes whose material texture has an alpha
+    // channel (the trees' leaves) are blended instead, so their soft edges blend with what is behind them
+    inline RenderLayer meshLayer(const Mesh& mesh, RenderLayer layer) {
+        bool alpha = TextureRegistry::instance().hasAlpha(mesh.MaterialID());
+        return layer == RenderLayer::AlphaTested && alpha ? RenderLayer::Blended : layer;
+    }
+
+    // one draw: a mesh (instanced when instanceCount > 0) at a level of detail, or a callback for geometry that
+    // isn't a Mesh
+    struct DrawItem {
+        Shader* shader = nullptr;
+        Mesh* mesh = nullptr;
+        unsigned int lod = 0;
+        unsigned int instanceCount = 0;
+        unsigned int firstInstance = 0;          // where the instances start in the mesh's instance buffer range
+        const InstanceData* instances = nullptr; // the instanceCount instances, for multi draws
+        void (*draw)(void* context) = nullptr;
+        void* context = nullptr;
+        // sort criteria besides the layer and depth, items that share them are drawn back to back
+        unsigned int material = 0;
+        unsigned int vertexArray = 0;
+        RenderLayer layer = RenderLayer::Opaque;
+        bool cullBackFaces = false;
+        // GPU profiler scope the item is timed under, nullptr for its layer's (see layerName)
+        const char* pass = nullptr;
+    };
+
+    inline const char* layerName(RenderLayer layer) {
+        switch (layer) {
+            case RenderLayer::Opaque: return "opaque";
+            case RenderLayer::AlphaTested: return "alpha tested";
+            default: return "blended";
+        }
+    }
+
+    // Collects the frame's draws, orders them by a packed 64 bit key and submits them.
+    //
+    // key bits, most significant first:
+    //   opaque, alpha tested: layer:2 | program:12 | material:16 | depth:24 | vertex array:10
+    //   blended:              layer:2 | ~depth:24  | program:12  | material:16 | vertex array:10
+    // so solid geometry is grouped by program and material and goes front to back inside a group,
+    // while blended geometry goes strictly back to front.
+    //
+    // With multi draw enabled (and glMultiDrawElementsIndirect available) consecutive instanced meshes that share
+    // shader, state, vertex format and textures go out as one glMultiDrawElementsIndirect: one command per mesh,
+    // their instances copied into one buffer the commands index with baseInstance. Otherwise, or for anything
+    // else, every item is its own draw.
+    //
+    // Buffers are reused between frames, filling and sorting the queue doesn't allocate once warmed up.
+    class RenderQueue {
+    public:
+        RenderQueue() = default;
+        RenderQueue(const RenderQueue&) = delete;
+        RenderQueue& operator=(const RenderQueue&) = delete;
+
+        ~RenderQueue() {
+            if (m_commandBuffer != 0) {
+                glDeleteBuffers(1, &m_commandBuffer);
+                glDeleteBuffers(1, &m_instanceBuffer);
+            }
+        }
+
+        // takes effect where supported, see multiDrawActive
+        void setMultiDraw(bool enabled) { m_multiDraw = enabled; }
+        bool multiDrawActive() const { return m_multiDraw && multiDrawIndirectSupported(); }
+
+        // starts a new frame, depth is measured from the camera and normalized by the far plane
+        void begin(const glm::vec3& cameraPosition, float farPlane) {
+            m_items.clear();
+            m_entries.clear();
+            m_cameraPosition = cameraPosition;
+            m_farPlane = farPlane;
+        }
+
+        void add(const DrawItem& item, const glm::vec3& center) {
+            uint64_t depth = quantizeDepth(glm::length(center - m_cameraPosition));
+            m_entries.push_back(SortEntry{makeKey(item, depth), static_cast<uint32_t>(m_items.size())});
+            m_items.push_back(item);
+        }
+
+        // one item per mesh and level of detail, drawing the instances of it that survived Model::Cull at that level
+        // (or the model once, as one identity instance, if it has none). levels without instances are left out.
+        // layer is the model's, see meshLayer for the meshes that are drawn blended: those get one item per
+        // instance, at the center of that instance's mesh, so the instances go back to front as well.
+        void addModel(Model& model, Shader& shader, RenderLayer layer, bool cullBackFaces = false) {
+            for (unsigned int i = 0; i < model.meshes.size(); ++i) {
+                addMesh(model, i, shader, layer, cullBackFaces);
+            }
+        }
+
+        // addModel for only the meshes of model that are drawn blended
+        void addBlendedMeshes(Model& model, Shader& shader, RenderLayer layer, bool cullBackFaces = false) {
+            for (unsigned int i = 0; i < model.meshes.size(); ++i) {
+                if (meshLayer(model.meshes[i], layer) == RenderLayer::Blended) {
+                    addMesh(model, i, shader, layer, cullBackFaces);
+                }
+            }
+        }
+
+        // LSD radix sort on the keys, one pass per byte. passes where every key has the same byte are skipped,
+        // with a handful of programs and materials most of them are.
+        void sort() {
+            RG_PROFILE_SCOPE("RenderQueue::sort");
+            size_t count = m_entries.size();
+            m_scratch.resize(count);
+            for (unsigned int shift = 0; shift < 64; shift += 8) {
+                size_t offsets[256] = {};
+                for (const SortEntry& entry : m_entries) {
+                    offsets[(entry.key >> shift) & 0xff]++;
+                }
+                if (count == 0 || offsets[(m_entries[0].key >> shift) & 0xff] == count) {
+                    continue;
+                }
+                size_t sum = 0;
+                for (size_t& offset : offsets) {
+                    size_t digitCount = offset;
+                    offset = sum;
+                    sum += digitCount;
+                }
+                for (const SortEntry& entry : m_entries) {
+                    m_scratch[offsets[(entry.key >> shift) & 0xff]++] = entry;
+                }
+                m_entries.swap(m_scratch);
+            }
+        }
+
+        // draws the items in key order, setting blend and cull state per item through GLState. with a profiler
+        // every run of items of one pass is timed as a scope of that name, items that share a pass should share
+        // a layer and program so the sort keeps them together
+        void submit(GpuProfiler* profiler = nullptr) {
+            RG_PROFILE_SCOPE("RenderQueue::submit");
+            bool multiDraw = multiDrawActive();
+            if (multiDraw) {
+                buildMultiDraws();
+            }
+            GLState& state = GLState::instance();
+            state.cullFace(GL_BACK);
+            size_t batch = 0;
+            const char* pass = nullptr;
+            unsigned int passScope = 0;
+            for (size_t e = 0; e < m_entries.size(); ++e) {
+                const DrawItem& item = m_items[m_entries[e].item];
+                if (profiler && passName(item) != pass) {
+                    if (pass) {
+                        profiler->endScope(passScope);
+                    }
+                    pass = passName(item);
+                    passScope = profiler->beginScope(pass);
+                }
+                // every draw or multi draw is its own span in the CPU trace, named after its pass
+                RG_PROFILE_SCOPE(passName(item));
+                state.setCapability(GL_BLEND, item.layer == RenderLayer::Blended);
+                state.setCapability(GL_CULL_FACE, item.cullBackFaces);
+                item.shader->use();
+                if (multiDraw && batch < m_batches.size() && m_batches[batch].firstEntry == e) {
+                    const MultiDrawBatch& run = m_batches[batch++];
+                    item.mesh->BindMultiDraw(*item.shader, m_instanceBuffer);
+                    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, m_commandBuffer);
+                    GeometryArena::instance().multiDraw(item.mesh->Geometry(), run.firstCommand * sizeof(DrawElementsIndirectCommand),
+                                                        run.commandCount);
+                    e += run.commandCount - 1;
+                } else if (item.draw) {
+                    item.draw(item.context);
+                } else if (item.instanceCount > 0) {
+                    item.mesh->DrawInstanced(*item.shader, item.instanceCount, item.lod, item.firstInstance);
+                } else {
+                    item.mesh->Draw(*item.shader);
+                }
+                frameStats().drawCalls++;
+            }
+            if (pass) {
+                profiler->endScope(passScope);
+            }
+            state.disable(GL_CULL_FACE);
+        }
+
+        size_t size() const { return m_items.size(); }
+
+    private:
+        void addMesh(Model& model, unsigned int i, Shader& shader, RenderLayer layer, bool cullBackFaces) {
+            Mesh& mesh = model.meshes[i];
+            DrawItem item;
+            item.shader = &shader;
+            item.mesh = &mesh;
+            item.material = mesh.MaterialID();
+            item.vertexArray = mesh.VAO; // the geometry arena's VAO, one per vertex format
+            item.layer = meshLayer(mesh, layer);
+            item.cullBackFaces = cullBackFaces;
+            if (model.instanceCount == 0) {
+                add(item, model.instanceCenter);
+                return;
+            }
+            for (unsigned int lod = 0; lod < mesh.LodCount(); ++lod) {
+                item.lod = lod;
+                unsigned int count = model.MeshLodInstanceCount(i, lod);
+                unsigned int first = model.MeshLodFirstInstance(i, lod);
+                const InstanceData* instances = model.MeshLodInstances(i, lod);
+                if (count == 0) {
+                    continue;
+                }
+                if (item.layer != RenderLayer::Blended) {
+                    item.instanceCount = count;
+                    item.firstInstance = first;
+                    item.instances = instances;
+                    add(item, model.instanceCenter);
+                    continue;
+                }
+                // an instanced draw blends its instances in buffer order, whatever their depth
+                item.instanceCount = 1;
+                for (unsigned int k = 0; k < count; ++k) {
+                    item.firstInstance = first + k;
+                    item.instances = instances + k;
+                    add(item, glm::vec3(instances[k].Model * glm::vec4(mesh.bounds.center(), 1.0f)));
+                }
+            }
+        }
+
+        struct SortEntry {
+            uint64_t key;
+            uint32_t item;
+        };
+
+        // consecutive entries drawn by one multi draw, with their commands in m_commands
+        struct MultiDrawBatch {
+            size_t firstEntry;
+            size_t firstCommand;
+            size_t commandCount;
+        };
+
+        static constexpr unsigned int kDepthBits = 24;
+        static constexpr uint64_t kDepthMax = (uint64_t(1) << kDepthBits) - 1;
+
+        std::vector<DrawItem> m_items;
+        std::vector<SortEntry> m_entries;
+        std::vector<SortEntry> m_scratch;
+        glm::vec3 m_cameraPosition = glm::vec3(0.0f);
+        float m_farPlane = 1.0f;
+
+        bool m_multiDraw = false;
+        std::vector<MultiDrawBatch> m_batches;
+        std::vector<DrawElementsIndirectCommand> m_commands;
+        std::vector<InstanceData> m_instances;
+        GLuint m_commandBuffer = 0;
+        GLuint m_instanceBuffer = 0;
+
+        static const char* passName(const DrawItem& item) {
+            return item.pass ? item.pass : layerName(item.layer);
+        }
+
+        static bool multiDrawable(const DrawItem& item) {
+            return !item.draw && item.instanceCount > 0 && item.instances;
+        }
+
+        // runs of multi drawable entries that can share a draw, with their commands and instances, uploaded
+        // before any of them is drawn. runs of one entry are batches too, one draw either way.
+        void buildMultiDraws() {
+            RG_PROFILE_SCOPE("RenderQueue::buildMultiDraws");
+            m_batches.clear();
+            m_commands.clear();
+            m_instances.clear();
+            for (size_t e = 0; e < m_entries.size();) {
+                const DrawItem& first = m_items[m_entries[e].item];
+                if (!multiDrawable(first)) {
+                    ++e;
+                    continue;
+                }
+                MultiDrawBatch batch{e, m_commands.size(), 0};
+                for (; e < m_entries.size(); ++e) {
+                    const DrawItem& item = m_items[m_entries[e].item];
+                    if (batch.commandCount > 0
+                        && (!multiDrawable(item) || item.shader != first.shader || item.layer != first.layer || passName(item) != passName(first)
+                            || item.cullBackFaces != first.cullBackFaces || !first.mesh->SharesMultiDraw(*item.mesh))) {
+                        break;
+                    }
+                    m_commands.push_back(item.mesh->IndirectCommand(item.instanceCount, static_cast<unsigned int>(m_instances.size()), item.lod));
+                    item.mesh->AppendMultiDrawInstances(item.instances, item.instanceCount, m_instances);
+                    frameStats().triangles += static_cast<unsigned long long>(m_commands.back().count / 3) * item.instanceCount;
+                    batch.commandCount++;
+                }
+                m_batches.push_back(batch);
+            }
+
+            if (m_commandBuffer == 0) {
+                glGenBuffers(1, &m_commandBuffer);
+                glGenBuffers(1, &m_instanceBuffer);
+            }
+            glBindBuffer(GL_DRAW_INDIRECT_BUFFER, m_commandBuffer);
+            glBufferData(GL_DRAW_INDIRECT_BUFFER, m_commands.size() * sizeof(DrawElementsIndirectCommand), m_commands.data(), GL_STREAM_DRAW);
+            glBindBuffer(GL_ARRAY_BUFFER, m_instanceBuffer);
+            glBufferData(GL_ARRAY_BUFFER, m_instances.size() * sizeof(InstanceData), m_instances.data(), GL_STREAM_DRAW);
+            glBindBuffer(GL_ARRAY_BUFFER, 0);
+        }
+
+        uint64_t quantizeDepth(float distance) const {
+            float normalized = std::min(std::max(distance / m_farPlane, 0.0f), 1.0f);
+            return static_cast<uint64_t>(normalized * kDepthMax);
+        }
+
+        static uint64_t makeKey(const DrawItem& item, uint64_t depth) {
+            uint64_t layer = static_cast<uint64_t>(item.layer);
+            uint64_t program = item.shader->ID & 0xfff;
+            uint64_t material = item.material & 0xffff;
+            uint64_t vertexArray = item.vertexArray & 0x3ff;
+            if (item.layer == RenderLayer::Blended) {
+                return layer << 62 | (kDepthMax - depth) << 38 | program << 26 | material << 10 | vertexArray;
+            }
+            return layer << 62 | program << 50 | material << 34 | depth << 10 | vertexArray;
+        }
+    };
+}
+
+#endif //PROJECT_BASE_RENDERQUEUE_H
@@ -0,0 +1,396 @@
+//
+// Created by matf-rg on 16.10.26..
+//
+
+#ifndef PROJECT_BASE_TEXTUREREGISTRY_H
+#define PROJECT_BASE_TEXTUREREGISTRY_H
+
+#include <glad/glad.h>
+#include <stb_image.h>
+#include <rg/CookedAssets.h>
+#include <rg/CpuProfiler.h>
+#include <rg/GLState.h>
+#include <rg/Hash.h>
+#include <rg/ThreadPool.h>
+
+#include <climits>
+#include <cstdlib>
+#include <fstream>
+#include <future>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// pixels decoded by stb_image, owned until the texture is uploaded
+struct DecodedImage
+{
+    unsigned char *data = nullptr;
+    int width = 0;
+    int height = 0;
+    int components = 0;
+    // set instead of data when the image was read from a cooked file, with its whole mip chain
+    rg::CookedImage cooked;
+
+    bool valid() const { return data || cooked.levels > 0; }
+};
+
+namespace rg {
+
+    // how a 2D texture is sampled outside [0, 1]. part of the registry key, since the same image
+    // uploaded with different parameters is a different GL object.
+    enum class TextureWrap {
+        Repeat,         // model textures
+        ClampIfAlpha    // loadTexture(): RGBA images are clamped so blended edges don't bleed
+    };
+
+    // Process wide owner of every texture loaded from disk. Lookups go through the canonical path first
+    // and then through a hash of the file contents, so the same image is decoded and uploaded only once
+    // no matter how many models or call sites refer to it, or under which path.
+    class TextureRegistry {
+    public:
+        static TextureRegistry& instance() {
+            static TextureRegistry registry;
+            return registry;
+        }
+
+        unsigned int acquire2D(const std::string& path, TextureWrap wrap) {
+            return acquire2D(std::vector<std::string>{path}, wrap)[0];
+        }
+
+        // acquires a batch of 2D textures, reading and decoding the misses concurrently on the worker pool.
+        // every returned id holds one reference that has to be given back with release(). images that can't be
+        // read or decoded get id 0, which samples as black and needs no release.
+        std::vector<unsigned int> acquire2D(const std::vector<std::string>& paths, TextureWrap wrap) {
+            RG_PROFILE_SCOPE("TextureRegistry::acquire2D");
+            std::vector<unsigned int> ids(paths.size(), 0);
+            std::vector<std::string> keys(paths.size());
+            std::vector<size_t> misses;
+            for (size_t i = 0; i < paths.size(); ++i) {
+                keys[i] = canonicalPath(paths[i]) + (wrap == TextureWrap::Repeat ? "#repeat" : "#clamp");
+                auto found = m_byPath.find(keys[i]);
+                if (found != m_byPath.end()) {
+                    ids[i] = addReference(found->second);
+                    ++m_pathHits;
+                } else {
+                    misses.push_back(i);
+                }
+            }
+            if (misses.empty()) {
+                return ids;
+            }
+
+            // read and hash every miss in parallel, then resolve content duplicates here
+            ThreadPool& pool = ThreadPool::shared();
+            std::vector<std::future<FileContents>> reads;
+            for (size_t i : misses) {
+                std::string path = paths[i];
+                reads.push_back(pool.submit([path] { return readFile(path); }));
+            }
+            std::vector<FileContents> contents;
+            for (auto& read : reads) {
+                contents.push_back(read.get());
+            }
+
+            std::vector<std::future<DecodedImage>> decodes(misses.size());
+            std::unordered_map<uint64_t, size_t> decodingByContent;
+            for (size_t m = 0; m < misses.size(); ++m) {
+                size_t i = misses[m];
+                if (!contents[m].ok) {
+                    continue;
+                }
+                uint64_t contentKey = hashBytes(&wrap, sizeof(wrap), contents[m].hash);
+                auto found = m_byContent.find(contentKey);
+                if (found != m_byContent.end()) {
+                    ids[i] = addReference(found->second);
+                    m_byPath[keys[i]] = found->second;
+                    ++m_contentHits;
+                    contents[m].bytes.clear();
+                } else if (decodingByContent.count(contentKey) == 0) {
+                    decodingByContent[contentKey] = m;
+                    std::vector<unsigned char>* bytes = &contents[m].bytes;
+                    std::string path = paths[i];
+                    uint64_t hash = contents[m].hash;
+                    decodes[m] = pool.submit([bytes, path, hash] { return loadImage(path, hash, *bytes); });
+                }
+            }
+
+            // upload on the context thread, in request order
+            for (size_t m = 0; m < misses.size(); ++m) {
+                size_t i = misses[m];
+                if (!contents[m].ok) {
+                    std::cout << "Texture failed to load at path: " << paths[i] << std::endl;
+                    continue;
+                }
+                if (ids[i] != 0) {
+                    continue;
+                }
+                uint64_t contentKey = hashBytes(&wrap, sizeof(wrap), contents[m].hash);
+                size_t owner = decodingByContent[contentKey];
+                if (owner != m) {
+                    // same contents as an earlier miss in this batch, which is uploaded by now unless it failed
+                    auto uploaded = m_byContent.find(contentKey);
+                    if (uploaded == m_byContent.end()) {
+                        std::cout << "Texture failed to load at path: " << paths[i] << std::endl;
+                        continue;
+                    }
+                    ids[i] = addReference(uploaded->second);
+                    m_byPath[keys[i]] = ids[i];
+                    ++m_contentHits;
+                    continue;
+                }
+                DecodedImage image = decodes[m].get();
+                if (!image.valid()) {
+                    std::cout << "Texture failed to load at path: " << paths[i] << std::endl;
+                    continue;
+                }
+                m_cookedLoads += image.cooked.levels > 0;
+                Entry entry;
+                entry.decodedBytes = size_t(image.width) * image.height * image.components;
+                // a full mip chain adds a third on top of the base level
+                entry.vramBytes = entry.decodedBytes * 4 / 3;
+                entry.alpha = image.components == 4;
+                entry.id = uploadTexture2D(std::move(image), wrap);
+                entry.references = 1;
+                m_entries[entry.id] = entry;
+                m_byPath[keys[i]] = entry.id;
+                m_byContent[contentKey] = entry.id;
+                ids[i] = entry.id;
+                m_decodedBytes += entry.decodedBytes;
+                m_vramBytes += entry.vramBytes;
+            }
+            return ids;
+        }
+
+        // faces in the +X, -X, +Y, -Y, +Z, -Z order GL expects
+        unsigned int acquireCubemap(const std::vector<std::string>& faces) {
+            std::string key;
+            for (const std::string& face : faces) {
+                key += canonicalPath(face) + '|';
+            }
+            auto found = m_byPath.find(key);
+            if (found != m_byPath.end()) {
+                ++m_pathHits;
+                return addReference(found->second);
+            }
+
+            ThreadPool& pool = ThreadPool::shared();
+            std::vector<std::future<FileContents>> reads;
+            for (const std::string& face : faces) {
+                reads.push_back(pool.submit([face] { return readFile(face); }));
+            }
+            std::vector<FileContents> contents;
+            uint64_t contentKey = hashString("cubemap");
+            for (auto& read : reads) {
+                contents.push_back(read.get());
+                contentKey = hashBytes(&contents.back().hash, sizeof(uint64_t), contentKey);
+            }
+            auto byContent = m_byContent.find(contentKey);
+            if (byContent != m_byContent.end()) {
+                ++m_contentHits;
+                m_byPath[key] = byContent->second;
+                return addReference(byContent->second);
+            }
+
+            std::vector<std::future<DecodedImage>> decodes;
+            for (size_t i = 0; i < faces.size(); i++) {
+                std::vector<unsigned char>* bytes = &contents[i].bytes;
+                std::string path = faces[i];
+                uint64_t hash = contents[i].hash;
+                decodes.push_back(pool.submit([bytes, path, hash] { return loadImage(path, hash, *bytes); }));
+            }
+
+            Entry entry;
+            glGenTextures(1, &entry.id);
+            GLState::instance().bindTexture(0, GL_TEXTURE_CUBE_MAP, entry.id);
+            for (unsigned int i = 0; i < faces.size(); i++) {
+                DecodedImage image = decodes[i].get();
+                if (image.valid()) {
+                    // faces are sampled without mips, a cooked face only contributes its first level
+                    m_cookedLoads += image.cooked.levels > 0;
+                    const unsigned char* pixels = image.data ? image.data : image.cooked.pixels.data();
+                    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+                    glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_RGB, image.width, image.height, 0, GL_RGB, GL_UNSIGNED_BYTE, pixels);
+                    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+                    entry.decodedBytes += size_t(image.width) * image.height * image.components;
+                    entry.vramBytes += size_t(image.width) * image.height * 3;
+                    if (image.data) {
+                        stbi_image_free(image.data);
+                    }
+                } else {
+                    std::cout << "Cubemap texture failed to load at path: " << faces[i] << std::endl;
+                }
+            }
+            glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+            glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+            glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+            glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+            glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+
+            entry.references = 1;
+            m_entries[entry.id] = entry;
+            m_byPath[key] = entry.id;
+            m_byContent[contentKey] = entry.id;
+            m_decodedBytes += entry.decodedBytes;
+            m_vramBytes += entry.vramBytes;
+            return entry.id;
+        }
+
+        // drops one reference, the texture is deleted together with its last one
+        void release(unsigned int id) {
+            auto found = m_entries.find(id);
+            if (found == m_entries.end() || --found->second.references > 0) {
+                return;
+            }
+            for (auto it = m_byPath.begin(); it != m_byPath.end();) {
+                it = it->second == id ? m_byPath.erase(it) : std::next(it);
+            }
+            for (auto it = m_byContent.begin(); it != m_byContent.end();) {
+                it = it->second == id ? m_byContent.erase(it) : std::next(it);
+            }
+            m_decodedBytes -= found->second.decodedBytes;
+            m_vramBytes -= found->second.vramBytes;
+            m_entries.erase(found);
+            GLState::instance().forgetTexture(id);
+            glDeleteTextures(1, &id);
+        }
+
+        // whether a 2D texture was uploaded with an alpha channel
+        bool hasAlpha(unsigned int id) const {
+            auto found = m_entries.find(id);
+            return found != m_entries.end() && found->second.alpha;
+        }
+
+        void report(std::ostream& out) const {
+            out << "TEXTURES:: " << m_entries.size() << " unique, " << m_decodedBytes / 1024 << " KB decoded, "
+                << m_vramBytes / 1024 << " KB VRAM; " << m_pathHits << " path hits, " << m_contentHits
+                << " content hits saved " << m_decodeBytesSaved / 1024 << " KB of decoding and "
+                << m_vramBytesSaved / 1024 << " KB of VRAM; " << m_cookedLoads << " read cooked" << std::endl;
+        }
+
+    private:
+        struct Entry {
+            unsigned int id = 0;
+            unsigned int references = 0;
+            size_t decodedBytes = 0;
+            size_t vramBytes = 0;
+            bool alpha = false;
+        };
+
+        struct FileContents {
+            bool ok = false;
+            uint64_t hash = kFnvOffsetBasis;
+            std::vector<unsigned char> bytes;
+        };
+
+        std::unordered_map<unsigned int, Entry> m_entries;
+        std::unordered_map<std::string, unsigned int> m_byPath;
+        std::unordered_map<uint64_t, unsigned int> m_byContent;
+        size_t m_pathHits = 0;
+        size_t m_contentHits = 0;
+        size_t m_decodedBytes = 0;
+        size_t m_vramBytes = 0;
+        size_t m_decodeBytesSaved = 0;
+        size_t m_vramBytesSaved = 0;
+        size_t m_cookedLoads = 0;
+
+        TextureRegistry() = default;
+
+        unsigned int addReference(unsigned int id) {
+            Entry& entry = m_entries[id];
+            ++entry.references;
+            m_decodeBytesSaved += entry.decodedBytes;
+            m_vramBytesSaved += entry.vramBytes;
+            return id;
+        }
+
+        static std::string canonicalPath(const std::string& path) {
+            char resolved[PATH_MAX];
+            return realpath(path.c_str(), resolved) ? std::string(resolved) : path;
+        }
+
+        static FileContents readFile(const std::string& path) {
+            FileContents contents;
+            std::ifstream in(path, std::ios::binary);
+            if (in) {
+                contents.bytes.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+                contents.hash = hashBytes(contents.bytes.data(), contents.bytes.size());
+                contents.ok = !contents.bytes.empty();
+            }
+            return contents;
+        }
+
+        // the cooked mip chain of the image if project_base_cook made one from these exact bytes, otherwise
+        // the decoded source. touches no GL state, so it is safe to call from worker threads
+        static DecodedImage loadImage(const std::string& path, uint64_t contentHash, const std::vector<unsigned char>& bytes) {
+            std::string cookedPath = cookedTexturePath(path);
+            DecodedImage image;
+            if (!cookedPath.empty() && image.cooked.read(cookedPath, cookedSourceHash(contentHash))) {
+                image.width = static_cast<int>(image.cooked.width);
+                image.height = static_cast<int>(image.cooked.height);
+                image.components = static_cast<int>(image.cooked.components);
+                return image;
+            }
+            return decodeImage(bytes);
+        }
+
+        static DecodedImage decodeImage(const std::vector<unsigned char>& bytes) {
+            RG_PROFILE_SCOPE("TextureRegistry::decodeImage");
+            DecodedImage image;
+            if (!bytes.empty()) {
+                image.data = stbi_load_from_memory(bytes.data(), static_cast<int>(bytes.size()),
+                                                   &image.width, &image.height, &image.components, 0);
+            }
+            return image;
+        }
+
+        // creates a mipmapped 2D texture from a decoded image and frees the pixels, 0 for an invalid image.
+        // context thread only.
+        static unsigned int uploadTexture2D(DecodedImage image, TextureWrap wrap) {
+            if (!image.valid()) {
+                return 0;
+            }
+            unsigned int textureID;
+            glGenTextures(1, &textureID);
+
+            GLenum format = GL_RGB;
+            if (image.components == 1)
+                format = GL_RED;
+            else if (image.components == 3)
+                format = GL_RGB;
+            else if (image.components == 4)
+                format = GL_RGBA;
+
+            GLState::instance().bindTexture(0, GL_TEXTURE_2D, textureID);
+            if (image.cooked.levels > 0) {
+                // every level is precomputed, rows are tightly packed
+                const CookedImage& cooked = image.cooked;
+                glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+                for (uint32_t level = 0; level < cooked.levels; ++level) {
+                    glTexImage2D(GL_TEXTURE_2D, level, format, CookedImage::levelWidth(cooked.width, level),
+                                 CookedImage::levelWidth(cooked.height, level), 0, format, GL_UNSIGNED_BYTE,
+                                 cooked.pixels.data() + cooked.levelOffset(level));
+                }
+                glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, cooked.levels - 1);
+            } else {
+                glTexImage2D(GL_TEXTURE_2D, 0, format, image.width, image.height, 0, format, GL_UNSIGNED_BYTE, image.data);
+                glGenerateMipmap(GL_TEXTURE_2D);
+            }
+
+            GLint wrapMode = wrap == TextureWrap::ClampIfAlpha && format == GL_RGBA ? GL_CLAMP_TO_EDGE : GL_REPEAT;
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, wrapMode);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, wrapMode);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+            if (image.data) {
+                stbi_image_free(image.data);
+            }
+            return textureID;
+        }
+    };
+}
+
+#endif //PROJECT_BASE_TEXTUREREGISTRY_H
@@ -0,0 +1,95 @@
+//
+// Created by matf-rg on 16.10.26..
+//
+
+#ifndef PROJECT_BASE_THREADPOOL_H
+#define PROJECT_BASE_THREADPOOL_H
+
+#include <rg/CpuProfiler.h>
+
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+namespace rg {
+
+    // fixed size pool of worker threads fed from a single FIFO queue.
+    // jobs must not touch OpenGL, the context only lives on the main thread.
+    class ThreadPool {
+    public:
+        explicit ThreadPool(unsigned int threadCount = std::thread::hardware_concurrency()) {
+            if (threadCount == 0) {
+                threadCount = 1;
+            }
+            for (unsigned int i = 0; i < threadCount; ++i) {
+                m_workers.emplace_back([this] { workerLoop(); });
+            }
+        }
+
+        ThreadPool(const ThreadPool&) = delete;
+        ThreadPool& operator=(const ThreadPool&) = delete;
+
+        ~ThreadPool() {
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_stopping = true;
+            }
+            m_wakeUp.notify_all();
+            for (std::thread& worker : m_workers) {
+                worker.join();
+            }
+        }
+
+        template<typename F>
+        auto submit(F&& job) -> std::future<decltype(job())> {
+            using Result = decltype(job());
+            auto task = std::make_shared<std::packaged_task<Result()>>(std::forward<F>(job));
+            std::future<Result> result = task->get_future();
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_jobs.emplace([task] { (*task)(); });
+            }
+            m_wakeUp.notify_one();
+            return result;
+        }
+
+        unsigned int size() const { return static_cast<unsigned int>(m_workers.size()); }
+
+        // pool shared by the whole process, sized to the number of cores
+        static ThreadPool& shared() {
+            static ThreadPool pool;
+            return pool;
+        }
+
+    private:
+        std::vector<std::thread> m_workers;
+        std::queue<std::function<void()>> m_jobs;
+        std::mutex m_mutex;
+        std::condition_variable m_wakeUp;
+        bool m_stopping = false;
+
+        void workerLoop() {
+            RG_PROFILE_THREAD("worker");
+            for (;;) {
+                std::function<void()> job;
+                {
+                    std::unique_lock<std::mutex> lock(m_mutex);
+                    m_wakeUp.wait(lock, [this] { return m_stopping || !m_jobs.empty(); });
+                    if (m_stopping && m_jobs.empty()) {
+                        return;
+                    }
+                    job = std::move(m_jobs.front());
+                    m_jobs.pop();
+                }
+                job();
+            }
+        }
+    };
+}
+
+#endif //PROJECT_BASE_THREADPOOL_H
@@ -0,0 +1,154 @@
+//
+// Created by matf-rg on 16.10.26..
+//
+
+#ifndef PROJECT_BASE_UNIFORMBLOCKS_H
+#define PROJECT_BASE_UNIFORMBLOCKS_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <cstring>
+
+namespace rg {
+
+    // Fixed binding points of the uniform blocks shared by all shaders. Shader binds any block with one of
+    // these names right after linking, so a buffer bound here once per frame feeds every program.
+    enum UniformBlockBinding : GLuint {
+        FrameDataBinding = 0,
+        LightDataBinding = 1
+    };
+
+    inline GLint uniformBlockBinding(const char* blockName) {
+        if (std::strcmp(blockName, "FrameData") == 0)
+            return FrameDataBinding;
+        if (std::strcmp(blockName, "LightData") == 0)
+            return LightDataBinding;
+        return -1;
+    }
+
+    // C++ mirrors of the std140 blocks declared in resources/shaders. Every vec3 is followed by a scalar
+    // (or padding) so it fills a whole 16 byte slot, exactly like the GLSL side packs it.
+    //
+    // layout (std140) uniform FrameData {
+    //     mat4 projection;
+    //     mat4 view;
+    //     vec4 viewPos;
+    // };
+    struct FrameData {
+        glm::mat4 projection;
+        glm::mat4 view;
+        glm::vec4 viewPos;
+    };
+
+    // struct PointLight {
+    //     vec3 position; float constant;
+    //     vec3 ambient; float linear;
+    //     vec3 diffuse; float quadratic;
+    //     vec3 specular;
+    // };
+    struct PointLight {
+        glm::vec3 position;
+        float constant;
+        glm::vec3 ambient;
+        float linear;
+        glm::vec3 diffuse;
+        float quadratic;
+        glm::vec3 specular;
+        float padding;
+    };
+
+    // struct SpotLight {
+    //     vec3 position; float cutOff;
+    //     vec3 direction; float outerCutOff;
+    //     vec3 ambient; float constant;
+    //     vec3 diffuse; float linear;
+    //     vec3 specular; float quadratic;
+    // };
+    struct SpotLight {
+        glm::vec3 position;
+        float cutOff;
+        glm::vec3 direction;
+        float outerCutOff;
+        glm::vec3 ambient;
+        float constant;
+        glm::vec3 diffuse;
+        float linear;
+        glm::vec3 specular;
+        float quadratic;
+    };
+
+    // layout (std140) uniform LightData {
+    //     PointLight pointLight;
+    //     SpotLight spotLight;
+    // };
+    struct LightData {
+        PointLight pointLight;
+        SpotLight spotLight;
+    };
+
+    static_assert(sizeof(glm::vec3) == 12 && sizeof(glm::vec4) == 16 && sizeof(glm::mat4) == 64, "unexpected glm type sizes");
+
+    static_assert(offsetof(FrameData, projection) == 0, "std140: FrameData.projection");
+    static_assert(offsetof(FrameData, view) == 64, "std140: FrameData.view");
+    static_assert(offsetof(FrameData, viewPos) == 128, "std140: FrameData.viewPos");
+    static_assert(sizeof(FrameData) == 144, "std140: FrameData size");
+
+    static_assert(offsetof(PointLight, position) == 0, "std140: PointLight.position");
+    static_assert(offsetof(PointLight, constant) == 12, "std140: PointLight.constant");
+    static_assert(offsetof(PointLight, ambient) == 16, "std140: PointLight.ambient");
+    static_assert(offsetof(PointLight, linear) == 28, "std140: PointLight.linear");
+    static_assert(offsetof(PointLight, diffuse) == 32, "std140: PointLight.diffuse");
+    static_assert(offsetof(PointLight, quadratic) == 44, "std140: PointLight.quadratic");
+    static_assert(offsetof(PointLight, specular) == 48, "std140: PointLight.specular");
+    static_assert(sizeof(PointLight) == 64, "std140: PointLight size (structs round up to 16)");
+
+    static_assert(offsetof(SpotLight, position) == 0, "std140: SpotLight.position");
+    static_assert(offsetof(SpotLight, cutOff) == 12, "std140: SpotLight.cutOff");
+    static_assert(offsetof(SpotLight, direction) == 16, "std140: SpotLight.direction");
+    static_assert(offsetof(SpotLight, outerCutOff) == 28, "std140: SpotLight.outerCutOff");
+    static_assert(offsetof(SpotLight, ambient) == 32, "std140: SpotLight.ambient");
+    static_assert(offsetof(SpotLight, constant) == 44, "std140: SpotLight.constant");
+    static_assert(offsetof(SpotLight, diffuse) == 48, "std140: SpotLight.diffuse");
+    static_assert(offsetof(SpotLight, linear) == 60, "std140: SpotLight.linear");
+    static_assert(offsetof(SpotLight, specular) == 64, "std140: SpotLight.specular");
+    static_assert(offsetof(SpotLight, quadratic) == 76, "std140: SpotLight.quadratic");
+    static_assert(sizeof(SpotLight) == 80, "std140: SpotLight size");
+
+    static_assert(offsetof(LightData, pointLight) == 0, "std140: LightData.pointLight");
+    static_assert(offsetof(LightData, spotLight) == 64, "std140: LightData.spotLight");
+    static_assert(sizeof(LightData) == 144, "std140: LightData size");
+
+    // a uniform buffer holding one T, attached to a fixed binding point
+    template<typename T>
+    class UniformBuffer {
+    public:
+        explicit UniformBuffer(GLuint binding) : m_binding(binding) {
+            glGenBuffers(1, &m_id);
+            glBindBuffer(GL_UNIFORM_BUFFER, m_id);
+            glBufferData(GL_UNIFORM_BUFFER, sizeof(T), nullptr, GL_DYNAMIC_DRAW);
+            glBindBuffer(GL_UNIFORM_BUFFER, 0);
+        }
+
+        UniformBuffer(const UniformBuffer&) = delete;
+        UniformBuffer& operator=(const UniformBuffer&) = delete;
+
+        ~UniformBuffer() {
+            glDeleteBuffers(1, &m_id);
+        }
+
+        // uploads the data and binds the buffer to its binding point, once per frame
+        void update(const T& data) {
+            glBindBuffer(GL_UNIFORM_BUFFER, m_id);
+            glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(T), &data);
+            glBindBufferBase(GL_UNIFORM_BUFFER, m_binding, m_id);
+        }
+
+    private:
+        GLuint m_id = 0;
+        GLuint m_binding;
+    };
+}
+
+#endif //PROJECT_BASE_UNIFORMBLOCKS_H
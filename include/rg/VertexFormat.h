@@ -0,0 +1,421 @@
+//
+// Created by matf-rg on 16.10.26..
+//
+
+#ifndef PROJECT_BASE_VERTEXFORMAT_H
+#define PROJECT_BASE_VERTEXFORMAT_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <rg/Bounds.h>
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+#include <vector>
+
+namespace rg {
+
+    // Vertex buffer layouts, described at compile time. A format is a type with
+    //   Stored         the struct one vertex is stored as, its size is the stride
+    //   id()           the VertexFormat it implements, for picking formats at runtime
+    //   attributes()   constexpr std::array<VertexAttribute, N>: what each attribute holds, how it is encoded,
+    //                  its shader location and offset into Stored
+    // VAO setup (setupVertexAttributes), conversion from the float Vertex (convertVertices) and the shader
+    // decode uniforms (vertexDecode) are all generated from attributes(), so a format stores exactly the
+    // attributes it lists. validVertexFormat checks the table when a format is used.
+    //
+    //   FloatFormat          56 bytes: float position, normal, uv, tangent, bitangent (locations 0-4)
+    //   PackedFormat         16 bytes: unorm16 position relative to the mesh bounds, octahedral snorm16 normal,
+    //                        half float uv (locations 0-2), no tangent frame
+    //   PackedTangentFormat  24 bytes: PackedFormat plus the tangent frame as a snorm16 quaternion (location 3),
+    //                        the sign of w holding the bitangent's handedness
+    // Shaders decode positions as positionOffset + aPos * positionScale and, if packedNormals is set, the normal
+    // with octDecode(aNormal.xy) (see advanced.vs).
+    enum class VertexFormat {
+        Float,
+        Packed,
+        PackedTangent
+    };
+
+    inline const char* vertexFormatName(VertexFormat format) {
+        switch (format) {
+            case VertexFormat::Float: return "float";
+            case VertexFormat::Packed: return "packed";
+            case VertexFormat::PackedTangent: return "packed-tangent";
+        }
+        return "unknown";
+    }
+
+    inline bool parseVertexFormat(const char* name, VertexFormat& format) {
+        for (VertexFormat candidate : {VertexFormat::Float, VertexFormat::Packed, VertexFormat::PackedTangent}) {
+            if (std::strcmp(name, vertexFormatName(candidate)) == 0) {
+                format = candidate;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // what an attribute carries, read from the matching Vertex member(s)
+    enum class AttributeSemantic {
+        Position,
+        Normal,
+        TexCoords,
+        Tangent,
+        Bitangent,
+        TangentFrame // Normal, Tangent and Bitangent as one rotation
+    };
+
+    enum class AttributeEncoding {
+        Float,             // 32 bit floats
+        Half,              // 16 bit floats
+        BoundsUnorm16,     // position relative to the mesh bounds, 3 unsigned normalized shorts
+        OctahedralSnorm16, // unit vector folded onto the octahedron, 2 signed normalized shorts
+        QuaternionSnorm16  // tangent frame rotation, 4 signed normalized shorts
+    };
+
+    struct VertexAttribute {
+        AttributeSemantic semantic;
+        AttributeEncoding encoding;
+        GLuint location;
+        size_t offset; // into the format's Stored
+    };
+
+    constexpr GLint semanticComponents(AttributeSemantic semantic) {
+        return semantic == AttributeSemantic::TexCoords ? 2 : semantic == AttributeSemantic::TangentFrame ? 4 : 3;
+    }
+
+    constexpr GLint attributeComponents(const VertexAttribute& attribute) {
+        return attribute.encoding == AttributeEncoding::BoundsUnorm16 ? 3
+             : attribute.encoding == AttributeEncoding::OctahedralSnorm16 ? 2
+             : attribute.encoding == AttributeEncoding::QuaternionSnorm16 ? 4
+             : semanticComponents(attribute.semantic);
+    }
+
+    constexpr GLenum attributeType(const VertexAttribute& attribute) {
+        return attribute.encoding == AttributeEncoding::Float ? GL_FLOAT
+             : attribute.encoding == AttributeEncoding::Half ? GL_HALF_FLOAT
+             : attribute.encoding == AttributeEncoding::BoundsUnorm16 ? GL_UNSIGNED_SHORT
+             : GL_SHORT;
+    }
+
+    // integer encodings reach the shader as floats in [0, 1] or [-1, 1]
+    constexpr GLboolean attributeNormalized(const VertexAttribute& attribute) {
+        return attribute.encoding == AttributeEncoding::Float || attribute.encoding == AttributeEncoding::Half ? GL_FALSE : GL_TRUE;
+    }
+
+    constexpr size_t attributeSize(const VertexAttribute& attribute) {
+        return size_t(attributeComponents(attribute)) * (attribute.encoding == AttributeEncoding::Float ? 4 : 2);
+    }
+
+    constexpr bool encodingSupported(AttributeSemantic semantic, AttributeEncoding encoding) {
+        return semantic == AttributeSemantic::TangentFrame ? encoding == AttributeEncoding::QuaternionSnorm16
+             : semantic == AttributeSemantic::Position ? encoding == AttributeEncoding::Float || encoding == AttributeEncoding::BoundsUnorm16
+             : semantic == AttributeSemantic::Normal ? encoding != AttributeEncoding::BoundsUnorm16 && encoding != AttributeEncoding::QuaternionSnorm16
+             : encoding == AttributeEncoding::Float || encoding == AttributeEncoding::Half;
+    }
+
+    // every attribute supported, inside Stored, 4 byte aligned and on its own location
+    template<typename Format>
+    constexpr bool validVertexFormat() {
+        constexpr auto attributes = Format::attributes();
+        for (size_t i = 0; i < attributes.size(); ++i) {
+            if (!encodingSupported(attributes[i].semantic, attributes[i].encoding)
+                || attributes[i].offset % 4 != 0
+                || attributes[i].offset + attributeSize(attributes[i]) > sizeof(typename Format::Stored)) {
+                return false;
+            }
+            for (size_t j = 0; j < i; ++j) {
+                if (attributes[j].location == attributes[i].location) {
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+
+    template<typename Format>
+    constexpr bool hasAttribute(AttributeSemantic semantic, AttributeEncoding encoding) {
+        constexpr auto attributes = Format::attributes();
+        for (size_t i = 0; i < attributes.size(); ++i) {
+            if (attributes[i].semantic == semantic && attributes[i].encoding == encoding) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // the Vertex layout itself, uploaded without conversion. VertexT needs Position, Normal, TexCoords, Tangent
+    // and Bitangent members.
+    template<typename VertexT>
+    struct FloatFormat {
+        using Stored = VertexT;
+        static constexpr VertexFormat id() { return VertexFormat::Float; }
+        static constexpr std::array<VertexAttribute, 5> attributes() {
+            return {{
+                {AttributeSemantic::Position, AttributeEncoding::Float, 0, offsetof(VertexT, Position)},
+                {AttributeSemantic::Normal, AttributeEncoding::Float, 1, offsetof(VertexT, Normal)},
+                {AttributeSemantic::TexCoords, AttributeEncoding::Float, 2, offsetof(VertexT, TexCoords)},
+                {AttributeSemantic::Tangent, AttributeEncoding::Float, 3, offsetof(VertexT, Tangent)},
+                {AttributeSemantic::Bitangent, AttributeEncoding::Float, 4, offsetof(VertexT, Bitangent)}
+            }};
+        }
+    };
+
+    struct PackedVertex {
+        uint16_t position[4]; // xyz, w is padding to keep the normal 4 byte aligned
+        int16_t normal[2];
+        uint16_t texCoords[2];
+    };
+
+    struct PackedFormat {
+        using Stored = PackedVertex;
+        static constexpr VertexFormat id() { return VertexFormat::Packed; }
+        static constexpr std::array<VertexAttribute, 3> attributes() {
+            return {{
+                {AttributeSemantic::Position, AttributeEncoding::BoundsUnorm16, 0, offsetof(PackedVertex, position)},
+                {AttributeSemantic::Normal, AttributeEncoding::OctahedralSnorm16, 1, offsetof(PackedVertex, normal)},
+                {AttributeSemantic::TexCoords, AttributeEncoding::Half, 2, offsetof(PackedVertex, texCoords)}
+            }};
+        }
+    };
+
+    struct PackedTangentVertex {
+        uint16_t position[4];
+        int16_t normal[2];
+        uint16_t texCoords[2];
+        int16_t tangentFrame[4];
+    };
+
+    struct PackedTangentFormat {
+        using Stored = PackedTangentVertex;
+        static constexpr VertexFormat id() { return VertexFormat::PackedTangent; }
+        static constexpr std::array<VertexAttribute, 4> attributes() {
+            return {{
+                {AttributeSemantic::Position, AttributeEncoding::BoundsUnorm16, 0, offsetof(PackedTangentVertex, position)},
+                {AttributeSemantic::Normal, AttributeEncoding::OctahedralSnorm16, 1, offsetof(PackedTangentVertex, normal)},
+                {AttributeSemantic::TexCoords, AttributeEncoding::Half, 2, offsetof(PackedTangentVertex, texCoords)},
+                {AttributeSemantic::TangentFrame, AttributeEncoding::QuaternionSnorm16, 3, offsetof(PackedTangentVertex, tangentFrame)}
+            }};
+        }
+    };
+
+    // calls visitor with a value of the format type the runtime choice stands for
+    template<typename VertexT, typename Visitor>
+    void visitVertexFormat(VertexFormat format, Visitor&& visitor) {
+        switch (format) {
+            case VertexFormat::Float: visitor(FloatFormat<VertexT>()); return;
+            case VertexFormat::Packed: visitor(PackedFormat()); return;
+            case VertexFormat::PackedTangent: visitor(PackedTangentFormat()); return;
+        }
+    }
+
+    // uniform values that turn the stored attributes back into object space
+    struct VertexDecode {
+        glm::vec3 positionOffset = glm::vec3(0.0f);
+        glm::vec3 positionScale = glm::vec3(1.0f);
+        bool packedNormals = false;
+    };
+
+    template<typename Format>
+    VertexDecode vertexDecode(const AABB& bounds) {
+        VertexDecode decode;
+        if (hasAttribute<Format>(AttributeSemantic::Position, AttributeEncoding::BoundsUnorm16) && !bounds.empty()) {
+            decode.positionOffset = bounds.min;
+            decode.positionScale = bounds.max - bounds.min;
+        }
+        decode.packedNormals = hasAttribute<Format>(AttributeSemantic::Normal, AttributeEncoding::OctahedralSnorm16);
+        return decode;
+    }
+
+    namespace detail {
+        inline uint16_t packUnorm16(float value) {
+            return static_cast<uint16_t>(std::lround(std::min(std::max(value, 0.0f), 1.0f) * 65535.0f));
+        }
+
+        inline int16_t packSnorm16(float value) {
+            return static_cast<int16_t>(std::lround(std::min(std::max(value, -1.0f), 1.0f) * 32767.0f));
+        }
+
+        // IEEE half float, rounding to nearest. out of range values become infinity, tiny ones denormals or 0
+        inline uint16_t packHalf(float value) {
+            uint32_t bits;
+            std::memcpy(&bits, &value, sizeof(bits));
+            uint32_t sign = (bits >> 16) & 0x8000u;
+            uint32_t exponent = (bits >> 23) & 0xffu;
+            uint32_t mantissa = bits & 0x7fffffu;
+            if (exponent == 0xffu) {
+                return static_cast<uint16_t>(sign | 0x7c00u | (mantissa ? 0x200u : 0u));
+            }
+            int halfExponent = static_cast<int>(exponent) - 127 + 15;
+            if (halfExponent >= 31) {
+                return static_cast<uint16_t>(sign | 0x7c00u);
+            }
+            if (halfExponent <= 0) {
+                if (halfExponent < -10) {
+                    return static_cast<uint16_t>(sign);
+                }
+                mantissa |= 0x800000u;
+                uint32_t shift = static_cast<uint32_t>(14 - halfExponent);
+                uint32_t half = mantissa >> shift;
+                if ((mantissa >> (shift - 1)) & 1u) {
+                    half++;
+                }
+                return static_cast<uint16_t>(sign | half);
+            }
+            uint32_t half = sign | (static_cast<uint32_t>(halfExponent) << 10) | (mantissa >> 13);
+            // a carry out of the mantissa correctly bumps the exponent
+            if (mantissa & 0x1000u) {
+                half++;
+            }
+            return static_cast<uint16_t>(half);
+        }
+
+        // unit vector to the octahedron folded onto [-1, 1]^2 (Cigolle et al. 2014)
+        inline glm::vec2 octEncode(glm::vec3 n) {
+            n /= std::abs(n.x) + std::abs(n.y) + std::abs(n.z);
+            if (n.z < 0.0f) {
+                float x = n.x, y = n.y;
+                n.x = (1.0f - std::abs(y)) * (x >= 0.0f ? 1.0f : -1.0f);
+                n.y = (1.0f - std::abs(x)) * (y >= 0.0f ? 1.0f : -1.0f);
+            }
+            return glm::vec2(n.x, n.y);
+        }
+
+        // rotation taking the axes to (tangent, bitangent, normal), w >= 0 unless the frame is mirrored.
+        // w is kept away from 0 so its sign survives snorm quantization.
+        inline glm::vec4 tangentFrameQuaternion(glm::vec3 normal, glm::vec3 tangent, glm::vec3 bitangent) {
+            float normalLength = glm::length(normal);
+            normal = normalLength > 0.0f ? normal / normalLength : glm::vec3(0.0f, 0.0f, 1.0f);
+            // Gram-Schmidt, falling back to any perpendicular axis for meshes without uvs
+            tangent = tangent - normal * glm::dot(normal, tangent);
+            if (glm::length(tangent) < 1e-6f) {
+                tangent = std::abs(normal.x) < 0.9f ? glm::vec3(1.0f, 0.0f, 0.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+                tangent = tangent - normal * glm::dot(normal, tangent);
+            }
+            tangent = glm::normalize(tangent);
+            glm::vec3 orthogonal = glm::cross(normal, tangent);
+            bool mirrored = glm::dot(orthogonal, bitangent) < 0.0f;
+
+            // rotation matrix with columns tangent, orthogonal, normal to a quaternion (Shepperd's method)
+            float m00 = tangent.x, m11 = orthogonal.y, m22 = normal.z;
+            float trace = m00 + m11 + m22;
+            glm::vec4 q;
+            if (trace > 0.0f) {
+                float s = std::sqrt(trace + 1.0f) * 2.0f;
+                q = glm::vec4((orthogonal.z - normal.y) / s, (normal.x - tangent.z) / s, (tangent.y - orthogonal.x) / s, 0.25f * s);
+            } else if (m00 > m11 && m00 > m22) {
+                float s = std::sqrt(1.0f + m00 - m11 - m22) * 2.0f;
+                q = glm::vec4(0.25f * s, (orthogonal.x + tangent.y) / s, (normal.x + tangent.z) / s, (orthogonal.z - normal.y) / s);
+            } else if (m11 > m22) {
+                float s = std::sqrt(1.0f + m11 - m00 - m22) * 2.0f;
+                q = glm::vec4((orthogonal.x + tangent.y) / s, 0.25f * s, (normal.y + orthogonal.z) / s, (normal.x - tangent.z) / s);
+            } else {
+                float s = std::sqrt(1.0f + m22 - m00 - m11) * 2.0f;
+                q = glm::vec4((normal.x + tangent.z) / s, (normal.y + orthogonal.z) / s, 0.25f * s, (tangent.y - orthogonal.x) / s);
+            }
+            q = q / glm::length(q);
+            if (q.w < 0.0f) {
+                q = -q;
+            }
+            const float minimumW = 1.0f / 32767.0f;
+            if (q.w < minimumW) {
+                float scale = std::sqrt(1.0f - minimumW * minimumW) / glm::length(glm::vec3(q));
+                q = glm::vec4(q.x * scale, q.y * scale, q.z * scale, minimumW);
+            }
+            return mirrored ? -q : q;
+        }
+
+        template<typename T>
+        void store(unsigned char* out, const T* values, size_t count) {
+            std::memcpy(out, values, count * sizeof(T));
+        }
+
+        template<typename VertexT>
+        glm::vec3 semanticVector(const VertexT& vertex, AttributeSemantic semantic) {
+            switch (semantic) {
+                case AttributeSemantic::Position: return vertex.Position;
+                case AttributeSemantic::Normal: return vertex.Normal;
+                case AttributeSemantic::Tangent: return vertex.Tangent;
+                case AttributeSemantic::Bitangent: return vertex.Bitangent;
+                default: return glm::vec3(vertex.TexCoords.x, vertex.TexCoords.y, 0.0f);
+            }
+        }
+
+        // writes one attribute of vertex to out, in the attribute's encoding
+        template<typename VertexT>
+        void encodeAttribute(const VertexAttribute& attribute, const VertexT& vertex, const AABB& bounds, unsigned char* out) {
+            glm::vec3 value = semanticVector(vertex, attribute.semantic);
+            switch (attribute.encoding) {
+                case AttributeEncoding::Float: {
+                    float values[3] = {value.x, value.y, value.z};
+                    store(out, values, semanticComponents(attribute.semantic));
+                    return;
+                }
+                case AttributeEncoding::Half: {
+                    uint16_t values[3] = {packHalf(value.x), packHalf(value.y), packHalf(value.z)};
+                    store(out, values, semanticComponents(attribute.semantic));
+                    return;
+                }
+                case AttributeEncoding::BoundsUnorm16: {
+                    glm::vec3 scale = bounds.max - bounds.min;
+                    uint16_t values[3];
+                    for (int axis = 0; axis < 3; ++axis) {
+                        values[axis] = packUnorm16(scale[axis] > 0.0f ? (value[axis] - bounds.min[axis]) / scale[axis] : 0.0f);
+                    }
+                    store(out, values, 3);
+                    return;
+                }
+                case AttributeEncoding::OctahedralSnorm16: {
+                    float length = glm::length(value);
+                    glm::vec2 octahedral = length > 0.0f ? octEncode(value / length) : glm::vec2(0.0f, 0.0f);
+                    int16_t values[2] = {packSnorm16(octahedral.x), packSnorm16(octahedral.y)};
+                    store(out, values, 2);
+                    return;
+                }
+                case AttributeEncoding::QuaternionSnorm16: {
+                    glm::vec4 q = tangentFrameQuaternion(vertex.Normal, vertex.Tangent, vertex.Bitangent);
+                    int16_t values[4] = {packSnorm16(q.x), packSnorm16(q.y), packSnorm16(q.z), packSnorm16(q.w)};
+                    store(out, values, 4);
+                    return;
+                }
+            }
+        }
+    }
+
+    // the vertices in Format's layout. bounds has to contain every position.
+    template<typename Format, typename VertexT>
+    std::vector<typename Format::Stored> convertVertices(const VertexT* vertices, size_t count, const AABB& bounds) {
+        static_assert(validVertexFormat<Format>(), "vertex format attributes overlap, overflow Stored or use an unsupported encoding");
+        constexpr auto attributes = Format::attributes();
+        std::vector<typename Format::Stored> result(count); // value initialized, padding of the packed structs is 0
+        for (size_t i = 0; i < count; ++i) {
+            unsigned char* out = reinterpret_cast<unsigned char*>(&result[i]);
+            for (size_t a = 0; a < attributes.size(); ++a) {
+                detail::encodeAttribute(attributes[a], vertices[i], bounds, out + attributes[a].offset);
+            }
+        }
+        return result;
+    }
+
+    // attribute pointers for Format, into the GL_ARRAY_BUFFER and VAO currently bound
+    template<typename Format>
+    void setupVertexAttributes() {
+        static_assert(validVertexFormat<Format>(), "vertex format attributes overlap, overflow Stored or use an unsupported encoding");
+        constexpr auto attributes = Format::attributes();
+        for (size_t a = 0; a < attributes.size(); ++a) {
+            glEnableVertexAttribArray(attributes[a].location);
+            glVertexAttribPointer(attributes[a].location, attributeComponents(attributes[a]), attributeType(attributes[a]),
+                                  attributeNormalized(attributes[a]), sizeof(typename Format::Stored),
+                                  (void*)attributes[a].offset);
+        }
+    }
+}
+
+#endif //PROJECT_BASE_VERTEXFORMAT_H
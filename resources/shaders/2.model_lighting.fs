@@ -4,16 +4,45 @@ out vec4 FragColor;
 
 struct PointLight {
     vec3 position;
+    float constant;
 
-    vec3 specular;
-    vec3 diffuse;
     vec3 ambient;
+    float linear;
+
+    vec3 diffuse;
+    float quadratic;
+
+    vec3 specular;
+};
+
+struct SpotLight {
+    vec3 position;
+    float cutOff;
 
+    vec3 direction;
+    float outerCutOff;
+
+    vec3 ambient;
     float constant;
+
+    vec3 diffuse;
     float linear;
+
+    vec3 specular;
     float quadratic;
 };
 
+layout (std140) uniform LightData {
+    PointLight pointLight;
+    SpotLight spotLight;
+};
+
+layout (std140) uniform FrameData {
+    mat4 projection;
+    mat4 view;
+    vec4 viewPos;
+};
+
 struct Material {
     sampler2D texture_diffuse1;
     sampler2D texture_specular1;
@@ -25,11 +54,8 @@ in vec2 TexCoords;
 in vec3 Normal;
 in vec3 FragPos;
 
-uniform PointLight pointLight;
 uniform Material material;
 
-uniform vec3 viewPosition;
-
 vec3 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir) {
     vec3 lightDir = normalize(light.position - fragPos);
     float diff = max(dot(normal, lightDir), 0.0);
@@ -49,7 +75,7 @@ vec3 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir) {
 
 void main() {
     vec3 normal = normalize(Normal);
-    vec3 viewDir = normalize(viewPosition - FragPos);
+    vec3 viewDir = normalize(viewPos.xyz - FragPos);
     vec3 result = CalcPointLight(pointLight, normal, FragPos, viewDir);
     FragColor = vec4(result, 1.0);
 }
\ No newline at end of file
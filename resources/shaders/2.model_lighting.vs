@@ -9,8 +9,12 @@ out vec3 Normal;
 out vec3 FragPos;
 
 uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+
+layout (std140) uniform FrameData {
+    mat4 projection;
+    mat4 view;
+    vec4 viewPos;
+};
 
 void main(){
     FragPos = vec3(model * vec4(aPos, 1.0));
@@ -5,29 +5,37 @@ layout (location = 1) out vec4 BrightColor;
 
 struct PointLight {
     vec3 position;
+    float constant;
 
     vec3 ambient;
-    vec3 diffuse;
-    vec3 specular;
-
-    float constant;
     float linear;
+
+    vec3 diffuse;
     float quadratic;
+
+    vec3 specular;
 };
 
 struct SpotLight {
     vec3 position;
-    vec3 direction;
     float cutOff;
+
+    vec3 direction;
     float outerCutOff;
 
+    vec3 ambient;
     float constant;
-    float linear;
-    float quadratic;
 
-    vec3 ambient;
     vec3 diffuse;
+    float linear;
+
     vec3 specular;
+    float quadratic;
+};
+
+layout (std140) uniform LightData {
+    PointLight pointLight;
+    SpotLight spotLight;
 };
 
 struct Material {
@@ -42,18 +50,21 @@ in vec2 TexCoords;
 in vec3 Normal;
 
 
-uniform PointLight pointLight;
-uniform SpotLight spotLight;
 uniform bool FlashLight;
 uniform Material material;
-uniform vec3 viewPos;
+
+layout (std140) uniform FrameData {
+    mat4 projection;
+    mat4 view;
+    vec4 viewPos;
+};
 
 vec3 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir);
 vec3 CalcSpotLight(SpotLight light, vec3 normal, vec3 fragPos, vec3 viewDir);
 
 void main() {
     vec3 norm = normalize(Normal);
-    vec3 viewDir = normalize(viewPos - FragPos);
+    vec3 viewDir = normalize(viewPos.xyz - FragPos);
 
     vec3 result = CalcPointLight(pointLight,norm,FragPos,viewDir);
     result += CalcSpotLight(spotLight,norm,FragPos,viewDir);
@@ -3,18 +3,45 @@
 layout (location = 0) in vec3 aPos;
 layout (location = 1) in vec3 aNormal;
 layout (location = 2) in vec2 aTexCoords;
+// per instance: model matrix and its precomputed normal matrix
+layout (location = 5) in mat4 aModel;
+layout (location = 9) in mat3 aNormalMatrix;
 
 out vec3 FragPos;
 out vec2 TexCoords;
 out vec3 Normal;
 
-uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+// per mesh vertex decode (rg/VertexFormat.h): positions are stored relative to the mesh bounds and
+// normals octahedral encoded in packed vertex formats, the float format uses offset 0, scale 1
+uniform vec3 positionOffset = vec3(0.0);
+uniform vec3 positionScale = vec3(1.0);
+uniform bool packedNormals = false;
+
+vec3 octDecode(vec2 e) {
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    float t = max(-n.z, 0.0);
+    n.x += n.x >= 0.0 ? -t : t;
+    n.y += n.y >= 0.0 ? -t : t;
+    return normalize(n);
+}
+
+vec3 decodePosition() {
+    return positionOffset + aPos * positionScale;
+}
+
+vec3 decodeNormal() {
+    return packedNormals ? octDecode(aNormal.xy) : aNormal;
+}
+
+layout (std140) uniform FrameData {
+    mat4 projection;
+    mat4 view;
+    vec4 viewPos;
+};
 
 void main(){
-    FragPos = vec3(model * vec4(aPos, 1.0));
+    FragPos = vec3(aModel * vec4(decodePosition(), 1.0));
     TexCoords = aTexCoords;
-    Normal = mat3(inverse(transpose(model))) * aNormal;
-    gl_Position = projection * view * model * vec4(aPos, 1.0);
+    Normal = aNormalMatrix * decodeNormal();
+    gl_Position = projection * view * vec4(FragPos, 1.0);
 }
\ No newline at end of file
@@ -3,18 +3,44 @@
 layout (location = 0) in vec3 aPos;
 layout (location = 1) in vec3 aNormal;
 layout (location = 2) in vec2 aTexCoords;
+// per instance model matrix
+layout (location = 5) in mat4 aModel;
 
 out vec2 TexCoords;
 out vec3 Normal;
 out vec3 FragPos;
 
-uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+// per mesh vertex decode (rg/VertexFormat.h): positions are stored relative to the mesh bounds and
+// normals octahedral encoded in packed vertex formats, the float format uses offset 0, scale 1
+uniform vec3 positionOffset = vec3(0.0);
+uniform vec3 positionScale = vec3(1.0);
+uniform bool packedNormals = false;
+
+vec3 octDecode(vec2 e) {
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    float t = max(-n.z, 0.0);
+    n.x += n.x >= 0.0 ? -t : t;
+    n.y += n.y >= 0.0 ? -t : t;
+    return normalize(n);
+}
+
+vec3 decodePosition() {
+    return positionOffset + aPos * positionScale;
+}
+
+vec3 decodeNormal() {
+    return packedNormals ? octDecode(aNormal.xy) : aNormal;
+}
+
+layout (std140) uniform FrameData {
+    mat4 projection;
+    mat4 view;
+    vec4 viewPos;
+};
 
 void main() {
-    FragPos = vec3(model * vec4(aPos, 1.0));
-    Normal = aNormal;
+    FragPos = vec3(aModel * vec4(decodePosition(), 1.0));
+    Normal = decodeNormal();
     TexCoords = aTexCoords;
     gl_Position = projection * view * vec4(FragPos, 1.0);
 }
@@ -0,0 +1,32 @@
+#version 330 core
+
+out vec4 FragColor;
+
+in vec2 TexCoords;
+
+uniform sampler2D image;
+
+// 13 tap downsample (Jimenez, "Next Generation Post Processing in Call of Duty: Advanced Warfare"):
+// five overlapping 2x2 boxes, weighted so the result doesn't flicker as bright pixels move
+void main() {
+    vec2 texel = 1.0 / textureSize(image, 0);
+    vec3 a = texture(image, TexCoords + texel * vec2(-2.0,  2.0)).rgb;
+    vec3 b = texture(image, TexCoords + texel * vec2( 0.0,  2.0)).rgb;
+    vec3 c = texture(image, TexCoords + texel * vec2( 2.0,  2.0)).rgb;
+    vec3 d = texture(image, TexCoords + texel * vec2(-2.0,  0.0)).rgb;
+    vec3 e = texture(image, TexCoords).rgb;
+    vec3 f = texture(image, TexCoords + texel * vec2( 2.0,  0.0)).rgb;
+    vec3 g = texture(image, TexCoords + texel * vec2(-2.0, -2.0)).rgb;
+    vec3 h = texture(image, TexCoords + texel * vec2( 0.0, -2.0)).rgb;
+    vec3 i = texture(image, TexCoords + texel * vec2( 2.0, -2.0)).rgb;
+    vec3 j = texture(image, TexCoords + texel * vec2(-1.0,  1.0)).rgb;
+    vec3 k = texture(image, TexCoords + texel * vec2( 1.0,  1.0)).rgb;
+    vec3 l = texture(image, TexCoords + texel * vec2(-1.0, -1.0)).rgb;
+    vec3 m = texture(image, TexCoords + texel * vec2( 1.0, -1.0)).rgb;
+
+    vec3 result = e * 0.125;
+    result += (a + c + g + i) * 0.03125;
+    result += (b + d + f + h) * 0.0625;
+    result += (j + k + l + m) * 0.125;
+    FragColor = vec4(result, 1.0);
+}
@@ -0,0 +1,24 @@
+#version 330 core
+
+out vec4 FragColor;
+
+in vec2 TexCoords;
+
+uniform sampler2D image;
+uniform float threshold;
+
+vec3 brightPart(vec3 color) {
+    float brightness = dot(color, vec3(0.2126, 0.7152, 0.0722));
+    return brightness > threshold ? color : vec3(0.0);
+}
+
+// full -> half resolution bright pass. every bilinear tap lands on a texel corner and averages a 2x2 block,
+// so four of them cover a 4x4 footprint
+void main() {
+    vec2 texel = 1.0 / textureSize(image, 0);
+    vec3 result = brightPart(texture(image, TexCoords + texel * vec2(-1.0, -1.0)).rgb);
+    result += brightPart(texture(image, TexCoords + texel * vec2( 1.0, -1.0)).rgb);
+    result += brightPart(texture(image, TexCoords + texel * vec2(-1.0,  1.0)).rgb);
+    result += brightPart(texture(image, TexCoords + texel * vec2( 1.0,  1.0)).rgb);
+    FragColor = vec4(result * 0.25, 1.0);
+}
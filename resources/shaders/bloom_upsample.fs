@@ -0,0 +1,26 @@
+#version 330 core
+
+out vec4 FragColor;
+
+in vec2 TexCoords;
+
+uniform sampler2D image;
+
+// 3x3 tent filter on the smaller mip, added onto the larger one by the blend unit
+void main() {
+    vec2 texel = 1.0 / textureSize(image, 0);
+    vec3 a = texture(image, TexCoords + texel * vec2(-1.0,  1.0)).rgb;
+    vec3 b = texture(image, TexCoords + texel * vec2( 0.0,  1.0)).rgb;
+    vec3 c = texture(image, TexCoords + texel * vec2( 1.0,  1.0)).rgb;
+    vec3 d = texture(image, TexCoords + texel * vec2(-1.0,  0.0)).rgb;
+    vec3 e = texture(image, TexCoords).rgb;
+    vec3 f = texture(image, TexCoords + texel * vec2( 1.0,  0.0)).rgb;
+    vec3 g = texture(image, TexCoords + texel * vec2(-1.0, -1.0)).rgb;
+    vec3 h = texture(image, TexCoords + texel * vec2( 0.0, -1.0)).rgb;
+    vec3 i = texture(image, TexCoords + texel * vec2( 1.0, -1.0)).rgb;
+
+    vec3 result = e * 4.0;
+    result += (b + d + f + h) * 2.0;
+    result += (a + c + g + i);
+    FragColor = vec4(result / 16.0, 1.0);
+}
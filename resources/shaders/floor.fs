@@ -8,33 +8,64 @@ struct Material {
     float shininess;
 };
 
-struct Light {
+struct PointLight {
     vec3 position;
+    float constant;
 
     vec3 ambient;
+    float linear;
+
+    vec3 diffuse;
+    float quadratic;
+
+    vec3 specular;
+};
+
+struct SpotLight {
+    vec3 position;
+    float cutOff;
+
+    vec3 direction;
+    float outerCutOff;
+
+    vec3 ambient;
+    float constant;
+
     vec3 diffuse;
+    float linear;
+
     vec3 specular;
+    float quadratic;
+};
+
+layout (std140) uniform LightData {
+    PointLight pointLight;
+    SpotLight spotLight;
+};
+
+layout (std140) uniform FrameData {
+    mat4 projection;
+    mat4 view;
+    vec4 viewPos;
 };
 
 in vec3 FragPos;
 in vec3 Normal;
 in vec2 TexCoords;
 
-uniform vec3 viewPos;
 uniform Material material;
-uniform Light light;
 
 void main() {
 
-    vec3 ambient = light.ambient * texture(material.floorTextured, TexCoords).rgb;
+    vec3 ambient = pointLight.ambient * texture(material.floorTextured, TexCoords).rgb;
     vec3 norm = normalize(Normal);
-    vec3 lightDir = normalize(light.position - FragPos);
+    vec3 lightDir = normalize(pointLight.position - FragPos);
     float diff = max(dot(norm, lightDir), 0.0);
-    vec3 diffuse = light.diffuse * diff * texture(material.floorTextured, TexCoords).rgb;
-    vec3 viewDir = normalize(viewPos - FragPos);
+    vec3 diffuse = pointLight.diffuse * diff * texture(material.floorTextured, TexCoords).rgb;
+    vec3 viewDir = normalize(viewPos.xyz - FragPos);
     vec3 reflectDir = reflect(-lightDir, norm);
     float spec = pow(max(dot(viewDir, reflectDir), 0.0), material.shininess);
-    vec3 specular = light.specular * (spec * material.specular);
+    vec3 specular = pointLight.specular * (spec * material.specular);
 
     vec3 result = ambient + diffuse + specular;
     FragColor = vec4(result, 1.0);
@@ -8,6 +8,7 @@ uniform sampler2D hdrBuffer;
 uniform sampler2D bloomBlur;
 uniform bool hdr;
 uniform bool bloom;
+uniform float bloomStrength;
 uniform float exposure;
 
 void main() {
@@ -15,7 +16,7 @@ void main() {
     vec3 hdrColor = texture(hdrBuffer, TexCoords).rgb;
     vec3 bloomColor = texture(bloomBlur, TexCoords).rgb;
     if (bloom){
-        hdrColor += bloomColor;
+        hdrColor += bloomColor * bloomStrength;
     }
     if(hdr){
         vec3 result = vec3(1.0) - exp(-hdrColor*exposure);
@@ -0,0 +1,30 @@
+#version 330 core
+
+out vec4 FragColor;
+
+// the level above (or the depth buffer), its base level set to the one being read
+uniform sampler2D depth;
+
+// max of the 2x2 texels this one covers. on odd sides the last column/row also takes the one left over,
+// so every source texel ends up under some texel of the smaller level.
+void main() {
+    ivec2 size = textureSize(depth, 0);
+    ivec2 source = ivec2(gl_FragCoord.xy) * 2;
+    ivec2 last = size - 1;
+    float result = max(max(texelFetch(depth, min(source, last), 0).r, texelFetch(depth, min(source + ivec2(1, 0), last), 0).r),
+                       max(texelFetch(depth, min(source + ivec2(0, 1), last), 0).r, texelFetch(depth, min(source + ivec2(1, 1), last), 0).r));
+    bool extraColumn = (size.x & 1) != 0 && source.x + 3 == size.x;
+    bool extraRow = (size.y & 1) != 0 && source.y + 3 == size.y;
+    if (extraColumn) {
+        result = max(result, max(texelFetch(depth, ivec2(source.x + 2, source.y), 0).r,
+                                 texelFetch(depth, min(ivec2(source.x + 2, source.y + 1), last), 0).r));
+    }
+    if (extraRow) {
+        result = max(result, max(texelFetch(depth, ivec2(source.x, source.y + 2), 0).r,
+                                 texelFetch(depth, min(ivec2(source.x + 1, source.y + 2), last), 0).r));
+    }
+    if (extraColumn && extraRow) {
+        result = max(result, texelFetch(depth, source + ivec2(2, 2), 0).r);
+    }
+    FragColor = vec4(result);
+}
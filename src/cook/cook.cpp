@@ -0,0 +1,298 @@
+// project_base_cook: prepares everything under resources/ offline so the game doesn't parse OBJ files or decode
+// images at launch. Models are imported, welded and written in the mesh cache format with their bounds and levels
+// of detail, textures get their whole mip chain precomputed. resources/cooked/manifest.txt lists every cooked file
+// with the hash of its source; files whose source hash is unchanged are skipped on the next run.
+//
+//   ./project_base_cook [resources directory] [--force] [--lod-error E]
+//
+// --lod-error has to match the game's, the cooked models are ignored otherwise (see rg/MeshLod.h).
+
+#include <stb_image.h>
+
+#include <rg/CommandLine.h>
+#include <rg/CookedAssets.h>
+#include <rg/Hash.h>
+#include <rg/MeshCache.h>
+#include <rg/ModelImport.h>
+#include <rg/ThreadPool.h>
+
+#include <dirent.h>
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <future>
+#include <iostream>
+#include <iterator>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace {
+
+    enum class AssetKind {
+        Model,
+        Texture
+    };
+
+    struct ManifestEntry {
+        AssetKind kind;
+        uint64_t hash; // cookedSourceHash of the source
+        std::string source;
+        std::string cooked;
+    };
+
+    enum class CookStatus {
+        Cooked,
+        UpToDate,
+        Failed
+    };
+
+    struct CookResult {
+        ManifestEntry entry;
+        CookStatus status;
+        double milliseconds;
+        std::string log; // printed by the main thread so lines of parallel jobs don't interleave
+    };
+
+    const char* kindName(AssetKind kind) {
+        return kind == AssetKind::Model ? "model" : "texture";
+    }
+
+    std::string lowercaseExtension(const std::string& path) {
+        size_t dot = path.find_last_of('.');
+        if (dot == std::string::npos || path.find('/', dot) != std::string::npos) {
+            return std::string();
+        }
+        std::string extension = path.substr(dot + 1);
+        std::transform(extension.begin(), extension.end(), extension.begin(), [](unsigned char c) { return std::tolower(c); });
+        return extension;
+    }
+
+    // every regular file below directory, skipping the cooked output itself
+    void listFiles(const std::string& directory, std::vector<std::string>& files) {
+        DIR* dir = opendir(directory.c_str());
+        if (!dir) {
+            return;
+        }
+        while (dirent* entry = readdir(dir)) {
+            std::string name = entry->d_name;
+            if (name == "." || name == "..") {
+                continue;
+            }
+            std::string path = directory + '/' + name;
+            struct stat st;
+            if (stat(path.c_str(), &st) != 0) {
+                continue;
+            }
+            if (S_ISDIR(st.st_mode)) {
+                if (name != "cooked") {
+                    listFiles(path, files);
+                }
+            } else if (S_ISREG(st.st_mode)) {
+                files.push_back(path);
+            }
+        }
+        closedir(dir);
+    }
+
+    // creates every missing directory on the way to the file at path
+    bool makeParentDirectories(const std::string& path) {
+        for (size_t slash = path.find('/', 1); slash != std::string::npos; slash = path.find('/', slash + 1)) {
+            std::string directory = path.substr(0, slash);
+            if (mkdir(directory.c_str(), 0755) != 0 && errno != EEXIST) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    bool fileExists(const std::string& path) {
+        struct stat st;
+        return stat(path.c_str(), &st) == 0;
+    }
+
+    // manifest lines: kind, hash, source path, cooked path, tab separated
+    std::map<std::string, ManifestEntry> readManifest(const std::string& path) {
+        std::map<std::string, ManifestEntry> entries;
+        std::ifstream in(path);
+        std::string line;
+        while (std::getline(in, line)) {
+            std::istringstream fields(line);
+            std::string kind, hash;
+            ManifestEntry entry;
+            if (!std::getline(fields, kind, '\t') || !std::getline(fields, hash, '\t')
+                || !std::getline(fields, entry.source, '\t') || !std::getline(fields, entry.cooked)) {
+                continue;
+            }
+            entry.kind = kind == "model" ? AssetKind::Model : AssetKind::Texture;
+            entry.hash = std::strtoull(hash.c_str(), nullptr, 16);
+            entries[entry.source] = entry;
+        }
+        return entries;
+    }
+
+    bool writeManifest(const std::string& path, const std::vector<ManifestEntry>& entries) {
+        std::ofstream out(path, std::ios::trunc);
+        for (const ManifestEntry& entry : entries) {
+            char hash[17];
+            std::snprintf(hash, sizeof(hash), "%016llx", static_cast<unsigned long long>(entry.hash));
+            out << kindName(entry.kind) << '\t' << hash << '\t' << entry.source << '\t' << entry.cooked << '\n';
+        }
+        return static_cast<bool>(out);
+    }
+
+    // the same import and optimization as Model's cold path, the vertex cache report goes to log
+    bool cookModel(const ManifestEntry& entry, std::ostream& log) {
+        auto start = std::chrono::steady_clock::now();
+        std::vector<rg::ImportedMesh> meshes;
+        rg::VertexCacheStats before, after;
+        if (!rg::importModel(entry.source, meshes, &before, &after)) {
+            return false;
+        }
+        rg::printVertexCacheStats(log, entry.source, before, after);
+        std::vector<std::vector<Texture>> textures(meshes.size());
+        rg::MeshCacheWriter writer;
+        for (size_t i = 0; i < meshes.size(); ++i) {
+            for (const rg::TextureRef& ref : meshes[i].textures) {
+                textures[i].push_back(Texture{0, ref.type, ref.path});
+            }
+            writer.addMesh(meshes[i].vertices, meshes[i].indices, textures[i], meshes[i].bounds, &meshes[i].lods);
+        }
+        double milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        return writer.write(entry.cooked, entry.hash, milliseconds);
+    }
+
+    bool cookTexture(const ManifestEntry& entry, const std::vector<unsigned char>& bytes) {
+        int width, height, components;
+        unsigned char* data = stbi_load_from_memory(bytes.data(), static_cast<int>(bytes.size()), &width, &height, &components, 0);
+        if (!data) {
+            std::cout << "ERROR::COOK:: can't decode " << entry.source << ": " << stbi_failure_reason() << std::endl;
+            return false;
+        }
+        rg::CookedImage image = rg::CookedImage::build(data, width, height, components);
+        stbi_image_free(data);
+        return image.write(entry.cooked, entry.hash);
+    }
+
+    CookResult cook(AssetKind kind, const std::string& source, const std::map<std::string, ManifestEntry>& previous, bool force) {
+        auto start = std::chrono::steady_clock::now();
+        CookResult result;
+        result.entry.kind = kind;
+        result.entry.source = source;
+        result.entry.cooked = kind == AssetKind::Model ? rg::cookedModelPath(source) : rg::cookedTexturePath(source);
+        result.status = CookStatus::Failed;
+
+        // the same hashes the loaders check: meshSourceHash for models, the file contents for textures
+        std::vector<unsigned char> bytes;
+        uint64_t sourceHash = 0;
+        if (kind == AssetKind::Model) {
+            sourceHash = rg::meshSourceHash(source);
+        } else {
+            std::ifstream in(source, std::ios::binary);
+            bytes.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+            sourceHash = bytes.empty() ? 0 : rg::hashBytes(bytes.data(), bytes.size());
+        }
+        if (sourceHash == 0) {
+            std::cout << "ERROR::COOK:: can't read " << source << std::endl;
+            return result;
+        }
+        result.entry.hash = rg::cookedSourceHash(sourceHash);
+
+        auto found = previous.find(source);
+        if (!force && found != previous.end() && found->second.hash == result.entry.hash && fileExists(result.entry.cooked)) {
+            result.status = CookStatus::UpToDate;
+        } else {
+            std::ostringstream log;
+            if (makeParentDirectories(result.entry.cooked)
+                && (kind == AssetKind::Model ? cookModel(result.entry, log) : cookTexture(result.entry, bytes))) {
+                result.status = CookStatus::Cooked;
+            }
+            result.log = log.str();
+        }
+        if (result.status == CookStatus::Failed) {
+            std::cout << "ERROR::COOK:: failed to cook " << source << std::endl;
+        }
+        result.milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        return result;
+    }
+}
+
+int main(int argc, char** argv) {
+    std::string root = "resources";
+    bool force = false;
+    for (int i = 1; i < argc; i++) {
+        if (std::strcmp(argv[i], "--force") == 0) {
+            force = true;
+        } else if (std::strcmp(argv[i], "--lod-error") == 0 && i + 1 < argc) {
+            if (!rg::parsePositive(argv[++i], rg::lodSettings().maxError)) {
+                std::cout << "ERROR::COOK:: --lod-error needs a number, got " << argv[i] << std::endl;
+                return 1;
+            }
+        } else {
+            root = argv[i];
+        }
+    }
+    while (root.size() > 1 && root.back() == '/') {
+        root.pop_back();
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::string> files;
+    listFiles(root, files);
+    std::sort(files.begin(), files.end());
+
+    std::string manifestPath = root + "/cooked/manifest.txt";
+    std::map<std::string, ManifestEntry> previous = readManifest(manifestPath);
+
+    // one job per file, spread over the shared pool
+    rg::ThreadPool& pool = rg::ThreadPool::shared();
+    std::vector<std::future<CookResult>> jobs;
+    for (const std::string& file : files) {
+        std::string extension = lowercaseExtension(file);
+        AssetKind kind;
+        if (extension == "obj") {
+            kind = AssetKind::Model;
+        } else if (extension == "jpg" || extension == "jpeg" || extension == "png" || extension == "tga" || extension == "bmp") {
+            kind = AssetKind::Texture;
+        } else {
+            continue;
+        }
+        jobs.push_back(pool.submit([kind, file, &previous, force] { return cook(kind, file, previous, force); }));
+    }
+
+    std::vector<ManifestEntry> manifest;
+    unsigned int cooked = 0, upToDate = 0, failed = 0;
+    for (auto& job : jobs) {
+        CookResult result = job.get();
+        switch (result.status) {
+            case CookStatus::Cooked:
+                std::cout << result.log << "COOK:: " << kindName(result.entry.kind) << " " << result.entry.source << " -> "
+                          << result.entry.cooked << " (" << result.milliseconds << " ms)" << std::endl;
+                cooked++;
+                manifest.push_back(result.entry);
+                break;
+            case CookStatus::UpToDate:
+                upToDate++;
+                manifest.push_back(result.entry);
+                break;
+            case CookStatus::Failed:
+                failed++;
+                break;
+        }
+    }
+    if (!makeParentDirectories(manifestPath) || !writeManifest(manifestPath, manifest)) {
+        std::cout << "ERROR::COOK:: could not write " << manifestPath << std::endl;
+        return 1;
+    }
+    double milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "COOK:: " << cooked << " cooked, " << upToDate << " up to date, " << failed << " failed on "
+              << pool.size() << " threads in " << milliseconds << " ms" << std::endl;
+    return failed == 0 ? 0 : 1;
+}
@@ -14,9 +14,30 @@
 #include <learnopengl/shader.h>
 #include <learnopengl/camera.h>
 #include <learnopengl/model.h>
+#include <rg/TextureRegistry.h>
 #include <rg/Error.h>
-
+#include <rg/Benchmark.h>
+#include <rg/Bloom.h>
+#include <rg/CameraRecording.h>
+#include <rg/CommandLine.h>
+#include <rg/CpuProfiler.h>
+#include <rg/DepthPyramid.h>
+#include <rg/FrameStats.h>
+#include <rg/Frustum.h>
+#include <rg/GLState.h>
+#include <rg/GpuCulling.h>
+#include <rg/GpuProfiler.h>
+#include <rg/HeadlessContext.h>
+#include <rg/MeshLod.h>
+#include <rg/RenderQueue.h>
+
+#include <cctype>
+#include <chrono>
+#include <cmath>
+#include <cstring>
 #include <iostream>
+#include <memory>
+#include <random>
 
 void framebuffer_size_callback(GLFWwindow *window, int width, int height);
 void mouse_callback(GLFWwindow *window, double xpos, double ypos);
@@ -26,7 +47,13 @@ void key_callback(GLFWwindow *window, int key, int scancode, int action, int mod
 
 unsigned int loadTexture(const char *path);
 unsigned int loadCubemap(vector<std::string> faces);
-void setUpShader(Shader shader,glm::vec3 position,glm::vec3 specular,glm::vec3 diffuse,glm::vec3 ambient,float constant,float linear,float quadratic,glm::mat4 projection,glm::mat4 view,glm::vec3 camPosition,bool point_spot,float cutOff,float outerCutoff,glm::vec3 direction);
+int runCullBenchmark(unsigned int instanceCount);
+int runOcclusionBenchmark(unsigned int instanceCount);
+int runBloomBenchmark();
+int invalidArgument(const char *option, const char *value);
+rg::CameraSample currentCameraSample();
+void applyCameraSample(const rg::CameraSample &sample);
+void setFlashLight(bool flashLight);
 
 
 // settings
@@ -34,6 +61,13 @@ const unsigned int SCR_WIDTH = 800;
 const unsigned int SCR_HEIGHT = 600;
 bool hdr = false;
 bool bloom = false;
+bool legacyBloom = false;
+bool multiDraw = true;
+bool gpuCulling = true;
+bool occlusionCulling = true;
+bool occlusionReadback = false;
+bool levelOfDetail = true;
+float lodPixels = 1.0f;
 float exposure = 1.0f;
 bool FlashLight=true;
 
@@ -52,80 +86,171 @@ float lastFrame = 0.0f;
 glm::vec3 dif;
 glm::vec3 spec;
 
+// per-pass GPU times, printed with P and written to gpu_profile.csv with G
+rg::GpuProfiler *gpuProfiler = nullptr;
+
+// R starts and stops recording the camera path, replayed with --replay
+rg::CameraRecorder cameraRecorder;
+const char *cameraPathFile = "camera_path.rgcam";
+
 glm::vec3 ambientSpot=glm::vec3(0.0f);
 glm::vec3 diffuseSpot=dif;
 glm::vec3 specularSpot=spec;
 
-struct PointLight {
-    glm::vec3 position;
-    glm::vec3 ambient;
-    glm::vec3 diffuse;
-    glm::vec3 specular;
-
-    float constant;
-    float linear;
-    float quadratic;
-};
-struct SpotLight {
-    glm::vec3 position;
-    glm::vec3 direction;
-    float cutOff;
-    float outerCutOff;
-
-    float constant;
-    float linear;
-    float quadratic;
-
-    glm::vec3 ambient;
-    glm::vec3 diffuse;
-    glm::vec3 specular;
-};
-
-int main() {
-    // glfw: initialize and configure
-    glfwInit();
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
-    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+int main(int argc, char **argv) {
+    // --benchmark [frames]: render a scripted orbit offscreen and write frame time statistics as JSON
+    bool benchmark = false;
+    unsigned int benchmarkFrames = 600;
+    const unsigned int benchmarkWarmupFrames = 60;
+    std::string benchmarkOutput = "benchmark.json";
+    // --vertex-format float|packed|packed-tangent: layout of the models' vertex buffers (rg/VertexFormat.h)
+    rg::VertexFormat vertexFormat = rg::VertexFormat::Packed;
+    // --replay <path>: drive the camera from a recorded path, one recorded timestep per frame
+    rg::CameraReplay replay;
+    bool replaying = false;
+    // --instances N: N more cars on a grid, to measure submission with many instances
+    unsigned int extraInstances = 0;
+    for (int i = 1; i < argc; i++) {
+        if (std::strcmp(argv[i], "--cull-bench") == 0 && i + 1 < argc) {
+            unsigned int instances;
+            return rg::parseUnsigned(argv[i + 1], instances) ? runCullBenchmark(instances) : invalidArgument(argv[i], argv[i + 1]);
+        }
+        if (std::strcmp(argv[i], "--occlusion-bench") == 0 && i + 1 < argc) {
+            unsigned int instances;
+            return rg::parseUnsigned(argv[i + 1], instances) ? runOcclusionBenchmark(instances) : invalidArgument(argv[i], argv[i + 1]);
+        }
+        if (std::strcmp(argv[i], "--bloom-bench") == 0)
+            return runBloomBenchmark();
+        if (std::strcmp(argv[i], "--benchmark") == 0) {
+            benchmark = true;
+            if (i + 1 < argc && std::isdigit((unsigned char)argv[i + 1][0]) && !rg::parseUnsigned(argv[++i], benchmarkFrames))
+                return invalidArgument(argv[i - 1], argv[i]);
+        }
+        if (std::strcmp(argv[i], "--benchmark-out") == 0 && i + 1 < argc)
+            benchmarkOutput = argv[++i];
+        if (std::strcmp(argv[i], "--vertex-format") == 0 && i + 1 < argc) {
+            if (!rg::parseVertexFormat(argv[++i], vertexFormat)) {
+                std::cout << "ERROR::VERTEX_FORMAT:: unknown format " << argv[i] << std::endl;
+                return -1;
+            }
+        }
+        if (std::strcmp(argv[i], "--instances") == 0 && i + 1 < argc && !rg::parseUnsigned(argv[++i], extraInstances))
+            return invalidArgument(argv[i - 1], argv[i]);
+        // --no-multi-draw: start with the per mesh submission path, M switches at runtime
+        if (std::strcmp(argv[i], "--no-multi-draw") == 0)
+            multiDraw = false;
+        // --cpu-culling: start with frustum culling on the CPU, C switches at runtime
+        if (std::strcmp(argv[i], "--cpu-culling") == 0)
+            gpuCulling = false;
+        // --no-occlusion: start with frustum culling only, O switches at runtime
+        if (std::strcmp(argv[i], "--no-occlusion") == 0)
+            occlusionCulling = false;
+        // --occlusion-readback: the CPU path tests against the read back depth pyramid instead of rasterizing
+        // the buildings' occluders itself
+        if (std::strcmp(argv[i], "--occlusion-readback") == 0)
+            occlusionReadback = true;
+        // --no-lod: start with every mesh drawn in full, K switches at runtime
+        if (std::strcmp(argv[i], "--no-lod") == 0)
+            levelOfDetail = false;
+        // --lod-error E: error budget of the coarsest level of detail, relative to a mesh's size (rg/MeshLod.h)
+        if (std::strcmp(argv[i], "--lod-error") == 0 && i + 1 < argc && !rg::parsePositive(argv[++i], rg::lodSettings().maxError))
+            return invalidArgument(argv[i - 1], argv[i]);
+        // --lod-pixels P: screen space error in pixels a level of detail may have
+        if (std::strcmp(argv[i], "--lod-pixels") == 0 && i + 1 < argc && !rg::parsePositive(argv[++i], lodPixels))
+            return invalidArgument(argv[i - 1], argv[i]);
+        if (std::strcmp(argv[i], "--replay") == 0 && i + 1 < argc) {
+            if (!replay.open(argv[++i]) || replay.size() == 0) {
+                std::cout << "ERROR::REPLAY:: can't read a camera path from " << argv[i] << std::endl;
+                return -1;
+            }
+            replaying = true;
+        }
+    }
+    // a replayed benchmark covers exactly the recorded frames
+    if (benchmark && replaying)
+        benchmarkFrames = replay.size();
+    RG_PROFILE_THREAD("main");
+
+    GLFWwindow *window = nullptr;
+    // glfw: terminate, clearing all previously allocated GLFW resources. declared before everything that owns GL
+    // objects, so it runs after their destructors have deleted them with the context still current
+    struct GlfwTermination {
+        GLFWwindow *&window;
+        ~GlfwTermination() {
+            if (window)
+                glfwTerminate();
+        }
+    } glfwTermination{window};
+    rg::HeadlessContext headless;
+    if (benchmark) {
+        if (!headless.create())
+            return -1;
+        if (!gladLoadGLLoader((GLADloadproc) rg::HeadlessContext::getProcAddress)) {
+            std::cout << "Failed to initialize GLAD" << std::endl;
+            return -1;
+        }
+        // without a surface the viewport starts at 0x0 and no framebuffer resize ever sets it
+        glViewport(0, 0, SCR_WIDTH, SCR_HEIGHT);
+        // measure every pass, the scene stays as it starts otherwise
+        hdr = true;
+        bloom = true;
+    } else {
+        // glfw: initialize and configure
+        glfwInit();
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+        glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
 
 #ifdef __APPLE__
-    glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
+        glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
 #endif
 
-    // glfw window creation
-    GLFWwindow *window = glfwCreateWindow(SCR_WIDTH, SCR_HEIGHT, "LearnOpenGL", NULL, NULL);
-    if (window == NULL) {
-        std::cout << "Failed to create GLFW window" << std::endl;
-        glfwTerminate();
-        return -1;
+        // glfw window creation
+        window = glfwCreateWindow(SCR_WIDTH, SCR_HEIGHT, "LearnOpenGL", NULL, NULL);
+        if (window == NULL) {
+            std::cout << "Failed to create GLFW window" << std::endl;
+            glfwTerminate();
+            return -1;
+        }
+        glfwMakeContextCurrent(window);
+        glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
+        glfwSetCursorPosCallback(window, mouse_callback);
+        glfwSetScrollCallback(window, scroll_callback);
+        glfwSetKeyCallback(window, key_callback);
+        // tell GLFW to capture our mouse
+        glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
+
+        // glad: load all OpenGL function pointers
+        if (!gladLoadGLLoader((GLADloadproc) glfwGetProcAddress)) {
+            std::cout << "Failed to initialize GLAD" << std::endl;
+            return -1;
+        }
     }
-    glfwMakeContextCurrent(window);
-    glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
-    glfwSetCursorPosCallback(window, mouse_callback);
-    glfwSetScrollCallback(window, scroll_callback);
-    glfwSetKeyCallback(window, key_callback);
-    // tell GLFW to capture our mouse
-    glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
 
-    // glad: load all OpenGL function pointers
-    if (!gladLoadGLLoader((GLADloadproc) glfwGetProcAddress)) {
-        std::cout << "Failed to initialize GLAD" << std::endl;
-        return -1;
-    }
+    // the GL 4.3 multi draw path, contexts without it keep one draw per mesh
+    GLADloadproc loader = benchmark ? (GLADloadproc) rg::HeadlessContext::getProcAddress : (GLADloadproc) glfwGetProcAddress;
+    std::cout << "STARTUP:: glMultiDrawElementsIndirect "
+              << (rg::loadMultiDrawIndirect(loader) ? "available" : "unavailable, drawing one mesh at a time") << std::endl;
+    // instanced draws of the meshes of a model share one instance attribute binding with it
+    std::cout << "STARTUP:: base instance "
+              << (rg::loadBaseInstance(loader) ? "available" : "unavailable, instance attributes are set up per mesh") << std::endl;
+    // GPU culling needs compute shaders on top of it
+    bool gpuCullingAvailable = rg::loadCompute(loader) && rg::multiDrawIndirectSupported();
+    std::cout << "STARTUP:: compute culling " << (gpuCullingAvailable ? "available" : "unavailable, culling on the CPU") << std::endl;
 
     stbi_set_flip_vertically_on_load(false);
 
     // configure global opengl state
-    glEnable(GL_DEPTH_TEST);
-    glEnable(GL_BLEND);
-    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    rg::GLState &glState = rg::GLState::instance();
+    glState.enable(GL_DEPTH_TEST);
+    glState.enable(GL_BLEND);
+    glState.blendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 
     // build and compile shaders
     Shader shader("resources/shaders/cubemaps.vs", "resources/shaders/cubemaps.fs");
     Shader skyboxShader("resources/shaders/skybox.vs","resources/shaders/skybox.fs");
     Shader floorShader("resources/shaders/floor.vs", "resources/shaders/floor.fs");
     Shader hdrShader("resources/shaders/hdr.vs", "resources/shaders/hdr.fs");
-    Shader blurShader("resources/shaders/blur.vs", "resources/shaders/blur.fs");
     Shader blendingShader("resources/shaders/blending.vs", "resources/shaders/blending.fs");
     Shader advShader("resources/shaders/advanced.vs", "resources/shaders/advanced.fs");
 
@@ -216,11 +341,16 @@ int main() {
         glFramebufferTexture2D(GL_FRAMEBUFFER,GL_COLOR_ATTACHMENT0+i,GL_TEXTURE_2D,colorBuffers[i],0);
     }
 
-    unsigned int rboDepth;
-    glGenRenderbuffers(1, &rboDepth);
-    glBindRenderbuffer(GL_RENDERBUFFER, rboDepth);
-    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT, SCR_WIDTH, SCR_HEIGHT);
-    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, rboDepth);
+    // a texture rather than a renderbuffer, the depth pyramid for occlusion culling is built from it
+    unsigned int depthTexture;
+    glGenTextures(1, &depthTexture);
+    glBindTexture(GL_TEXTURE_2D, depthTexture);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT24, SCR_WIDTH, SCR_HEIGHT, 0, GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, depthTexture, 0);
 
     unsigned int attachment[2] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1 };
     glDrawBuffers(2, attachment);
@@ -230,26 +360,30 @@ int main() {
 
     glBindFramebuffer(GL_FRAMEBUFFER, 0);
 
-    unsigned int pingpongFBO[2];
-    unsigned int pingpongColorbuffers[2];
-    glGenFramebuffers(2, pingpongFBO);
-    glGenTextures(2, pingpongColorbuffers);
-    for (unsigned int i = 0; i < 2; ++i){
-        glBindFramebuffer(GL_FRAMEBUFFER, pingpongFBO[i]);
-        glBindTexture(GL_TEXTURE_2D, pingpongColorbuffers[i]);
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, SCR_WIDTH, SCR_HEIGHT, 0, GL_RGBA, GL_FLOAT, nullptr); //bilo NULL umesto nullptr
+    // a headless context has no default framebuffer, the final image goes to an offscreen one instead
+    unsigned int outputFBO = 0;
+    if (benchmark) {
+        unsigned int outputColorbuffer;
+        glGenFramebuffers(1, &outputFBO);
+        glBindFramebuffer(GL_FRAMEBUFFER, outputFBO);
+        glGenTextures(1, &outputColorbuffer);
+        glBindTexture(GL_TEXTURE_2D, outputColorbuffer);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, SCR_WIDTH, SCR_HEIGHT, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, pingpongColorbuffers[i], 0);
-
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, outputColorbuffer, 0);
         if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
             std::cout << "Framebuffer not complete!" << std::endl;
         }
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
     }
 
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    // progressive bloom, the ping-pong blur stays as the legacy path (toggle with L)
+    rg::BloomMipChain bloomChain(SCR_WIDTH, SCR_HEIGHT);
+    rg::BloomPingPong bloomPingPong(SCR_WIDTH, SCR_HEIGHT);
+    rg::BloomMipChain::printBandwidthReport(std::cout);
+    // the scene writes the bright color attachment only for the legacy blur
+    int hdrDrawBufferCount = 2;
 
     //-----quad------
     float quadVertices[] = {
@@ -304,6 +438,8 @@ int main() {
 
     floorShader.use();
     floorShader.setInt("material.floorTextured", 0);
+    floorShader.setVec3("material.specular", glm::vec3(0.1f));
+    floorShader.setFloat("material.shininess", 10.0f);
 
     blendingShader.use();
     blendingShader.setInt("texture1", 0);
@@ -311,26 +447,88 @@ int main() {
     shader.use();
     shader.setInt("texture1", 0);
 
-    blurShader.use();
-    blurShader.setInt("image", 0);
-
     hdrShader.use();
     hdrShader.setInt("hdrBuffer", 0);
     hdrShader.setInt("bloomBlur", 1);
 
     // load models
-    Model destroyedBuildingModel("resources/objects/BuildingRADI/Building01.obj");
-    Model carModel("resources/objects/car/LowPolyCars.obj");
-    Model treeModel("resources/objects/tree/tree.obj");
-    Model streetlampModel("resources/objects/lamp/streetlamp.obj");
+    auto modelLoadStart = std::chrono::steady_clock::now();
+    // the buildings are the only occluders of the software occlusion rasterizer, only they need the proxy
+    Model destroyedBuildingModel("resources/objects/BuildingRADI/Building01.obj", false, vertexFormat, true);
+    Model carModel("resources/objects/car/LowPolyCars.obj", false, vertexFormat);
+    Model treeModel("resources/objects/tree/tree.obj", false, vertexFormat);
+    Model streetlampModel("resources/objects/lamp/streetlamp.obj", false, vertexFormat);
+    std::cout << "STARTUP:: models loaded in "
+              << std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - modelLoadStart).count() << " ms" << std::endl;
+    rg::TextureRegistry::instance().report(std::cout);
+    size_t vertexBufferBytes = destroyedBuildingModel.VertexBufferBytes() + carModel.VertexBufferBytes()
+                               + treeModel.VertexBufferBytes() + streetlampModel.VertexBufferBytes();
+    std::cout << "STARTUP:: vertex buffers " << vertexBufferBytes / 1024.0 << " KiB as "
+              << rg::vertexFormatName(vertexFormat) << std::endl;
+    // loading grew the arena's buffers by doubling, shrink them to what the models use
+    rg::GeometryArena::instance().compact();
+    rg::GeometryArena::instance().report(std::cout);
 
     destroyedBuildingModel.SetShaderTextureNamePrefix("material.");
     carModel.SetShaderTextureNamePrefix("material.");
     treeModel.SetShaderTextureNamePrefix("material.");
     streetlampModel.SetShaderTextureNamePrefix("material.");
 
+    // place the props, every model is drawn with one instanced call per mesh
+    vector<glm::mat4> carTransforms;
+    for (glm::vec3 position : {glm::vec3(22.0f, -2.1, -10.0), glm::vec3(7.0f, -2.1, 8.0), glm::vec3(-2.0f, -2.1, 12.0)})
+        carTransforms.push_back(glm::translate(glm::scale(glm::mat4(1.0f), glm::vec3(0.25)), position));
+    unsigned int gridSide = (unsigned int)std::ceil(std::sqrt((double)extraInstances));
+    for (unsigned int i = 0; i < extraInstances; i++) {
+        glm::vec3 position(-120.0f + 240.0f * (i % gridSide) / gridSide, -2.1f, -120.0f + 240.0f * (i / gridSide) / gridSide);
+        carTransforms.push_back(glm::translate(glm::scale(glm::mat4(1.0f), glm::vec3(0.25)), position));
+    }
+    carModel.SetInstances(carTransforms);
+
+    vector<glm::mat4> treeTransforms;
+    for (glm::vec3 position : {glm::vec3(16.5f, -2.6, -28.0), glm::vec3(0.0f, -2.6, -28.0), glm::vec3(-16.0f, -2.6, -28.0)})
+        treeTransforms.push_back(glm::translate(glm::scale(glm::mat4(1.0f), glm::vec3(0.2)), position));
+    treeModel.SetInstances(treeTransforms);
+
+    vector<glm::mat4> streetlampTransforms;
+    glm::mat4 streetlamp = glm::translate(glm::scale(glm::mat4(1.0f), glm::vec3(0.08)), glm::vec3(55.0f, -6.35, 10.0));
+    for (int i = 0; i < 4; i++) {
+        streetlampTransforms.push_back(streetlamp);
+        streetlamp = glm::translate(streetlamp, glm::vec3(-20.0f, 0, 0));
+    }
+    streetlampModel.SetInstances(streetlampTransforms);
+
+    vector<glm::mat4> buildingTransforms;
+    for (glm::vec3 position : {glm::vec3(22.0f, -2.3, -30.0), glm::vec3(7.0f, -2.3, -30.0), glm::vec3(-7.0f, -2.3, -30.0),
+                               glm::vec3(-22.0f, -2.3, -30.0), glm::vec3(-22.0f, -2.3, -15.0), glm::vec3(-22.0f, -2.3, 0.0),
+                               glm::vec3(-22.0f, -2.3, 15.0)})
+        buildingTransforms.push_back(glm::translate(glm::scale(glm::mat4(1.0f), glm::vec3(0.25)), position));
+    destroyedBuildingModel.SetInstances(buildingTransforms);
+
+    // occlusion culling on the GPU tests against the previous frame's depth reduced to a pyramid. the CPU path
+    // rasterizes the buildings' occluders for the current frame at low resolution, or with --occlusion-readback
+    // reads a small level of the pyramid back a few frames late
+    rg::DepthPyramid depthPyramid(SCR_WIDTH, SCR_HEIGHT);
+    rg::HiZReadback hizReadback(depthPyramid);
+    rg::OcclusionRasterizer softwareOcclusion(256, 256 * SCR_HEIGHT / SCR_WIDTH);
+
+    // the same models culled by a compute shader against the frustum and the depth pyramid, with the same
+    // shaders and layers as the CPU path below
+    std::unique_ptr<rg::GpuCuller> gpuCuller;
+    if (gpuCullingAvailable) {
+        gpuCuller.reset(new rg::GpuCuller());
+        gpuCuller->addModel(carModel, advShader, rg::RenderLayer::Opaque, true);
+        gpuCuller->addModel(streetlampModel, advShader, rg::RenderLayer::Opaque);
+        gpuCuller->addModel(destroyedBuildingModel, advShader, rg::RenderLayer::Opaque);
+        gpuCuller->addModel(treeModel, blendingShader, rg::RenderLayer::AlphaTested);
+    }
+
+    // camera and light data shared by all shaders through uniform blocks
+    rg::UniformBuffer<rg::FrameData> frameUniforms(rg::FrameDataBinding);
+    rg::UniformBuffer<rg::LightData> lightUniforms(rg::LightDataBinding);
+
     // light init
-    PointLight pointLight;
+    rg::PointLight pointLight;
     pointLight.position = glm::vec3(4.0f, 4.0, 0.0);
     pointLight.ambient = glm::vec3(0.8);
     pointLight.diffuse = glm::vec3(1.0);
@@ -340,7 +538,7 @@ int main() {
     pointLight.linear = 0.09f;
     pointLight.quadratic = 0.032f;
 
-    SpotLight spotLight;
+    rg::SpotLight spotLight;
     spotLight.position=glm::vec3(0.0f);
     spotLight.direction=glm::vec3(0.0f);
     spotLight.cutOff=glm::cos(glm::radians(12.5f));
@@ -353,24 +551,113 @@ int main() {
     spotLight.specular=specularSpot;
 
 
-    // render loop
-    while (!glfwWindowShouldClose(window)) {
-
-        float currentFrame = glfwGetTime();
-        deltaTime = currentFrame - lastFrame;
-        lastFrame = currentFrame;
+    // uniforms set every frame, resolved once so setting one is a single glUniform call
+    UniformHandle advFlashLight = advShader.uniform(UNIFORM("FlashLight"));
+    UniformHandle floorModel = floorShader.uniform(UNIFORM("model"));
+    UniformHandle hdrBloom = hdrShader.uniform(UNIFORM("bloom"));
+    UniformHandle hdrBloomStrength = hdrShader.uniform(UNIFORM("bloomStrength"));
+    UniformHandle hdrHdr = hdrShader.uniform(UNIFORM("hdr"));
+    UniformHandle hdrExposure = hdrShader.uniform(UNIFORM("exposure"));
+
+    // the floor isn't a Mesh, the render queue draws it through a callback
+    struct FloorDraw {
+        Shader *shader;
+        UniformHandle model;
+        unsigned int vertexArray;
+        unsigned int texture;
+        glm::mat4 transform;
+    };
+    FloorDraw floorDraw{&floorShader, floorModel, floorVAO, floorTexture,
+                        glm::translate(glm::scale(glm::mat4(1.0f), glm::vec3(15.0)), glm::vec3(0, 0.465, -0.1333))};
+    rg::DrawItem floorItem;
+    floorItem.shader = &floorShader;
+    floorItem.draw = [](void *context) {
+        FloorDraw *floor = static_cast<FloorDraw*>(context);
+        rg::GLState::instance().bindVertexArray(floor->vertexArray);
+        rg::GLState::instance().bindTexture(0, GL_TEXTURE_2D, floor->texture);
+        floor->shader->setMat4(floor->model, floor->transform);
+        glDrawArrays(GL_TRIANGLES, 0, 6);
+        rg::frameStats().triangles += 2;
+    };
+    floorItem.context = &floorDraw;
+    floorItem.material = floorTexture;
+    floorItem.vertexArray = floorVAO;
+    floorItem.pass = "floor";
+    glm::vec3 floorCenter = glm::vec3(floorDraw.transform[3]);
+
+    rg::RenderQueue renderQueue;
+    const float farPlane = 100.0f;
+
+    rg::GpuProfiler profiler;
+    gpuProfiler = &profiler;
+
+    // the setup above binds buffers, vertex arrays and textures directly, start the frame from a clean cache
+    glState.invalidate();
+
+    // benchmark: orbit the middle of the floor starting from the saved pose, holding still during the warmup
+    glm::vec3 benchmarkStart = camera.Position, savedFront;
+    if (benchmark && !rg::loadSavedPose(FileSystem::getPath("resources/program_state.txt"), benchmarkStart, savedFront))
+        std::cout << "ERROR::BENCHMARK:: no saved camera pose, starting from the default one" << std::endl;
+    rg::BenchmarkPath benchmarkPath(benchmarkStart, glm::vec3(floorCenter.x, 0.0f, floorCenter.z), benchmarkFrames);
+    rg::BenchmarkReport benchmarkReport;
+    benchmarkReport.setVertexBuffers(rg::vertexFormatName(vertexFormat), vertexBufferBytes);
+    benchmarkReport.setSubmission(renderQueue.multiDrawActive() ? "multi draw indirect" : "per mesh",
+                                  (unsigned int)(carTransforms.size() + treeTransforms.size() + streetlampTransforms.size() + buildingTransforms.size()));
+    benchmarkReport.setCulling(gpuCulling && gpuCuller ? (occlusionCulling ? "gpu, depth pyramid" : "gpu")
+                               : !occlusionCulling ? "cpu" : occlusionReadback ? "cpu, depth pyramid readback" : "cpu, software occlusion");
+    benchmarkReport.setLod(levelOfDetail ? "error " + std::to_string(rg::lodSettings().maxError) + ", " + std::to_string(lodPixels) + " px" : "off");
+    unsigned int benchmarkFrame = 0;
 
-        processInput(window);
+    // render loop
+    while (benchmark ? benchmarkFrame < benchmarkWarmupFrames + benchmarkFrames : !glfwWindowShouldClose(window)) {
+
+        auto frameStart = std::chrono::steady_clock::now();
+        rg::beginFrameStats();
+        profiler.beginFrame();
+        unsigned int frameScope = profiler.beginScope("frame");
+        RG_PROFILE_SCOPE("frame");
+
+        if (benchmark) {
+            // fixed timestep, nothing depends on the wall clock
+            deltaTime = 1.0f / 60.0f;
+            unsigned int pathFrame = benchmarkFrame < benchmarkWarmupFrames ? 0 : benchmarkFrame - benchmarkWarmupFrames;
+            if (replaying) {
+                applyCameraSample(replay.at(pathFrame));
+            } else {
+                rg::CameraPose pose = benchmarkPath.at(pathFrame);
+                camera.SetPose(pose.position, pose.yaw, pose.pitch);
+            }
+        } else {
+            float currentFrame = glfwGetTime();
+            deltaTime = currentFrame - lastFrame;
+            lastFrame = currentFrame;
+            processInput(window);
+            if (replaying) {
+                // simulated time advances one recorded step per frame, however long the frame took
+                deltaTime = replay.timestep();
+                applyCameraSample(replay.next());
+                if (replay.finished()) {
+                    std::cout << "REPLAY:: finished after " << replay.size() << " frames" << std::endl;
+                    replaying = false;
+                }
+            }
+            cameraRecorder.update(deltaTime, currentCameraSample());
+        }
+        glBindFramebuffer(GL_FRAMEBUFFER, outputFBO);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
         glBindFramebuffer(GL_FRAMEBUFFER,hdrFBO);
+        int drawBufferCount = bloom && legacyBloom ? 2 : 1;
+        if (drawBufferCount != hdrDrawBufferCount) {
+            glDrawBuffers(drawBufferCount, attachment);
+            hdrDrawBufferCount = drawBufferCount;
+        }
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-        glDepthMask(GL_TRUE);
+        glState.depthMask(true);
 
         // draw scene as normal
-        glm::mat4 projection = glm::perspective(glm::radians(camera.Zoom), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 100.0f);
+        glm::mat4 projection = glm::perspective(glm::radians(camera.Zoom), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, farPlane);
         glm::mat4 view = camera.GetViewMatrix();
-        glm::mat4 model = glm::mat4(1.0f);
 
 
         spotLight.position=camera.Position;
@@ -380,218 +667,173 @@ int main() {
         spotLight.specular=spec;
 
 
-        // setup shaders
-        setUpShader(advShader,pointLight.position,pointLight.specular,pointLight.diffuse,pointLight.ambient,pointLight.constant,pointLight.linear,pointLight.quadratic,projection,view,camera.Position,true,spotLight.cutOff,spotLight.outerCutOff,spotLight.direction);
-        setUpShader(advShader,spotLight.position,spotLight.specular,spotLight.diffuse,spotLight.ambient,spotLight.constant,spotLight.linear,spotLight.quadratic,projection,view,camera.Position,false,spotLight.cutOff,spotLight.outerCutOff,spotLight.direction);
-
-        advShader.use();
-        advShader.setInt("FlashLight",FlashLight);
-
+        // upload the per-frame blocks once, every shader reads them from their binding points
+        rg::FrameData frameData;
+        frameData.projection = projection;
+        frameData.view = view;
+        frameData.viewPos = glm::vec4(camera.Position, 1.0f);
+        frameUniforms.update(frameData);
 
-        // render models
+        rg::LightData lightData;
+        lightData.pointLight = pointLight;
+        lightData.spotLight = spotLight;
+        lightUniforms.update(lightData);
 
-        //-----carModel-----
-        //enable culling so cars inner sides don't render
-        glEnable(GL_CULL_FACE);
-        glCullFace(GL_BACK);
-
-        advShader.use();
-        model = glm::mat4(1.0f);
-        model = glm::scale(model, glm::vec3(0.25));
-        model = glm::translate(model,glm::vec3(22.0f, -2.1, -10.0));
-        advShader.setMat4("model",model);
-        advShader.setMat4("projection",projection);
-        advShader.setMat4("view",view);
-        carModel.Draw(advShader);
-
-        model = glm::mat4(1.0f);
-        model = glm::scale(model, glm::vec3(0.25));
-        model = glm::translate(model,glm::vec3(7.0f, -2.1, 8.0));
-        advShader.setMat4("model", model);
-        carModel.Draw(advShader);
-
-        model = glm::mat4(1.0f);
-        model = glm::scale(model, glm::vec3(0.25));
-        model = glm::translate(model,glm::vec3(-2.0f, -2.1, 12.0));
-        advShader.setMat4("model", model);
-        carModel.Draw(advShader);
-        glDisable(GL_CULL_FACE);
-
-        //---- treeModel-----
-        blendingShader.use();
-        model = glm::mat4(1.0f);
-        model = glm::scale(model, glm::vec3(0.2));
-        model = glm::translate(model,glm::vec3(16.5f, -2.6, -28.0));
-        blendingShader.setMat4("model",model);
-        blendingShader.setMat4("projection",projection);
-        blendingShader.setMat4("view",view);
-        treeModel.Draw(blendingShader);
-
-        model = glm::mat4(1.0f);
-        model = glm::scale(model, glm::vec3(0.2));
-        model = glm::translate(model,glm::vec3(0.0f, -2.6, -28.0));
-        blendingShader.setMat4("model", model);
-        treeModel.Draw(blendingShader);
-
-        model = glm::mat4(1.0f);
-        model = glm::scale(model, glm::vec3(0.2));
-        model = glm::translate(model,glm::vec3(-16.0f, -2.6, -28.0));
-        blendingShader.setMat4("model", model);
-        treeModel.Draw(blendingShader);
-
-
-        //----streetlampModel------
         advShader.use();
-        model = glm::mat4(1.0f);
-        model = glm::scale(model, glm::vec3(0.08));
-        model = glm::translate(model,glm::vec3(55.0f, -6.35, 10.0));
-        advShader.setMat4("model",model);
-        advShader.setMat4("projection",projection);
-        advShader.setMat4("view",view);
-        streetlampModel.Draw(advShader);
-
-        model = glm::translate(model,glm::vec3(-20.0f, 0, 0));
-        advShader.setMat4("model", model);
-        streetlampModel.Draw(advShader);
-
-        model = glm::translate(model,glm::vec3(-20.0f, 0, 0));
-        advShader.setMat4("model", model);
-        streetlampModel.Draw(advShader);
-
-        model = glm::translate(model,glm::vec3(-20.0f, 0, 0));
-        advShader.setMat4("model", model);
-        streetlampModel.Draw(advShader);
-
+        advShader.setInt(advFlashLight, FlashLight);
+
+
+        // render models, one instanced draw per mesh for all copies of a model. the queue orders them:
+        // solid geometry grouped by program and material, then the trees' bark, then their leaves blended back to front
+        rg::Frustum frustum = rg::Frustum::fromMatrix(projection * view);
+        // levels of detail by their error in pixels at the current field of view
+        rg::LodSelection lodSelection = rg::LodSelection::perspective(camera.Position, camera.Zoom, (float)SCR_HEIGHT, lodPixels);
+        const rg::LodSelection *lod = levelOfDetail ? &lodSelection : nullptr;
+        bool cullOnGpu = gpuCulling && gpuCuller;
+        if (cullOnGpu) {
+            rg::GpuScope scope(profiler, "cull");
+            gpuCuller->cull(frustum, occlusionCulling ? &depthPyramid : nullptr, lod);
+        } else {
+            auto cullModels = [&](auto occlusion) {
+                carModel.Cull(frustum, occlusion, lod);
+                streetlampModel.Cull(frustum, occlusion, lod);
+                destroyedBuildingModel.Cull(frustum, occlusion, lod);
+                treeModel.Cull(frustum, occlusion, lod);
+            };
+            if (occlusionCulling && !occlusionReadback) {
+                // the building row hides most of the scene, its occluders are drawn before anything is tested
+                softwareOcclusion.begin(projection * view);
+                for (const InstanceData &building : destroyedBuildingModel.Instances())
+                    softwareOcclusion.addOccluder(destroyedBuildingModel.occluder, building.Model);
+                softwareOcclusion.rasterize();
+                cullModels(&softwareOcclusion);
+            } else {
+                cullModels(occlusionCulling ? &hizReadback : nullptr);
+            }
+        }
 
-        //-----destroyedBuildingModel----
-        advShader.use();
-        model = glm::mat4(1.0f);
-        model = glm::scale(model, glm::vec3(0.25));
-        model = glm::translate(model,glm::vec3(22.0f, -2.3, -30.0));
-        advShader.setMat4("model",model);
-        advShader.setMat4("projection",projection);
-        advShader.setMat4("view",view);
-        destroyedBuildingModel.Draw(advShader);
-
-        model = glm::mat4(1.0f);
-        model = glm::scale(model, glm::vec3(0.25));
-        model = glm::translate(model,glm::vec3(7.0f, -2.3, -30.0));
-        advShader.setMat4("model", model);
-        destroyedBuildingModel.Draw(advShader);
-
-        model = glm::mat4(1.0f);
-        model = glm::scale(model, glm::vec3(0.25));
-        model = glm::translate(model,glm::vec3(-7.0f, -2.3, -30.0));
-        advShader.setMat4("model", model);
-        destroyedBuildingModel.Draw(advShader);
-
-        model = glm::mat4(1.0f);
-        model = glm::scale(model, glm::vec3(0.25));
-        model = glm::translate(model,glm::vec3(-22.0f, -2.3, -30.0));
-        advShader.setMat4("model", model);
-        destroyedBuildingModel.Draw(advShader);
-
-
-        model = glm::mat4(1.0f);
-        model = glm::scale(model, glm::vec3(0.25));
-        model = glm::translate(model,glm::vec3(-22.0f, -2.3, -15.0));
-        advShader.setMat4("model", model);
-        destroyedBuildingModel.Draw(advShader);
-
-        model = glm::mat4(1.0f);
-        model = glm::scale(model, glm::vec3(0.25));
-        model = glm::translate(model,glm::vec3(-22.0f, -2.3, 0.0));
-        advShader.setMat4("model", model);
-        destroyedBuildingModel.Draw(advShader);
-
-        model = glm::mat4(1.0f);
-        model = glm::scale(model, glm::vec3(0.25));
-        model = glm::translate(model,glm::vec3(-22.0f, -2.3, 15.0));
-        advShader.setMat4("model", model);
-        destroyedBuildingModel.Draw(advShader);
-
-        //----------floor-----------
-        floorShader.use();
-        model = glm::mat4(1.0f);
-
-        model = glm::scale(model, glm::vec3(15.0));
-        model = glm::translate(model,glm::vec3(0,0,0));
-        floorShader.setMat4("model", model);
-        floorShader.setMat4("projection", projection);
-        floorShader.setMat4("view", view);
-
-        floorShader.setVec3("light.position", pointLight.position);
-        floorShader.setVec3("light.ambient", pointLight.ambient);
-        floorShader.setVec3("light.diffuse", pointLight.diffuse);
-        floorShader.setVec3("light.specular", pointLight.specular);
-        floorShader.setVec3("material.specular", glm::vec3(0.1f));
-        floorShader.setFloat("material.shininess", 10.0f);
-        floorShader.setVec3("viewPos", camera.Position);
-
-        glBindVertexArray(floorVAO);
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, floorTexture);
-        model = glm::mat4(1.0f);
-        model = glm::scale(model, glm::vec3(15.0));
-        model = glm::translate(model,glm::vec3(0,0.465,-0.1333));
-        floorShader.setMat4("model", model);
-        glDrawArrays(GL_TRIANGLES, 0, 6);
-        glBindVertexArray(0);
+        renderQueue.begin(camera.Position, farPlane);
+        if (cullOnGpu) {
+            gpuCuller->addTo(renderQueue);
+        } else {
+            //enable culling so cars inner sides don't render
+            renderQueue.addModel(carModel, advShader, rg::RenderLayer::Opaque, true);
+            renderQueue.addModel(streetlampModel, advShader, rg::RenderLayer::Opaque);
+            renderQueue.addModel(destroyedBuildingModel, advShader, rg::RenderLayer::Opaque);
+            renderQueue.addModel(treeModel, blendingShader, rg::RenderLayer::AlphaTested);
+        }
+        renderQueue.add(floorItem, floorCenter);
+        renderQueue.sort();
+        renderQueue.setMultiDraw(multiDraw);
+        double submitMilliseconds;
+        {
+            rg::GpuScope scope(profiler, "scene");
+            auto submitStart = std::chrono::steady_clock::now();
+            renderQueue.submit(&profiler);
+            submitMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - submitStart).count();
+        }
 
 
         // ------ draw skybox as last
-        glDepthMask(GL_FALSE);
-        glDepthFunc(GL_LEQUAL);
-        skyboxShader.use();
-        skyboxShader.setMat4("view",glm::mat4(glm::mat3(view)));
-        skyboxShader.setMat4("projection", projection);
-        glBindVertexArray(skyboxVAO);
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_CUBE_MAP, cubemapTexture);
-        glDrawArrays(GL_TRIANGLES, 0, 36);
-        glBindVertexArray(0);
-        glDepthMask(GL_TRUE);
-        glDepthFunc(GL_LESS);
+        {
+            rg::GpuScope scope(profiler, "skybox");
+            glState.depthMask(false);
+            glState.depthFunc(GL_LEQUAL);
+            skyboxShader.use();
+            glState.bindVertexArray(skyboxVAO);
+            glState.bindTexture(0, GL_TEXTURE_CUBE_MAP, cubemapTexture);
+            glDrawArrays(GL_TRIANGLES, 0, 36);
+            glState.depthMask(true);
+            glState.depthFunc(GL_LESS);
+        }
+
+        // next frame's occlusion test reads this frame's depth. a copy that sat out some frames is dropped
+        // rather than tested against once occlusion or the CPU path come back
+        if (occlusionCulling && (cullOnGpu || occlusionReadback)) {
+            rg::GpuScope scope(profiler, "depth pyramid");
+            depthPyramid.build(depthTexture, quadVAO, projection * view);
+            if (cullOnGpu)
+                hizReadback.invalidate();
+            else
+                hizReadback.update();
+        } else {
+            depthPyramid.invalidate();
+            hizReadback.invalidate();
+        }
 
         glBindFramebuffer(GL_FRAMEBUFFER,0);
 
-        bool horizontal = true;
-        bool first_iteration = true;
-        blurShader.use();
-        unsigned int amount = 10;
-        for (unsigned int i = 0; i < amount; i++){
-            glBindFramebuffer(GL_FRAMEBUFFER, pingpongFBO[horizontal]);
-            blurShader.setInt("horizontal", horizontal);
-            glActiveTexture(GL_TEXTURE0);
-            glBindTexture(GL_TEXTURE_2D, first_iteration ? colorBuffers[1] : pingpongColorbuffers[!horizontal]);
-            glBindVertexArray(quadVAO);
-            glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
-            glBindVertexArray(0);
-            horizontal = !horizontal;
-            if (first_iteration)
-                first_iteration = false;
+        // bloom, skipped entirely when it's off
+        unsigned int bloomTexture = 0;
+        float bloomStrength = 1.0f;
+        rg::FrameStats &stats = rg::frameStats();
+        if (bloom) {
+            // one scope per path, switching with L doesn't mix their timings
+            const char *bloomScope = legacyBloom ? "bloom (ping-pong)" : "bloom (mip chain)";
+            rg::GpuScope scope(profiler, bloomScope);
+            if (legacyBloom) {
+                bloomTexture = bloomPingPong.render(colorBuffers[1], quadVAO);
+                stats.bloomPath = "10 ping-pong passes";
+                stats.bloomBytesRead = rg::BloomPingPong::bytesRead(SCR_WIDTH, SCR_HEIGHT);
+            } else {
+                bloomTexture = bloomChain.render(colorBuffers[0], quadVAO, 1.0f);
+                bloomStrength = bloomChain.strength();
+                stats.bloomPath = "mip chain";
+                stats.bloomBytesRead = rg::BloomMipChain::bytesRead(SCR_WIDTH, SCR_HEIGHT);
+            }
+            stats.bloomMilliseconds = profiler.last(bloomScope);
         }
-        glBindFramebuffer(GL_FRAMEBUFFER, 0);
 
 
+        unsigned int tonemapScope = profiler.beginScope("tonemap");
+        glBindFramebuffer(GL_FRAMEBUFFER, outputFBO);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
         hdrShader.use();
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D,colorBuffers[0]);
-        glActiveTexture(GL_TEXTURE1);
-        glBindTexture(GL_TEXTURE_2D, pingpongColorbuffers[!horizontal]);
-        hdrShader.setBool("bloom", bloom);
-        hdrShader.setBool("hdr", hdr);
-        hdrShader.setFloat("exposure", exposure);
-        glBindVertexArray(quadVAO);
+        glState.bindTexture(0, GL_TEXTURE_2D, colorBuffers[0]);
+        glState.bindTexture(1, GL_TEXTURE_2D, bloomTexture);
+        hdrShader.setBool(hdrBloom, bloom);
+        hdrShader.setFloat(hdrBloomStrength, bloomStrength);
+        hdrShader.setBool(hdrHdr, hdr);
+        hdrShader.setFloat(hdrExposure, exposure);
+        glState.bindVertexArray(quadVAO);
         glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
-        glBindVertexArray(0);
-
-        glfwSwapBuffers(window);
+        profiler.endScope(tonemapScope);
+        profiler.endScope(frameScope);
+
+        if (benchmark) {
+            // without a swap nothing paces the frames, wait for the GPU so the time covers the whole frame
+            glFinish();
+            if (benchmarkFrame >= benchmarkWarmupFrames) {
+                double milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - frameStart).count();
+                benchmarkReport.add(milliseconds, profiler.last("scene"), submitMilliseconds, rg::frameStats().drawCalls,
+                                    rg::frameStats().trianglesSubmitted(), rg::frameStats().occludedRatio());
+            }
+            benchmarkFrame++;
+            continue;
+        }
+        {
+            RG_PROFILE_SCOPE("glfwSwapBuffers");
+            glfwSwapBuffers(window);
+        }
         glfwPollEvents();
     }
 
-    // glfw: terminate, clearing all previously allocated GLFW resources.
+    if (benchmark) {
+        std::string renderer = (const char*)glGetString(GL_RENDERER);
+        benchmarkReport.write(std::cout, renderer, SCR_WIDTH, SCR_HEIGHT, benchmarkWarmupFrames);
+        if (benchmarkReport.write(benchmarkOutput, renderer, SCR_WIDTH, SCR_HEIGHT, benchmarkWarmupFrames))
+            std::cout << "BENCHMARK:: results written to " << benchmarkOutput << std::endl;
+    }
+
+    destroyedBuildingModel.Unload();
+    carModel.Unload();
+    treeModel.Unload();
+    streetlampModel.Unload();
+    rg::GeometryArena::instance().report(std::cout);
+    rg::TextureRegistry::instance().release(floorTexture);
+    rg::TextureRegistry::instance().release(cubemapTexture);
+    rg::TextureRegistry::instance().report(std::cout);
+
     glDeleteVertexArrays(1, &skyboxVAO);
     glDeleteBuffers(1, &skyboxVAO);
     glDeleteVertexArrays(1, &floorVAO);
@@ -599,12 +841,15 @@ int main() {
     glDeleteVertexArrays(1, &quadVAO);
     glDeleteBuffers(1, &quadVAO);
 
-    glfwTerminate();
+    profiler.print(std::cout);
+    gpuProfiler = nullptr;
+    RG_PROFILE_WRITE("cpu_trace.json");
     return 0;
 }
 
 // process all input: query GLFW whether relevant keys are pressed/released this frame and react accordingly
 void processInput(GLFWwindow *window) {
+    RG_PROFILE_FUNCTION();
     if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS)
         glfwSetWindowShouldClose(window, true);
 
@@ -661,9 +906,42 @@ void key_callback(GLFWwindow *window, int key, int scancode, int action, int mod
     if(key == GLFW_KEY_B && action == GLFW_PRESS){
         bloom=!bloom;
     }
+    if(key == GLFW_KEY_L && action == GLFW_PRESS){
+        legacyBloom=!legacyBloom;
+    }
+    if(key == GLFW_KEY_C && action == GLFW_PRESS){
+        gpuCulling=!gpuCulling;
+        std::cout << "RENDER:: culling on the " << (gpuCulling ? "GPU where available" : "CPU") << std::endl;
+    }
+    if(key == GLFW_KEY_O && action == GLFW_PRESS){
+        occlusionCulling=!occlusionCulling;
+        std::cout << "RENDER:: occlusion culling " << (occlusionCulling ? "on" : "off") << std::endl;
+    }
+    if(key == GLFW_KEY_K && action == GLFW_PRESS){
+        levelOfDetail=!levelOfDetail;
+        std::cout << "RENDER:: levels of detail " << (levelOfDetail ? "on" : "off") << std::endl;
+    }
+    if(key == GLFW_KEY_M && action == GLFW_PRESS){
+        multiDraw=!multiDraw;
+        std::cout << "RENDER:: " << (multiDraw && rg::multiDrawIndirectSupported() ? "multi draw indirect" : "one draw per mesh") << std::endl;
+    }
     if(key == GLFW_KEY_H && action == GLFW_PRESS){
         hdr=!hdr;
     }
+    if(key == GLFW_KEY_P && action == GLFW_PRESS){
+        rg::lastFrameStats().print(std::cout);
+        if (gpuProfiler)
+            gpuProfiler->print(std::cout);
+    }
+    if(key == GLFW_KEY_G && action == GLFW_PRESS && gpuProfiler){
+        if (gpuProfiler->dump("gpu_profile.csv"))
+            std::cout << "GPU:: profile written to gpu_profile.csv" << std::endl;
+        else
+            std::cout << "ERROR::GPU:: could not write gpu_profile.csv" << std::endl;
+    }
+    if(key == GLFW_KEY_T && action == GLFW_PRESS){
+        RG_PROFILE_WRITE("cpu_trace.json");
+    }
     if(key == GLFW_KEY_UP && action == GLFW_PRESS){
         exposure+=0.03;
     }
@@ -674,108 +952,315 @@ void key_callback(GLFWwindow *window, int key, int scancode, int action, int mod
             exposure = 0.0f;
     }
     if(key == GLFW_KEY_F && action == GLFW_PRESS){
-        if(!FlashLight) {
-            dif=glm::vec3(0);
-            spec=glm::vec3(0);
-            FlashLight=!FlashLight;
-        }
-        else{
-            dif=glm::vec3(0.8);
-            spec=glm::vec3(0.5);
-            FlashLight=!FlashLight;
+        setFlashLight(!FlashLight);
+    }
+    if(key == GLFW_KEY_R && action == GLFW_PRESS){
+        if (!cameraRecorder.recording()) {
+            cameraRecorder.start();
+            std::cout << "CAMERA:: recording" << std::endl;
+        } else if (cameraRecorder.stop(cameraPathFile)) {
+            std::cout << "CAMERA:: " << cameraRecorder.size() << " samples written to " << cameraPathFile << std::endl;
+        } else {
+            std::cout << "ERROR::CAMERA:: could not write " << cameraPathFile << std::endl;
         }
     }
 }
 
-unsigned int loadCubemap(vector<std::string> faces) {
-    unsigned int textureID;
-    glGenTextures(1, &textureID);
-    glBindTexture(GL_TEXTURE_CUBE_MAP, textureID);
-
-    int width, height, nrChannels;
-    for (unsigned int i = 0; i < faces.size(); i++){
-        unsigned char *data = stbi_load(faces[i].c_str(), &width, &height, &nrChannels, 0);
-        if (data){
-            glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, data);
-            stbi_image_free(data);
-        }
-        else{
-            std::cout << "Cubemap texture failed to load at path: " << faces[i] << std::endl;
-            stbi_image_free(data);
+void setFlashLight(bool flashLight) {
+    FlashLight = flashLight;
+    if (FlashLight) {
+        dif=glm::vec3(0);
+        spec=glm::vec3(0);
+    }
+    else {
+        dif=glm::vec3(0.8);
+        spec=glm::vec3(0.5);
+    }
+}
+
+rg::CameraSample currentCameraSample() {
+    rg::CameraSample sample = {};
+    sample.position[0] = camera.Position.x;
+    sample.position[1] = camera.Position.y;
+    sample.position[2] = camera.Position.z;
+    sample.yaw = camera.Yaw;
+    sample.pitch = camera.Pitch;
+    sample.zoom = camera.Zoom;
+    sample.exposure = exposure;
+    sample.flags = (bloom ? rg::CameraBloom : 0) | (hdr ? rg::CameraHdr : 0) | (FlashLight ? rg::CameraFlashLight : 0)
+                   | (legacyBloom ? rg::CameraLegacyBloom : 0);
+    return sample;
+}
+
+void applyCameraSample(const rg::CameraSample &sample) {
+    camera.SetPose(glm::vec3(sample.position[0], sample.position[1], sample.position[2]), sample.yaw, sample.pitch);
+    camera.Zoom = sample.zoom;
+    exposure = sample.exposure;
+    bloom = sample.flags & rg::CameraBloom;
+    hdr = sample.flags & rg::CameraHdr;
+    legacyBloom = sample.flags & rg::CameraLegacyBloom;
+    bool flashLight = sample.flags & rg::CameraFlashLight;
+    if (flashLight != FlashLight)
+        setFlashLight(flashLight);
+}
+
+// --cull-bench N: frustum culls N boxes scattered around the camera from 64 view directions, with the SIMD
+// culler and the scalar reference, and checks that both agree. runs without a window.
+int runCullBenchmark(unsigned int instanceCount) {
+    std::mt19937 random(42);
+    std::uniform_real_distribution<float> position(-200.0f, 200.0f);
+    std::uniform_real_distribution<float> size(0.5f, 5.0f);
+    vector<rg::AABB> boxes(instanceCount);
+    for (rg::AABB &box : boxes) {
+        glm::vec3 center(position(random), position(random) * 0.05f, position(random));
+        glm::vec3 extent(size(random), size(random), size(random));
+        box.min = center - extent;
+        box.max = center + extent;
+    }
+    rg::BoundsSoA bounds;
+    bounds.assign(boxes);
+    vector<uint8_t> visible(instanceCount), reference(instanceCount);
+
+    glm::mat4 projection = glm::perspective(glm::radians(45.0f), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 100.0f);
+    const unsigned int views = 64, repetitions = 16;
+    double simdSeconds = 0.0, scalarSeconds = 0.0;
+    size_t visibleCount = 0;
+    bool agree = true;
+    for (unsigned int v = 0; v < views; v++) {
+        float angle = 6.2831853f * v / views;
+        glm::mat4 view = glm::lookAt(glm::vec3(0.0f, 2.0f, 0.0f), glm::vec3(glm::cos(angle), 2.0f, glm::sin(angle)), glm::vec3(0.0f, 1.0f, 0.0f));
+        rg::Frustum frustum = rg::Frustum::fromMatrix(projection * view);
+        auto start = std::chrono::steady_clock::now();
+        for (unsigned int r = 0; r < repetitions; r++)
+            visibleCount += rg::cullBoxes(frustum, bounds, visible.data());
+        auto middle = std::chrono::steady_clock::now();
+        for (unsigned int r = 0; r < repetitions; r++)
+            rg::cullBoxesScalar(frustum, bounds, reference.data());
+        auto end = std::chrono::steady_clock::now();
+        simdSeconds += std::chrono::duration<double>(middle - start).count();
+        scalarSeconds += std::chrono::duration<double>(end - middle).count();
+        agree = agree && visible == reference;
+    }
+
+#if defined(__AVX__)
+    const char *path = "AVX";
+#elif defined(__SSE2__)
+    const char *path = "SSE";
+#else
+    const char *path = "scalar";
+#endif
+    double tests = double(instanceCount) * views * repetitions;
+    std::cout << "CULL_BENCH:: " << instanceCount << " instances x " << views << " views, " << path << " "
+              << simdSeconds * 1e9 / tests << " ns/instance, scalar " << scalarSeconds * 1e9 / tests << " ns/instance ("
+              << scalarSeconds / simdSeconds << "x), " << 100.0 * visibleCount / tests << "% visible" << std::endl;
+    if (!agree)
+        std::cout << "ERROR::CULL_BENCH:: SIMD and scalar results differ" << std::endl;
+    return agree ? 0 : 1;
+}
+
+// a numeric option got something else, reported like the other bad arguments
+int invalidArgument(const char *option, const char *value) {
+    std::cout << "ERROR::ARGUMENTS:: " << option << " needs a number, got " << value << std::endl;
+    return -1;
+}
+
+// --occlusion-bench N: rasterizes a ring of 16 walls (boxes tessellated into 432 occluder triangles) around
+// the camera from 64 view directions and tests N boxes scattered around them against the result. times the
+// SIMD rasterizer on the thread pool, on one thread and the scalar reference, checks that SIMD and scalar draw
+// the same depth, and reports the share of boxes in the frustum that were occluded. runs without a window.
+int runOcclusionBenchmark(unsigned int instanceCount) {
+    struct Corner { glm::vec3 Position; };
+    const int cells = 6;
+    vector<Corner> vertices;
+    vector<unsigned int> indices;
+    for (int face = 0; face < 6; face++) {
+        int axis = face / 2;
+        float side = face % 2 ? 1.0f : -1.0f;
+        unsigned int first = vertices.size();
+        for (int v = 0; v <= cells; v++)
+            for (int u = 0; u <= cells; u++) {
+                glm::vec3 position(0.0f);
+                position[axis] = side;
+                position[(axis + 1) % 3] = 2.0f * u / cells - 1.0f;
+                position[(axis + 2) % 3] = 2.0f * v / cells - 1.0f;
+                vertices.push_back(Corner{position});
+            }
+        for (int v = 0; v < cells; v++)
+            for (int u = 0; u < cells; u++) {
+                unsigned int corner = first + v * (cells + 1) + u;
+                unsigned int quad[6] = {corner, corner + 1, corner + cells + 2, corner, corner + cells + 2, corner + cells + 1};
+                indices.insert(indices.end(), quad, quad + 6);
+            }
+    }
+    rg::OccluderBuilder builder;
+    builder.addMesh(vertices.data(), vertices.size(), indices.data(), indices.size());
+    rg::OccluderMesh wall = builder.build(512, 1.0f);
+    vector<glm::mat4> walls;
+    for (int w = 0; w < 16; w++) {
+        float angle = 6.2831853f * w / 16;
+        glm::mat4 model = glm::translate(glm::mat4(1.0f), glm::vec3(30.0f * glm::cos(angle), 5.0f, 30.0f * glm::sin(angle)));
+        model = glm::rotate(model, -angle, glm::vec3(0.0f, 1.0f, 0.0f));
+        walls.push_back(glm::scale(model, glm::vec3(1.0f, 5.0f, 5.0f)));
+    }
+
+    std::mt19937 random(42);
+    std::uniform_real_distribution<float> position(-200.0f, 200.0f);
+    std::uniform_real_distribution<float> size(0.5f, 5.0f);
+    vector<rg::AABB> boxes(instanceCount);
+    for (rg::AABB &box : boxes) {
+        glm::vec3 center(position(random), position(random) * 0.05f, position(random));
+        glm::vec3 extent(size(random), size(random), size(random));
+        box.min = center - extent;
+        box.max = center + extent;
+    }
+    rg::BoundsSoA bounds;
+    bounds.assign(boxes);
+    vector<uint8_t> visible(instanceCount);
+
+    unsigned int width = 256, height = 256 * SCR_HEIGHT / SCR_WIDTH;
+    rg::OcclusionRasterizer rasterizer(width, height), reference(width, height);
+    glm::mat4 projection = glm::perspective(glm::radians(45.0f), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 100.0f);
+    const unsigned int views = 64, repetitions = 8;
+    double pooledSeconds = 0.0, singleSeconds = 0.0, scalarSeconds = 0.0, testSeconds = 0.0;
+    size_t inFrustum = 0, occluded = 0;
+    bool agree = true;
+    auto draw = [&](rg::OcclusionRasterizer &target, const glm::mat4 &viewProjection, rg::ThreadPool *pool,
+                    rg::OcclusionRasterizer::Path path) {
+        auto start = std::chrono::steady_clock::now();
+        for (unsigned int r = 0; r < repetitions; r++) {
+            target.begin(viewProjection);
+            for (const glm::mat4 &model : walls)
+                target.addOccluder(wall, model);
+            target.rasterize(pool, path);
         }
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    };
+    for (unsigned int v = 0; v < views; v++) {
+        float angle = 6.2831853f * v / views;
+        glm::mat4 view = glm::lookAt(glm::vec3(0.0f, 2.0f, 0.0f), glm::vec3(glm::cos(angle), 2.0f, glm::sin(angle)), glm::vec3(0.0f, 1.0f, 0.0f));
+        glm::mat4 viewProjection = projection * view;
+        pooledSeconds += draw(rasterizer, viewProjection, &rg::ThreadPool::shared(), rg::OcclusionRasterizer::Path::Simd);
+        singleSeconds += draw(rasterizer, viewProjection, nullptr, rg::OcclusionRasterizer::Path::Simd);
+        scalarSeconds += draw(reference, viewProjection, nullptr, rg::OcclusionRasterizer::Path::Scalar);
+        agree = agree && rasterizer.depth() == reference.depth();
+
+        inFrustum += rg::cullBoxes(rg::Frustum::fromMatrix(viewProjection), bounds, visible.data());
+        auto start = std::chrono::steady_clock::now();
+        for (unsigned int i = 0; i < instanceCount; i++)
+            if (visible[i] && rasterizer.occluded(boxes[i]))
+                occluded++;
+        testSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
     }
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
 
-    return textureID;
+#if defined(__AVX__)
+    const char *path = "AVX";
+#elif defined(__SSE2__)
+    const char *path = "SSE";
+#else
+    const char *path = "scalar";
+#endif
+    double frames = double(views) * repetitions;
+    std::cout << "OCCLUSION_BENCH:: " << walls.size() * wall.triangleCount() << " occluder triangles at " << rasterizer.width()
+              << "x" << rasterizer.height() << ", " << path << " on " << rg::ThreadPool::shared().size() + 1 << " threads "
+              << pooledSeconds * 1e3 / frames << " ms, one thread " << singleSeconds * 1e3 / frames << " ms, scalar "
+              << scalarSeconds * 1e3 / frames << " ms (" << scalarSeconds / pooledSeconds << "x)" << std::endl;
+    std::cout << "OCCLUSION_BENCH:: " << instanceCount << " instances x " << views << " views, "
+              << testSeconds * 1e9 / std::max<size_t>(inFrustum, 1) << " ns per test, "
+              << 100.0 * occluded / std::max<size_t>(inFrustum, 1) << "% of the instances in the frustum occluded" << std::endl;
+    if (!agree)
+        std::cout << "ERROR::OCCLUSION_BENCH:: SIMD and scalar depth differ" << std::endl;
+    return agree ? 0 : 1;
+}
+
+unsigned int loadCubemap(vector<std::string> faces) {
+    return rg::TextureRegistry::instance().acquireCubemap(faces);
 }
 // utility function for loading a 2D texture from file
 unsigned int loadTexture(char const * path){
-    unsigned int textureID;
-    glGenTextures(1, &textureID);
-
-    int width, height, nrComponents;
-    unsigned char *data = stbi_load(path, &width, &height, &nrComponents, 0);
-    if (data){
-        GLenum format;
-        if (nrComponents == 1)
-            format = GL_RED;
-        else if (nrComponents == 3)
-            format = GL_RGB;
-        else if (nrComponents == 4)
-            format = GL_RGBA;
-
-        glBindTexture(GL_TEXTURE_2D, textureID);
-        glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
-        glGenerateMipmap(GL_TEXTURE_2D);
-
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, format == GL_RGBA ? GL_CLAMP_TO_EDGE : GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T,format == GL_RGBA ? GL_CLAMP_TO_EDGE : GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    return rg::TextureRegistry::instance().acquire2D(path, rg::TextureWrap::ClampIfAlpha);
+}
 
-        stbi_image_free(data);
-    }
-    else{
-        std::cout << "Texture failed to load at path: " << path << std::endl;
-        stbi_image_free(data);
+// --bloom-bench: times the ping-pong blur and the mip chain on the GPU at three resolutions, each path in its
+// own profiler scope, on a random HDR image. prints the average next to the estimated bytes read, which come
+// from a model of the passes and aren't measured. runs without a window.
+int runBloomBenchmark() {
+    rg::HeadlessContext context;
+    if (!context.create())
+        return -1;
+    if (!gladLoadGLLoader((GLADloadproc) rg::HeadlessContext::getProcAddress)) {
+        std::cout << "Failed to initialize GLAD" << std::endl;
+        return -1;
     }
 
-    return textureID;
-}
+    float quadVertices[] = {
+            -1.0f,  1.0f, 0.0f, 0.0f, 1.0f,
+            -1.0f, -1.0f, 0.0f, 0.0f, 0.0f,
+            1.0f,  1.0f, 0.0f, 1.0f, 1.0f,
+            1.0f, -1.0f, 0.0f, 1.0f, 0.0f,
+    };
+    unsigned int quadVAO, quadVBO;
+    glGenVertexArrays(1, &quadVAO);
+    glGenBuffers(1, &quadVBO);
+    rg::GLState::instance().bindVertexArray(quadVAO);
+    glBindBuffer(GL_ARRAY_BUFFER, quadVBO);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(quadVertices), &quadVertices, GL_STATIC_DRAW);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)0);
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)(3 * sizeof(float)));
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    std::mt19937 random(42);
+    std::uniform_real_distribution<float> radiance(0.0f, 4.0f);
+    const unsigned int resolutions[][2] = {{800, 600}, {1920, 1080}, {3840, 2160}};
+    const unsigned int warmup = 3, frames = 20;
+    for (const auto &resolution : resolutions) {
+        unsigned int width = resolution[0], height = resolution[1];
+        vector<float> pixels(size_t(width) * height * 4);
+        for (float &value : pixels)
+            value = radiance(random);
+        unsigned int source;
+        glGenTextures(1, &source);
+        rg::GLState::instance().bindTexture(0, GL_TEXTURE_2D, source);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, width, height, 0, GL_RGBA, GL_FLOAT, pixels.data());
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
 
-void setUpShader(Shader shader,glm::vec3 position,glm::vec3 specular,glm::vec3 diffuse,glm::vec3 ambient,float constant,float linear,float quadratic,glm::mat4 projection,glm::mat4 view,glm::vec3 camPosition,bool point_spot,float cutOff,float outerCutoff,glm::vec3 direction){
-    if(point_spot){
-        shader.use();
-        shader.setVec3("pointLight.position", position);
-        shader.setVec3("pointLight.specular", specular);
-        shader.setVec3("pointLight.diffuse", diffuse);
-        shader.setVec3("pointLight.ambient", ambient);
-        shader.setFloat("pointLight.constant", constant);
-        shader.setFloat("pointLight.linear", linear);
-        shader.setFloat("pointLight.quadratic", quadratic);
-        shader.setMat4("projection", projection);
-        shader.setMat4("view", view);
-        shader.setVec3("viewPosition", camPosition);
-    }
-    else{
-        shader.use();
-        shader.setVec3("spotLight.position", position);
-        shader.setVec3("spotLight.direction",direction);
-        shader.setVec3("spotLight.specular", specular);
-        shader.setVec3("spotLight.diffuse", diffuse);
-        shader.setVec3("spotLight.ambient", ambient);
-        shader.setFloat("spotLight.constant", constant);
-        shader.setFloat("spotLight.linear", linear);
-        shader.setFloat("spotLight.quadratic", quadratic);
-        shader.setFloat("cutOff",cutOff);
-        shader.setFloat("outerCutOff",outerCutoff);
-
-        shader.setMat4("projection", projection);
-        shader.setMat4("view", view);
-        shader.setVec3("viewPosition", camPosition);
+        rg::BloomPingPong pingPong(width, height);
+        rg::BloomMipChain chain(width, height);
+        for (unsigned int f = 0; f < warmup; f++) {
+            pingPong.render(source, quadVAO);
+            chain.render(source, quadVAO, 1.0f);
+        }
+        // finishing every frame keeps the profiler from dropping any, the scopes time the GPU work alone
+        rg::GpuProfiler profiler;
+        for (unsigned int f = 0; f < frames + rg::GpuProfiler::kFrameLatency; f++) {
+            profiler.beginFrame();
+            if (f < frames) {
+                {
+                    rg::GpuScope scope(profiler, "bloom (ping-pong)");
+                    pingPong.render(source, quadVAO);
+                }
+                {
+                    rg::GpuScope scope(profiler, "bloom (mip chain)");
+                    chain.render(source, quadVAO, 1.0f);
+                }
+            }
+            glFinish();
+        }
+        double pingPongMilliseconds = profiler.stats("bloom (ping-pong)").average;
+        double chainMilliseconds = profiler.stats("bloom (mip chain)").average;
+        std::cout << "BLOOM_BENCH:: " << width << "x" << height << " ping-pong " << pingPongMilliseconds << " ms GPU (estimated "
+                  << rg::BloomPingPong::bytesRead(width, height) / 1.0e6 << " MB read), mip chain " << chainMilliseconds
+                  << " ms GPU (estimated " << rg::BloomMipChain::bytesRead(width, height) / 1.0e6 << " MB read), "
+                  << pingPongMilliseconds / chainMilliseconds << "x faster" << std::endl;
+
+        rg::GLState::instance().forgetTexture(source);
+        glDeleteTextures(1, &source);
     }
+    glDeleteVertexArrays(1, &quadVAO);
+    glDeleteBuffers(1, &quadVBO);
+    return 0;
 }